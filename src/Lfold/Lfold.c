@@ -32,9 +32,21 @@
 
 #define STACK_BULGE1 1 /* stacking energies for bulges of size 1 */
 #define NEW_NINIO 1    /* new asymetry penalty */
-/*@unused@*/
-#define MAXSECTORS 500 /* dimension for a backtrack array */
 #define LOCALITY 0.    /* locality parameter for base-pairs */
+#define ARENA_ALIGNMENT 64 /* bytes, a cache line */
+#define ROW_ALIGNMENT 16   /* entries, a cache line of ints */
+#define LOOP_RING (MAXLOOP + 2) /* rows an interior loop reaches */
+
+/* fill_arrays() is inlined into its instances */
+#ifdef __GNUC__
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+/* the loop sizes (u1, u2) E_IntLoop() tabulates, the stack comes first */
+PRIVATE const int small_loops[][2] = {{0, 0}, {0, 1}, {1, 0}, {1, 1}, {1, 2},
+                                      {2, 1}, {2, 2}, {2, 3}, {3, 2}};
 
 /*
 #################################
@@ -42,49 +54,35 @@
 #################################
 */
 
-/*
-#################################
-# PRIVATE VARIABLES             #
-#################################
-*/
-PRIVATE paramT *P = NULL;
-PRIVATE int **c = NULL;  /* energy array, given that i-j pair */
-PRIVATE int *cc = NULL;  /* linear array for calculating canonical structures */
-PRIVATE int *cc1 = NULL; /*   "     "        */
-PRIVATE int *f3 = NULL;  /* energy of 5' end */
-PRIVATE int **fML = NULL;    /* multi-loop auxiliary energy array */
-PRIVATE int *Fmi = NULL;     /* holds row i of fML (avoids jumps in memory) */
-PRIVATE int *DMLi = NULL;    /* DMLi[j] holds MIN(fML[i,k]+fML[k+1,j])  */
-PRIVATE int *DMLi1 = NULL;   /*             MIN(fML[i+1,k]+fML[k+1,j])  */
-PRIVATE int *DMLi2 = NULL;   /*             MIN(fML[i+2,k]+fML[k+1,j])  */
-PRIVATE char **ptype = NULL; /* precomputed array of pair types */
-PRIVATE short *S = NULL, *S1 = NULL;
-PRIVATE unsigned int length;
-PRIVATE char *prev = NULL;
-
-PRIVATE int with_gquad = 0;
-PRIVATE int **ggg = NULL;
-
-#ifdef _OPENMP
-
-#pragma omp threadprivate(P, c, cc, cc1, f3, fML, Fmi, DMLi, DMLi1, DMLi2,     \
-                          ptype, S, S1, length, ggg, with_gquad, prev)
-
-#endif
-
 /*
 #################################
 # PRIVATE FUNCTION DECLARATIONS #
 #################################
 */
-PRIVATE void initialize_Lfold(int length, int maxdist);
-PRIVATE void update_fold_params(void);
-PRIVATE void get_arrays(unsigned int size, int maxdist);
-PRIVATE void free_arrays(int maxdist);
-PRIVATE void make_ptypes(const short *S, int i, int maxdist, int n);
-PRIVATE char *backtrack(const char *sequence, int start, int maxdist);
-PRIVATE int fill_arrays(const char *sequence, int maxdist, int zsc,
-                        double min_z, struct structure_list *s_list);
+PRIVATE void initialize_Lfold(struct fold_context *ctx, int length,
+                              int maxdist);
+PRIVATE void update_fold_params(struct fold_context *ctx);
+PRIVATE void get_arrays(struct fold_context *ctx, unsigned int size,
+                        int maxdist);
+PRIVATE int uses_sparse_ml(struct fold_context *ctx);
+PRIVATE void make_loop_table(paramT *P, int (*loops)[MAXLOOP + 1]);
+PRIVATE int generic_loops(int *const *cB, int *const *c1n, int *const *cI,
+                          const int (*loops)[MAXLOOP + 1], int i, int j,
+                          int au, int mm1n, int mmI);
+PRIVATE int ml_split(const int *Fmi, const int *fML_column, int n);
+PRIVATE void release_arrays(struct fold_context *ctx);
+PRIVATE void make_ptypes(struct fold_context *ctx, const short *S, int i,
+                         int maxdist, int n);
+PRIVATE int backtrack(struct fold_context *ctx, char *structure, int start,
+                     int maxdist, int outer_only);
+typedef int (*fill_arrays_fn)(struct fold_context *ctx, const char *sequence,
+                              int maxdist, int zsc, double min_z,
+                              int core_start, int core_end,
+                              struct structure_list *s_list);
+PRIVATE fill_arrays_fn get_fill_arrays(int dangle_model, int with_gquad);
+PRIVATE void save_if_covers_core(struct structure_list *list,
+                                 struct secondary_structure *s,
+                                 int core_start, int core_end);
 
 /*
 #################################
@@ -103,8 +101,8 @@ int create_structure_list(struct structure_list **list) {
   }
   tmp_list->n = 0;
   tmp_list->capacity = INITIAL_SIZE;
-  tmp_list->structures = (struct secondary_structure **)malloc(
-      tmp_list->capacity * sizeof(struct secondary_structure *));
+  tmp_list->structures = (struct secondary_structure *)malloc(
+      tmp_list->capacity * sizeof(struct secondary_structure));
   if (tmp_list->structures == NULL) {
     err = 1;
     goto cleanup;
@@ -123,64 +121,70 @@ cleanup:
   return err;
 }
 int save_secondary_structure(struct structure_list *list,
-                             char *structure_string, double mfe, int start) {
-  int err = 0;
-  struct secondary_structure *s =
-      (struct secondary_structure *)malloc(sizeof(struct secondary_structure));
-  if (s == NULL) {
-    err = 1;
-    goto cleanup;
-  }
-  /* use evil strlen since the library would fail for a non terminated string
-   * anyway */
-  int n = strlen(structure_string);
-  s->structure_string = (char *)malloc((n + 1) * sizeof(char));
-  if (s->structure_string == NULL) {
-    err = 1;
-    goto cleanup;
-  }
-  memcpy(s->structure_string, structure_string, n);
-  s->structure_string[n] = 0;
-  s->mfe = mfe;
-  s->start = start;
-
+                             struct secondary_structure *s) {
   if (list->n >= list->capacity) {
-    list->capacity *= 2;
-    struct secondary_structure **tmp =
+    struct secondary_structure *tmp =
         realloc(list->structures,
-                list->capacity * sizeof(struct secondary_structure *));
+                2 * list->capacity * sizeof(struct secondary_structure));
     if (tmp == NULL) {
-      err = 1;
-      goto cleanup;
+      return 1;
     }
+    list->capacity *= 2;
     list->structures = tmp;
   }
-  list->structures[list->n] = s;
+  list->structures[list->n] = *s;
+  list->structures[list->n].structure_string = NULL;
   list->n++;
+  return 0;
+}
 
+/* Needs the arrays of the Lfold() call that reported the structure. */
+int backtrack_secondary_structure(struct fold_context *ctx,
+                                  struct secondary_structure *s) {
+  if (s->structure_string != NULL)
+    return 0;
+  int n = MIN2((int)ctx->lfold.length - s->backtrack_start, s->backtrack_end);
+  /* room for the leading '.' */
+  char *structure = (char *)malloc((n + 4) * sizeof(char));
+  if (structure == NULL)
+    return 1;
+  backtrack(ctx, structure + s->is_dotted, s->backtrack_start,
+            s->backtrack_end, 0);
+  if (s->is_dotted)
+    structure[0] = '.';
+  s->structure_string = structure;
   return 0;
+}
 
-cleanup:
-  if (s != NULL && s->structure_string != NULL) {
-    free(s->structure_string);
-  }
-  if (s != NULL) {
-    free(s);
+/* Lfold() drops a structure if the next one contains it, this is only
+ * decided when somebody asks for it, since it needs both dot bracket
+ * strings. */
+int is_contained_structure(struct fold_context *ctx,
+                           struct secondary_structure *s) {
+  if (!s->may_be_contained)
+    return 0;
+  int n = MIN2((int)ctx->lfold.length - s->next_start, s->next_end);
+  char *next = (char *)malloc((n + 3) * sizeof(char));
+  if (next == NULL || backtrack_secondary_structure(ctx, s)) {
+    free(next);
+    return 0;
   }
-  return err;
+  backtrack(ctx, next, s->next_start, s->next_end, 0);
+  /* both strings are compared as backtracked, without the leading '.' */
+  char *p = s->structure_string + s->is_dotted;
+  int is_contained = strncmp(next + s->backtrack_start - s->next_start + 1, p,
+                             strlen(p)) == 0;
+  free(next);
+  return is_contained;
 }
 
 void free_structure_list(struct structure_list *list) {
   for (size_t i = 0; i < list->n; i++) {
-    free_secondary_structure(list->structures[i]);
+    free(list->structures[i].structure_string);
   }
   free(list->structures);
   free(list);
 }
-void free_secondary_structure(struct secondary_structure *s) {
-  free(s->structure_string);
-  free(s);
-}
 
 /*
 #################################
@@ -189,96 +193,292 @@ void free_secondary_structure(struct secondary_structure *s) {
 */
 
 /*--------------------------------------------------------------------------*/
-PRIVATE void initialize_Lfold(int length, int maxdist) {
+PRIVATE void initialize_Lfold(struct fold_context *ctx, int length,
+                              int maxdist) {
 
   if (length < 1)
     nrerror("initialize_Lfold: argument must be greater 0");
-  get_arrays((unsigned)length, maxdist);
-  update_fold_params();
+  get_arrays(ctx, (unsigned)length, maxdist);
+  if (!ctx->P)
+    update_fold_params(ctx);
 }
 
 /*--------------------------------------------------------------------------*/
-PRIVATE void get_arrays(unsigned int size, int maxdist) {
-  int i;
-  c = (int **)space(sizeof(int *) * (size + 1));
-  fML = (int **)space(sizeof(int *) * (size + 1));
-  ptype = (char **)space(sizeof(char *) * (size + 1));
-  f3 = (int *)space(sizeof(int) * (size + 2)); /* has to be one longer */
-  cc = (int *)space(sizeof(int) * (maxdist + 5));
-  cc1 = (int *)space(sizeof(int) * (maxdist + 5));
-  Fmi = (int *)space(sizeof(int) * (maxdist + 5));
-  DMLi = (int *)space(sizeof(int) * (maxdist + 5));
-  DMLi1 = (int *)space(sizeof(int) * (maxdist + 5));
-  DMLi2 = (int *)space(sizeof(int) * (maxdist + 5));
 
-  for (i = size; (i > (int)size - maxdist - 5) && (i >= 0); i--) {
-    c[i] = (int *)space(sizeof(int) * (maxdist + 5));
+/* Returns the next piece of the arena, aligned to a cache line. */
+PRIVATE char *take_from_arena(char **p, size_t size) {
+  char *piece = *p;
+  *p += (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+  return piece;
+}
+
+/* All arrays are carved from one block, the rows of c, fML, ptype and ggg
+ * are one band each. The block is kept for the next call and only grows, so
+ * repeated calls do not allocate. */
+PRIVATE void get_arrays(struct fold_context *ctx, unsigned int size,
+                        int maxdist) {
+  int i;
+  /* the rows start at cache lines, a stride of a power of two would map
+   * the same column of all rows to a few cache sets */
+  size_t width = (maxdist + 5 + ROW_ALIGNMENT - 1) / ROW_ALIGNMENT *
+                 ROW_ALIGNMENT;
+  if (width % (16 * ROW_ALIGNMENT) == 0)
+    width += ROW_ALIGNMENT;
+  size_t rows = size + 1;
+  /* the columns of fML are only read by the dense multiloop decomposition */
+  size_t columns = uses_sparse_ml(ctx) ? 0 : rows;
+  size_t gquad_rows = ctx->with_gquad ? rows : 0;
+  size_t pieces[] = {sizeof(int *) * rows,      sizeof(int *) * rows,
+                     sizeof(char *) * rows,     sizeof(int) * (size + 2),
+                     sizeof(int) * width,       sizeof(int) * width,
+                     sizeof(int) * width,       sizeof(int) * width,
+                     sizeof(int) * width,       sizeof(int) * width,
+                     sizeof(int) * width * rows, sizeof(int) * width * rows,
+                     sizeof(char) * width * rows,
+                     sizeof(int *) * columns,   sizeof(int) * width * columns,
+                     sizeof(int *) * LOOP_RING * 3,
+                     sizeof(int) * width * LOOP_RING * 3,
+                     sizeof(short) * (size + 2), sizeof(short) * (size + 2),
+                     sizeof(char) * (size + 4),
+                     sizeof(int *) * gquad_rows,
+                     sizeof(int) * width * gquad_rows};
+  size_t needed = ARENA_ALIGNMENT;
+  for (i = 0; i < (int)(sizeof(pieces) / sizeof(pieces[0])); i++)
+    needed += (pieces[i] + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT *
+              ARENA_ALIGNMENT;
+  if (needed > ctx->lfold.arena_size) {
+    free(ctx->lfold.arena);
+    ctx->lfold.arena = space(needed);
+    ctx->lfold.arena_size = needed;
   }
-  for (i = size; (i > (int)size - maxdist - 5) && (i >= 0); i--) {
-    fML[i] = (int *)space(sizeof(int) * (maxdist + 5));
+  char *p = (char *)ctx->lfold.arena;
+  p += (ARENA_ALIGNMENT - (size_t)p % ARENA_ALIGNMENT) % ARENA_ALIGNMENT;
+
+  ctx->lfold.c = (int **)take_from_arena(&p, pieces[0]);
+  ctx->lfold.fML = (int **)take_from_arena(&p, pieces[1]);
+  ctx->lfold.ptype = (char **)take_from_arena(&p, pieces[2]);
+  /* has to be one longer */
+  ctx->lfold.f3 = (int *)take_from_arena(&p, pieces[3]);
+  ctx->lfold.cc = (int *)take_from_arena(&p, pieces[4]);
+  ctx->lfold.cc1 = (int *)take_from_arena(&p, pieces[5]);
+  ctx->lfold.Fmi = (int *)take_from_arena(&p, pieces[6]);
+  ctx->lfold.DMLi = (int *)take_from_arena(&p, pieces[7]);
+  ctx->lfold.DMLi1 = (int *)take_from_arena(&p, pieces[8]);
+  ctx->lfold.DMLi2 = (int *)take_from_arena(&p, pieces[9]);
+  int *c_band = (int *)take_from_arena(&p, pieces[10]);
+  int *fML_band = (int *)take_from_arena(&p, pieces[11]);
+  char *ptype_band = take_from_arena(&p, pieces[12]);
+  ctx->lfold.fMLt = (int **)take_from_arena(&p, pieces[13]);
+  int *fMLt_band = (int *)take_from_arena(&p, pieces[14]);
+  int **ring = (int **)take_from_arena(&p, pieces[15]);
+  int *ring_band = (int *)take_from_arena(&p, pieces[16]);
+  ctx->lfold.S = (short *)take_from_arena(&p, pieces[17]);
+  ctx->lfold.S1 = (short *)take_from_arena(&p, pieces[18]);
+  ctx->lfold.buffer = take_from_arena(&p, pieces[19]);
+  int **ggg = (int **)take_from_arena(&p, pieces[20]);
+  int *ggg_band = (int *)take_from_arena(&p, pieces[21]);
+  memset(ctx->lfold.f3, 0, pieces[3]);
+  memset(ctx->lfold.cc, 0, sizeof(int) * width);
+  memset(ctx->lfold.cc1, 0, sizeof(int) * width);
+
+  for (i = 0; i <= (int)size; i++) {
+    ctx->lfold.c[i] = c_band + i * width;
+    ctx->lfold.fML[i] = fML_band + i * width;
+    ctx->lfold.ptype[i] = ptype_band + i * width;
   }
+  for (i = 0; i < (int)columns; i++)
+    ctx->lfold.fMLt[i] = fMLt_band + i * width;
+  for (i = 0; i < (int)gquad_rows; i++)
+    ggg[i] = ggg_band + i * width;
+  ctx->lfold.ggg = gquad_rows ? ggg : NULL;
+  for (i = 0; i < LOOP_RING * 3; i++)
+    ring[i] = ring_band + i * width;
+  ctx->lfold.cI = ring;
+  ctx->lfold.c1n = ring + LOOP_RING;
+  ctx->lfold.cB = ring + 2 * LOOP_RING;
+  /* the rows of the sliding window, the rows of smaller i are cleared when
+   * they enter it */
   for (i = size; (i > (int)size - maxdist - 5) && (i >= 0); i--) {
-    ptype[i] = (char *)space(sizeof(char) * (maxdist + 5));
+    memset(ctx->lfold.c[i], 0, sizeof(int) * width);
+    memset(ctx->lfold.fML[i], 0, sizeof(int) * width);
+    memset(ctx->lfold.ptype[i], 0, sizeof(char) * width);
   }
 }
 
 /*--------------------------------------------------------------------------*/
 
-PRIVATE void free_arrays(int maxdist) {
-  int i;
-  for (i = 0; (i < maxdist + 5) && (i <= length); i++) {
-    free(c[i]);
-    free(fML[i]);
-    free(ptype[i]);
+/* The candidate lists cover the dangle models without stems that
+ * neighbour each other. */
+PRIVATE int uses_sparse_ml(struct fold_context *ctx) {
+  return ctx->sparse_ml && (dangles == 0 || dangles == 2);
+}
+
+/*--------------------------------------------------------------------------*/
+
+/* loops[u1][MAXLOOP - u2] is the energy of the bulge (u1 = 0), 1xn loop
+ * (u1 = 1) or generic interior loop (u1 > 1) of the sizes u1 and u2 without
+ * the terms of the pairs. Reversing u2 makes it ascend with the inner 3'
+ * position, as the rows of c do. */
+PRIVATE void make_loop_table(paramT *P, int (*loops)[MAXLOOP + 1]) {
+  int u1, u2;
+  for (u1 = 0; u1 <= MAXLOOP; u1++) {
+    for (u2 = 0; u2 <= MAXLOOP; u2++) {
+      int *e = &loops[u1][MAXLOOP - u2];
+      if (u1 == 0)
+        *e = P->bulge[u2];
+      else if (u1 == 1)
+        *e = (u2 >= 1 && u2 < MAXLOOP)
+                 ? P->internal_loop[u2 + 1] +
+                       MIN2(MAX_NINIO, (u2 - 1) * P->ninio[2])
+                 : INF;
+      else
+        *e = (u1 + u2 <= MAXLOOP)
+                 ? P->internal_loop[u1 + u2] +
+                       MIN2(MAX_NINIO, abs(u1 - u2) * P->ninio[2])
+                 : INF;
+    }
   }
-  free(c);
-  free(fML);
-  free(ptype);
-  free(f3);
-  free(cc);
-  free(cc1);
-  free(Fmi);
-  free(DMLi);
-  free(DMLi1);
-  free(DMLi2);
-
-  if (ggg) {
-    for (i = 0; (i < maxdist + 5) && (i <= length); i++) {
-      free(ggg[i]);
+}
+
+/*--------------------------------------------------------------------------*/
+
+/* The interior loops closed by (i,j) that E_IntLoop() does not tabulate.
+ * For every inner 5' position p the sizes of one kind form a contiguous
+ * piece of the ring row of p and of the loop table, so the minimum is a
+ * vector reduction. au, mm1n and mmI are the terms of (i,j). */
+VECTOR_KERNEL PRIVATE int generic_loops(int *const *cB, int *const *c1n,
+                                        int *const *cI,
+                                        const int (*loops)[MAXLOOP + 1], int i,
+                                        int j, int au, int mm1n, int mmI) {
+  int p, t, best = INF;
+  for (p = i + 1; p <= MIN2(j - 2 - TURN, i + MAXLOOP + 1); p++) {
+    int u1 = p - i - 1;
+    int last = MIN2(MAXLOOP - u1, j - p - TURN - 2); /* largest u2 */
+    int first, outer, n, en;
+    const int *inner, *loop;
+    int r = p % LOOP_RING;
+    /* bulge and 1xn loop with the larger side at the 5' end */
+    if (u1 >= 2)
+      best = MIN2(best, au + loops[0][MAXLOOP - u1] + cB[r][j - 1 - p]);
+    if (u1 >= 3 && last >= 1)
+      best = MIN2(best, mm1n + loops[1][MAXLOOP - u1] + c1n[r][j - 2 - p]);
+    switch (u1) {
+    case 0:
+      first = 2;
+      inner = cB[r];
+      outer = au;
+      break;
+    case 1:
+      first = 3;
+      inner = c1n[r];
+      outer = mm1n;
+      break;
+    case 2:
+      first = 4;
+      inner = cI[r];
+      outer = mmI;
+      break;
+    default:
+      first = (u1 == 3) ? 3 : 2;
+      inner = cI[r];
+      outer = mmI;
+      break;
     }
-    free(ggg);
-    ggg = NULL;
+    if (first > last)
+      continue;
+    /* q = j - 1 - u2 ascends */
+    inner += j - 1 - last - p;
+    loop = loops[u1] + MAXLOOP - last;
+    n = last - first + 1;
+    en = INF;
+#ifdef _OPENMP
+#pragma omp simd reduction(min : en)
+#endif
+    for (t = 0; t < n; t++)
+      en = MIN2(en, inner[t] + loop[t]);
+    best = MIN2(best, outer + en);
   }
+  return best;
+}
+
+/*--------------------------------------------------------------------------*/
 
-  f3 = cc = cc1 = Fmi = DMLi = DMLi1 = DMLi2 = NULL;
-  c = fML = NULL;
-  ptype = NULL;
+/* min(Fmi[t] + fML_column[t]), the split of the dense multiloop
+ * decomposition with fML read along a column. */
+VECTOR_KERNEL PRIVATE int ml_split(const int *Fmi, const int *fML_column,
+                                   int n) {
+  int t, decomp = INF;
+#ifdef _OPENMP
+#pragma omp simd reduction(min : decomp)
+#endif
+  for (t = 0; t < n; t++)
+    decomp = MIN2(decomp, Fmi[t] + fML_column[t]);
+  return decomp;
+}
+
+/*--------------------------------------------------------------------------*/
+
+/* Forgets the arrays of a single call, they are all in the arena, which is
+ * kept. */
+PRIVATE void release_arrays(struct fold_context *ctx) {
+  ctx->lfold.f3 = ctx->lfold.cc = ctx->lfold.cc1 = ctx->lfold.Fmi =
+      ctx->lfold.DMLi = ctx->lfold.DMLi1 = ctx->lfold.DMLi2 = NULL;
+  ctx->lfold.c = ctx->lfold.fML = NULL;
+  ctx->lfold.ptype = NULL;
+  ctx->lfold.S = ctx->lfold.S1 = NULL;
+  ctx->lfold.ggg = NULL;
+  ctx->lfold.buffer = NULL;
+  ctx->lfold.sequence = NULL;
+}
+
+PUBLIC void free_Lfold_arrays(struct fold_context *ctx) {
+  release_arrays(ctx);
+  free(ctx->lfold.arena);
+  ctx->lfold.arena = NULL;
+  ctx->lfold.arena_size = 0;
 }
 
 /*--------------------------------------------------------------------------*/
 
-PUBLIC float Lfold(struct structure_list **result, const char *string,
-                   int maxdist) {
-  return Lfoldz(result, string, maxdist, 0, 0.0);
+PUBLIC float Lfold(struct fold_context *ctx, struct structure_list **result,
+                   const char *string, int maxdist) {
+  return Lfoldz(ctx, result, string, maxdist, 0, 0.0);
 }
 
-PUBLIC float Lfoldz(struct structure_list **result, const char *string,
-                    int maxdist, int zsc, double min_z) {
+PUBLIC float Lfoldz(struct fold_context *ctx, struct structure_list **result,
+                    const char *string, int maxdist, int zsc, double min_z) {
+  return Lfold_core(ctx, result, string, maxdist, zsc, min_z,
+                    (int)strlen(string), 1);
+}
+
+PUBLIC float Lfold_core(struct fold_context *ctx,
+                        struct structure_list **result, const char *string,
+                        int maxdist, int zsc, double min_z, int core_start,
+                        int core_end) {
   int i, energy;
 
-  length = (int)strlen(string);
-  if (maxdist > length)
-    maxdist = length;
-  initialize_Lfold(length, maxdist);
-  if (fabs(P->temperature - temperature) > 1e-6)
-    update_fold_params();
+  /* the arrays of the previous call */
+  release_arrays(ctx);
+
+  ctx->lfold.length = (int)strlen(string);
+  if (maxdist > ctx->lfold.length)
+    maxdist = ctx->lfold.length;
+  ctx->lfold.maxdist = maxdist;
+  /* the parameters first, the arrays depend on gquad */
+  if (!ctx->P || fabs(ctx->P->temperature - temperature) > 1e-6)
+    update_fold_params(ctx);
+  ctx->with_gquad = ctx->P->model_details.gquad;
+  initialize_Lfold(ctx, ctx->lfold.length, maxdist);
+  /* the pair matrix of this file, the parameters may come from fold() */
+  make_pair_matrix();
 
-  with_gquad = P->model_details.gquad;
-  S = encode_sequence(string, 0);
-  S1 = encode_sequence(string, 1);
+  ctx->lfold.sequence = string;
+  encode_sequence_to(ctx->lfold.S, string, 0);
+  encode_sequence_to(ctx->lfold.S1, string, 1);
 
-  for (i = length; i >= (int)length - (int)maxdist - 4 && i > 0; i--)
-    make_ptypes(S, i, maxdist, length);
+  for (i = ctx->lfold.length;
+       i >= (int)ctx->lfold.length - (int)maxdist - 4 && i > 0; i--)
+    make_ptypes(ctx, ctx->lfold.S, i, maxdist, ctx->lfold.length);
 
   /*
    *############################################################################
@@ -288,7 +488,8 @@ PUBLIC float Lfoldz(struct structure_list **result, const char *string,
   struct structure_list *s_list = NULL;
   create_structure_list(&s_list);
 
-  energy = fill_arrays(string, maxdist, zsc, min_z, s_list);
+  energy = get_fill_arrays(dangles, ctx->with_gquad)(
+      ctx, string, maxdist, zsc, min_z, core_start, core_end, s_list);
 
   *result = s_list;
 
@@ -298,29 +499,73 @@ PUBLIC float Lfoldz(struct structure_list **result, const char *string,
    *############################################################################
   */
 
-  free(S);
-  free(S1);
-  free_arrays(maxdist);
-
   return (float)energy / 100.;
 }
 
-PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
-                        struct structure_list *s_list) {
+PUBLIC float Lfold_mfe(struct fold_context *ctx, const char *string,
+                       int maxdist) {
+  struct structure_list *s_list = NULL;
+  float energy;
+
+  /* a core before the first position is covered by no structure, so only
+   * the arrays are filled */
+  energy = Lfold_core(ctx, &s_list, string, maxdist, 0, 0.0, 0, 1);
+  free_structure_list(s_list);
+  return energy;
+}
+
+PRIVATE void save_if_covers_core(struct structure_list *list,
+                                 struct secondary_structure *s,
+                                 int core_start, int core_end) {
+  if (s->start <= core_start && s->start + s->n - 1 >= core_end)
+    save_secondary_structure(list, s);
+}
+
+ALWAYS_INLINE PRIVATE int
+fill_arrays(struct fold_context *ctx, const char *string, int maxdist, int zsc,
+            double min_z, int core_start, int core_end,
+            struct structure_list *s_list, const int dangle_model,
+            const int with_gquad) {
+  paramT *P = ctx->P;
+  int **c = ctx->lfold.c;
+  int *cc = ctx->lfold.cc;
+  int *cc1 = ctx->lfold.cc1;
+  int *f3 = ctx->lfold.f3;
+  int **fML = ctx->lfold.fML;
+  int *Fmi = ctx->lfold.Fmi;
+  int *DMLi = ctx->lfold.DMLi;
+  int *DMLi1 = ctx->lfold.DMLi1;
+  int *DMLi2 = ctx->lfold.DMLi2;
+  char **ptype = ctx->lfold.ptype;
+  short *S = ctx->lfold.S;
+  short *S1 = ctx->lfold.S1;
+  int **ggg = ctx->lfold.ggg;
+  int **fMLt = ctx->lfold.fMLt;
+  int **cI = ctx->lfold.cI;
+  int **c1n = ctx->lfold.c1n;
+  int **cB = ctx->lfold.cB;
   /* fill "c", "fML" and "f3" arrays and return  optimal energy */
 
+  struct ml_candidates *ml = &ctx->ml;
   int i, j, k, length, energy;
-  int decomp, new_fML;
+  int decomp, new_fML, stem;
   int no_close, type, type_2, tt;
   int fij;
   int lind;
+  int last_i;
+  int sparse = ctx->sparse_ml && (dangle_model == 0 || dangle_model == 2);
+  const int no_closing_gu = no_closingGU;
+  int loops[MAXLOOP + 1][MAXLOOP + 1];
 
   length = (int)strlen(string);
-  /* modified */
-  char *secondary_structure_buffer =
-      (char *)malloc((length + 1) * sizeof(char));
-
-  prev = NULL;
+  make_loop_table(P, loops);
+  if (sparse)
+    prepare_ml_candidates(ml, length);
+  char *buffer = ctx->lfold.buffer;
+
+  /* the last reported structure, saved when the next one is known */
+  struct secondary_structure prev;
+  int prev_n = 0;
   for (j = 0; j < maxdist + 5; j++)
     Fmi[j] = DMLi[j] = DMLi1[j] = DMLi2[j] = INF;
   for (j = length; j > length - maxdist - 4; j--) {
@@ -328,16 +573,20 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
       c[i][j - i] = fML[i][j - i] = INF;
   }
 
-  if (with_gquad) {
-    ggg = get_gquad_L_matrix(S, length - maxdist - 4, maxdist, length, ggg, P);
-  }
+  if (with_gquad)
+    fill_gquad_L_matrix(S, length - maxdist - 4, maxdist, length, ggg, 1, P);
 
-  for (i = length - TURN - 1; i >= 1; i--) { /* i,j in [1..length] */
+  /* A structure found in row i starts at i + 1 and ends at i + maxdist + 4
+   * at the latest, so the rows below last_i cannot reach the end of the
+   * core. The rows on the 3' side are all needed, f3 of the 3' end decides
+   * which structures are found. */
+  last_i = MAX2(1, core_end - maxdist - 5);
+  for (i = length - TURN - 1; i >= last_i; i--) { /* i,j in [1..length] */
     for (j = i + TURN + 1; j <= length && j <= i + maxdist; j++) {
       int p, q;
       type = ptype[i][j - i];
 
-      no_close = (((type == 3) || (type == 4)) && no_closingGU);
+      no_close = (((type == 3) || (type == 4)) && no_closing_gu);
 
       if (type) { /* we have a pair */
         int new_c = 0, stackEnergy = INF;
@@ -352,35 +601,61 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
           closing pair.
           --------------------------------------------------------*/
 
-        for (p = i + 1; p <= MIN2(j - 2 - TURN, i + MAXLOOP + 1); p++) {
-          int minq = j - i + p - MAXLOOP - 2;
-          if (minq < p + 1 + TURN)
-            minq = p + 1 + TURN;
-          for (q = minq; q < j; q++) {
-            type_2 = ptype[p][q - p];
+        if (no_closing_gu) {
+          for (p = i + 1; p <= MIN2(j - 2 - TURN, i + MAXLOOP + 1); p++) {
+            int minq = j - i + p - MAXLOOP - 2;
+            if (minq < p + 1 + TURN)
+              minq = p + 1 + TURN;
+            for (q = minq; q < j; q++) {
+              type_2 = ptype[p][q - p];
 
-            if (type_2 == 0)
-              continue;
-            type_2 = rtype[type_2];
+              if (type_2 == 0)
+                continue;
+              type_2 = rtype[type_2];
 
-            if (no_closingGU)
               if (no_close || (type_2 == 3) || (type_2 == 4))
                 if ((p > i + 1) || (q < j - 1))
                   continue; /* continue unless stack */
 
+              energy = E_IntLoop(p - i - 1, j - q - 1, type, type_2,
+                                 S1[i + 1], S1[j - 1], S1[p - 1], S1[q + 1],
+                                 P);
+              new_c = MIN2(new_c, energy + c[p][q - p]);
+              if ((p == i + 1) && (j == q + 1))
+                stackEnergy = energy; /* remember stack energy */
+            } /* end q-loop */
+          }   /* end p-loop */
+        } else {
+          int s;
+          for (s = 0; s < (int)(sizeof(small_loops) / sizeof(small_loops[0]));
+               s++) {
+            p = i + 1 + small_loops[s][0];
+            q = j - 1 - small_loops[s][1];
+            if (q < p + 1 + TURN)
+              continue;
+            type_2 = ptype[p][q - p];
+            if (type_2 == 0)
+              continue;
+            type_2 = rtype[type_2];
             energy = E_IntLoop(p - i - 1, j - q - 1, type, type_2, S1[i + 1],
                                S1[j - 1], S1[p - 1], S1[q + 1], P);
             new_c = MIN2(new_c, energy + c[p][q - p]);
-            if ((p == i + 1) && (j == q + 1))
+            if (s == 0)
               stackEnergy = energy; /* remember stack energy */
-          }                         /* end q-loop */
-        }                           /* end p-loop */
+          }
+          new_c = MIN2(
+              new_c,
+              generic_loops(cB, c1n, cI, (const int(*)[MAXLOOP + 1])loops, i,
+                            j, (type > 2) ? P->TerminalAU : 0,
+                            P->mismatch1nI[type][S1[i + 1]][S1[j - 1]],
+                            P->mismatchI[type][S1[i + 1]][S1[j - 1]]));
+        }
 
         /* multi-loop decomposition ------------------------*/
         if (!no_close) {
           decomp = DMLi1[j - 1 - (i + 1)];
           tt = rtype[type];
-          switch (dangles) {
+          switch (dangle_model) {
           /* no dangles */
           case 0:
             decomp += E_MLstem(tt, -1, -1, P);
@@ -408,7 +683,7 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
 
         /* coaxial stacking of (i.j) with (i+1.k) or (k+1.j-1) */
 
-        if (dangles == 3) {
+        if (dangle_model == 3) {
           decomp = INF;
           for (k = i + 2 + TURN; k < j - 2 - TURN; k++) {
             type_2 = ptype[i + 1][k - i - 1];
@@ -451,23 +726,35 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
       else
         c[i][j - i] = INF;
 
+      if (!no_closing_gu) {
+        /* (i,j) as the inner pair of the loops of the rows to come */
+        int r = i % LOOP_RING;
+        type_2 = rtype[type];
+        cI[r][j - i] =
+            c[i][j - i] + P->mismatchI[type_2][S1[j + 1]][S1[i - 1]];
+        c1n[r][j - i] =
+            c[i][j - i] + P->mismatch1nI[type_2][S1[j + 1]][S1[i - 1]];
+        cB[r][j - i] = c[i][j - i] + ((type_2 > 2) ? P->TerminalAU : 0);
+      }
+
       /* done with c[i,j], now compute fML[i,j] */
       /* free ends ? -----------------------------------------*/
-      new_fML = INF;
-      switch (dangles) {
+      new_fML = stem = INF;
+      switch (dangle_model) {
       /* no dangles */
       case 0:
+        stem = c[i][j - i] + E_MLstem(type, -1, -1, P);
         new_fML = fML[i + 1][j - i - 1] + P->MLbase;
         new_fML = MIN2(new_fML, fML[i][j - 1 - i] + P->MLbase);
-        new_fML = MIN2(new_fML, c[i][j - i] + E_MLstem(type, -1, -1, P));
+        new_fML = MIN2(new_fML, stem);
         break;
       /* double dangles */
       case 2:
+        stem = c[i][j - i] + E_MLstem(type, (i > 1) ? S1[i - 1] : -1,
+                                      (j < length) ? S1[j + 1] : -1, P);
         new_fML = fML[i + 1][j - i - 1] + P->MLbase;
         new_fML = MIN2(fML[i][j - 1 - i] + P->MLbase, new_fML);
-        new_fML = MIN2(new_fML, c[i][j - i] +
-                                    E_MLstem(type, (i > 1) ? S1[i - 1] : -1,
-                                             (j < length) ? S1[j + 1] : -1, P));
+        new_fML = MIN2(new_fML, stem);
         break;
       /* normal dangles, aka dangles = 1 */
       default: /* i unpaired */
@@ -497,18 +784,29 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
       }
 
       if (with_gquad) {
+        stem = MIN2(stem, ggg[i][j - i] + E_MLstem(0, -1, -1, P));
         new_fML = MIN2(new_fML, ggg[i][j - i] + E_MLstem(0, -1, -1, P));
       }
 
       /* modular decomposition -------------------------------*/
-      for (decomp = INF, k = i + 1 + TURN; k <= j - 2 - TURN; k++)
-        decomp = MIN2(decomp, Fmi[k - i] + fML[k + 1][j - k - 1]);
+      if (sparse) {
+        /* one stem starting at i, the bases after it up to j unpaired */
+        int fm1 = (j > i + TURN + 1) ? ml->fM1[j - 1] + P->MLbase : INF;
+        ml->fM1[j] = fm1 = MIN2(fm1, stem);
+        decomp = ml_decomposition(ml, j, Fmi, i);
+        if (fm1 < decomp && fm1 < INF)
+          add_ml_candidate(ml, j, i, fm1);
+      } else {
+        /* k from i + 1 + TURN to j - 2 - TURN */
+        decomp = ml_split(Fmi + 1 + TURN, fMLt[j] + i + 2 + TURN - j + maxdist,
+                          j - i - 2 * TURN - 2);
+      }
 
       DMLi[j - i] = decomp; /* store for use in ML decompositon */
       new_fML = MIN2(new_fML, decomp);
 
       /* coaxial stacking */
-      if (dangles == 3) {
+      if (dangle_model == 3) {
         /* additional ML decomposition as two coaxially stacked helices */
         for (decomp = INF, k = i + 1 + TURN; k <= j - 2 - TURN; k++) {
           type = ptype[i][k - i];
@@ -532,16 +830,16 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
         new_fML = MIN2(new_fML, decomp);
       }
       fML[i][j - i] = Fmi[j - i] = new_fML; /* substring energy */
+      if (!sparse)
+        fMLt[j][i - j + maxdist] = new_fML;
     }                                       /* for (j...) */
 
     /* calculate energies of 5' and 3' fragments */
     {
       static int do_backtrack = 0, prev_i = 0;
 #pragma omp threadprivate(do_backtrack, prev_i)
-      char *ss = NULL;
-      double prevz;
       f3[i] = f3[i + 1];
-      switch (dangles) {
+      switch (dangle_model) {
       /* dont use dangling end and mismatch contributions at all */
       case 0:
         for (j = i + TURN + 1; j < length && j <= i + maxdist; j++) {
@@ -659,7 +957,7 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
         for (pairpartner = lind + TURN; pairpartner <= lind + maxdist;
              pairpartner++) {
           type = ptype[lind][pairpartner - lind];
-          switch (dangles) {
+          switch (dangle_model) {
           case 0:
             if (type) {
               cc = c[lind][pairpartner - lind] + E_ExtLoop(type, -1, -1, P);
@@ -731,74 +1029,39 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
         if (zsc) {
 
         } else {
-          /* original code for Lfold*/
-          ss = backtrack(string, lind, pairpartner + 1);
-          if (prev) {
-            if ((i + strlen(ss) < prev_i + strlen(prev)) ||
-                strncmp(ss + prev_i - i, prev, strlen(prev))) {
-              /* ss does not contain prev */
-              if (dangles == 2) {
-                sprintf(secondary_structure_buffer, ".%s", prev);
-                save_secondary_structure(
-                    s_list, secondary_structure_buffer,
-                    (f3[prev_i] - f3[prev_i + strlen(prev) - 1]) / 100.,
-                    prev_i - 1);
-
-                // printf(".%s (%6.2f) %4d\n", prev,
-                //        (f3[prev_i] - f3[prev_i + strlen(prev) - 1]) / 100.,
-                //        prev_i - 1);
-              } else {
-                sprintf(secondary_structure_buffer, "%s", prev);
-                save_secondary_structure(
-                    s_list, secondary_structure_buffer,
-                    (f3[prev_i] - f3[prev_i + strlen(prev)]) / 100., prev_i);
-                // printf("%s (%6.2f) %4d\n", prev,
-                //        (f3[prev_i] - f3[prev_i + strlen(prev)]) / 100.,
-                //        prev_i);
-              }
-            }
-            free(prev);
+          /* original code for Lfold, only the length of the structure is
+           * backtracked here, the string when it is asked for */
+          int n = backtrack(ctx, buffer, lind, pairpartner + 1, 1);
+          if (prev_n > 0) {
+            /* whether it is part of the new one is decided on demand */
+            prev.may_be_contained = (i + n >= prev_i + prev_n);
+            prev.next_start = lind;
+            prev.next_end = pairpartner + 1;
+            save_if_covers_core(s_list, &prev, core_start, core_end);
           }
-          prev = ss;
+          prev.backtrack_start = lind;
+          prev.backtrack_end = pairpartner + 1;
+          if (dangle_model == 2) {
+            prev.mfe = (f3[lind] - f3[lind + n - 1]) / 100.;
+            prev.start = lind - 1;
+            prev.n = n + 1;
+            prev.is_dotted = 1;
+          } else {
+            prev.mfe = (f3[lind] - f3[lind + n]) / 100.;
+            prev.start = lind;
+            prev.n = n;
+            prev.is_dotted = 0;
+          }
+          prev_n = n;
           prev_i = lind;
           do_backtrack = 0;
         }
       }
-      if (i == 1) {
-        if (prev) {
-          if (zsc) {
-            if (dangles == 2) {
-              printf(".%s (%6.2f) %4d z= %.2f\n", prev,
-                     (f3[prev_i] - f3[prev_i + strlen(prev) - 1]) / 100.,
-                     prev_i - 1, prevz);
-            } else {
-              printf("%s (%6.2f) %4dz= %.2f \n", prev,
-                     (f3[prev_i] - f3[prev_i + strlen(prev)]) / 100., prev_i,
-                     prevz);
-            }
-            free(prev);
-            prev = NULL;
-          } else {
-            if (dangles == 2) {
-              sprintf(secondary_structure_buffer, ".%s", prev);
-              save_secondary_structure(
-                  s_list, secondary_structure_buffer,
-                  (f3[prev_i] - f3[prev_i + strlen(prev) - 1]) / 100.,
-                  prev_i - 1);
-
-              // printf(".%s (%6.2f) %4d\n", prev,
-              //        (f3[prev_i] - f3[prev_i + strlen(prev) - 1]) / 100.,
-              //        prev_i - 1);
-            } else {
-              sprintf(secondary_structure_buffer, "%s", prev);
-              save_secondary_structure(
-                  s_list, secondary_structure_buffer,
-                  (f3[prev_i] - f3[prev_i + strlen(prev)]) / 100., prev_i);
-
-              // printf("%s (%6.2f) %4d\n", prev,
-              //        (f3[prev_i] - f3[prev_i + strlen(prev)]) / 100.,
-              //        prev_i);
-            }
+      if (i == last_i) {
+        if (prev_n > 0) {
+          if (!zsc) {
+            prev.may_be_contained = 0;
+            save_if_covers_core(s_list, &prev, core_start, core_end);
           }
         } else if ((f3[i] < 0) && (!zsc))
           do_backtrack = 1;
@@ -819,7 +1082,7 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
           for (pairpartner = lind + TURN; pairpartner <= lind + maxdist;
                pairpartner++) {
             type = ptype[lind][pairpartner - lind];
-            switch (dangles) {
+            switch (dangle_model) {
             case 0:
               if (type) {
                 cc = c[lind][pairpartner - lind] + E_ExtLoop(type, -1, -1, P);
@@ -893,19 +1156,20 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
           if (zsc) {
 
           } else {
-            ss = backtrack(string, lind, pairpartner + 1);
-            if (dangles == 2) {
-              save_secondary_structure(
-                  s_list, ss, (f3[lind] - f3[lind + strlen(ss) - 1]) / 100., 1);
-              // printf("%s (%6.2f) %4d\n", ss,
-              //        (f3[lind] - f3[lind + strlen(ss) - 1]) / 100., 1);
+            struct secondary_structure last;
+            int n = backtrack(ctx, buffer, lind, pairpartner + 1, 1);
+            if (dangle_model == 2) {
+              last.mfe = (f3[lind] - f3[lind + n - 1]) / 100.;
             } else {
-              save_secondary_structure(
-                  s_list, ss, (f3[lind] - f3[lind + strlen(ss)]) / 100., 1);
-              // printf("%s (%6.2f) %4d\n", ss,
-              //        (f3[lind] - f3[lind + strlen(ss)]) / 100., 1);
+              last.mfe = (f3[lind] - f3[lind + n]) / 100.;
             }
-            free(ss);
+            last.start = 1;
+            last.n = n;
+            last.backtrack_start = lind;
+            last.backtrack_end = pairpartner + 1;
+            last.is_dotted = 0;
+            last.may_be_contained = 0;
+            save_if_covers_core(s_list, &last, core_start, core_end);
           }
         }
         do_backtrack = 0;
@@ -923,19 +1187,17 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
       for (j = 0; j < maxdist + 5; j++) {
         cc[j] = Fmi[j] = DMLi[j] = INF;
       }
+      /* the column that leaves the window */
+      if (sparse && i + maxdist <= length)
+        ml->count[i + maxdist] = 0;
       if (i + maxdist + 4 <= length) {
-        c[i - 1] = c[i + maxdist + 4];
-        c[i + maxdist + 4] = NULL;
-        fML[i - 1] = fML[i + maxdist + 4];
-        fML[i + maxdist + 4] = NULL;
-        ptype[i - 1] = ptype[i + maxdist + 4];
-        ptype[i + maxdist + 4] = NULL;
+        /* the rows that leave the window are kept for the backtracking */
+        memset(ptype[i - 1], 0, sizeof(char) * (maxdist + 5));
         if (i > 1) {
-          make_ptypes(S, i - 1, maxdist, length);
+          make_ptypes(ctx, S, i - 1, maxdist, length);
 
-          if (with_gquad) {
-            ggg = get_gquad_L_matrix(S, i - 1, maxdist, length, ggg, P);
-          }
+          if (with_gquad)
+            fill_gquad_L_matrix(S, i - 1, maxdist, length, ggg, 0, P);
         }
         for (ii = 0; ii < maxdist + 5; ii++) {
           c[i - 1][ii] = INF;
@@ -944,13 +1206,62 @@ PRIVATE int fill_arrays(const char *string, int maxdist, int zsc, double min_z,
       }
     }
   }
-  /* modified */
-  free(secondary_structure_buffer);
+  return f3[last_i];
+}
+
+/* The instances of fill_arrays() for every dangle model with and without
+ * g-quadruplexes. The settings are constants in each of them, so their
+ * branches are gone from the inner loops. */
+#define FILL_ARRAYS_INSTANCE(d, g)                                             \
+  PRIVATE int fill_arrays_d##d##_g##g(                                         \
+      struct fold_context *ctx, const char *string, int maxdist, int zsc,      \
+      double min_z, int core_start, int core_end,                              \
+      struct structure_list *s_list) {                                         \
+    return fill_arrays(ctx, string, maxdist, zsc, min_z, core_start,           \
+                       core_end, s_list, d, g);                                \
+  }
 
-  return f3[1];
+FILL_ARRAYS_INSTANCE(0, 0)
+FILL_ARRAYS_INSTANCE(0, 1)
+FILL_ARRAYS_INSTANCE(1, 0)
+FILL_ARRAYS_INSTANCE(1, 1)
+FILL_ARRAYS_INSTANCE(2, 0)
+FILL_ARRAYS_INSTANCE(2, 1)
+FILL_ARRAYS_INSTANCE(3, 0)
+FILL_ARRAYS_INSTANCE(3, 1)
+
+/* Selects the instance once per call. */
+PRIVATE fill_arrays_fn get_fill_arrays(int dangle_model, int with_gquad) {
+  static const fill_arrays_fn instances[4][2] = {
+      {fill_arrays_d0_g0, fill_arrays_d0_g1},
+      {fill_arrays_d1_g0, fill_arrays_d1_g1},
+      {fill_arrays_d2_g0, fill_arrays_d2_g1},
+      {fill_arrays_d3_g0, fill_arrays_d3_g1}};
+  /* the recursions treat any other value as dangles = 1 */
+  if (dangle_model < 0 || dangle_model > 3)
+    dangle_model = 1;
+  return instances[dangle_model][with_gquad != 0];
 }
 
-PRIVATE char *backtrack(const char *string, int start, int maxdist) {
+/*--------------------------------------------------------------------------*/
+
+/* Writes the structure into the buffer, which has room for
+ * MIN2(length - start, maxdist) + 3 characters, and returns its length. With
+ * outer_only only the pairs of the exterior loop are traced, which is enough
+ * for the length. */
+PRIVATE int backtrack(struct fold_context *ctx, char *structure, int start,
+                      int maxdist, int outer_only) {
+  paramT *P = ctx->P;
+  const char *string = ctx->lfold.sequence;
+  int **c = ctx->lfold.c;
+  int *f3 = ctx->lfold.f3;
+  int **fML = ctx->lfold.fML;
+  char **ptype = ctx->lfold.ptype;
+  short *S = ctx->lfold.S;
+  short *S1 = ctx->lfold.S1;
+  unsigned int length = ctx->lfold.length;
+  int with_gquad = ctx->with_gquad;
+  int **ggg = ctx->lfold.ggg;
   /*------------------------------------------------------------------
     trace back through the "c", "f3" and "fML" arrays to get the
     base pairing list. No search for equivalent structures is done.
@@ -958,7 +1269,6 @@ PRIVATE char *backtrack(const char *string, int start, int maxdist) {
     ------------------------------------------------------------------*/
   sect sector[MAXSECTORS]; /* backtracking sectors */
   int i, j, k, energy, new, no_close, type, type_2, tt, s = 0;
-  char *structure;
 
   /* length = strlen(string); */
   sector[++s].i = start;
@@ -966,9 +1276,9 @@ PRIVATE char *backtrack(const char *string, int start, int maxdist) {
   sector[s].ml =
       (backtrack_type == 'M') ? 1 : ((backtrack_type == 'C') ? 2 : 0);
 
-  structure = (char *)space((MIN2(length - start, maxdist) + 3) * sizeof(char));
   for (i = 0; i <= MIN2(length - start, maxdist); i++)
     structure[i] = '-';
+  structure[i] = '\0';
 
   while (s > 0) {
     int ml, fij, cij, traced, i1, j1, d3, d5, mm, mm5, mm3, mm53, p, q, jj = 0,
@@ -1106,6 +1416,10 @@ PRIVATE char *backtrack(const char *string, int start, int maxdist) {
       j = k;
 
       if (with_gquad && gq) {
+        if (outer_only) {
+          structure[i - start] = structure[j - start] = '+';
+          continue;
+        }
         /* goto backtrace of gquadruplex */
         goto repeat_gquad;
       }
@@ -1114,6 +1428,8 @@ PRIVATE char *backtrack(const char *string, int start, int maxdist) {
       structure[j - start] = ')';
       if (((jj == j + 2) || (dangles == 2)) && (j < length))
         structure[j + 1 - start] = '.';
+      if (outer_only)
+        continue;
       goto repeat1;
     } else {                                      /* trace back in fML array */
       if (fML[i][j - 1 - i] + P->MLbase == fij) { /* 3' end is unpaired */
@@ -1437,23 +1753,26 @@ PRIVATE char *backtrack(const char *string, int start, int maxdist) {
 
   for (i = strlen(structure) - 1; i > 0 && structure[i] == '-'; i--)
     structure[i] = '\0';
+  k = i + 1;
   for (; i >= 0; i--)
     if (structure[i] == '-')
       structure[i] = '.';
 
-  return structure;
+  return k;
 }
 
-PRIVATE void update_fold_params(void) {
-  if (P)
-    free(P);
-  P = scale_parameters();
+PRIVATE void update_fold_params(struct fold_context *ctx) {
+  if (ctx->P)
+    free(ctx->P);
+  ctx->P = scale_parameters();
   make_pair_matrix();
 }
 
 /*---------------------------------------------------------------------------*/
 
-PRIVATE void make_ptypes(const short *S, int i, int maxdist, int n) {
+PRIVATE void make_ptypes(struct fold_context *ctx, const short *S, int i,
+                         int maxdist, int n) {
+  char **ptype = ctx->lfold.ptype;
   int j, k, type;
 
   for (k = TURN + 1; k < maxdist; k++) {
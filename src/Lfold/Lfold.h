@@ -1,28 +1,43 @@
 #include <stddef.h>
+#include "fold_context.h"
 
 #ifndef __VIENNA_RNA_PACKAGE_LFOLD_H__
 #define __VIENNA_RNA_PACKAGE_LFOLD_H__
 
 /* custom methods */
 
+/* A local structure reported by Lfold(). Only its position and energy are
+ * known, the dot bracket string is NULL until backtrack_secondary_structure()
+ * computes it from the arrays Lfold() left in the context. */
 struct secondary_structure {
   double mfe;
   int start;
+  int n; /* length of the structure string */
   char *structure_string;
+  int backtrack_start; /* the interval backtracked in the f3 array */
+  int backtrack_end;
+  int is_dotted;        /* the string starts with an extra '.' */
+  int may_be_contained; /* may be part of the structure found after it */
+  int next_start;       /* the interval of that structure */
+  int next_end;
 };
 
 struct structure_list {
-  struct secondary_structure **structures;
+  struct secondary_structure *structures;
   size_t capacity;
   size_t n;
 };
 
 int create_structure_list(struct structure_list **list);
 int save_secondary_structure(struct structure_list *list,
-                             char *structure_string, double mfe, int start);
+                             struct secondary_structure *s);
+int backtrack_secondary_structure(struct fold_context *ctx,
+                                  struct secondary_structure *s);
+int is_contained_structure(struct fold_context *ctx,
+                           struct secondary_structure *s);
 
 void free_structure_list(struct structure_list *list);
-void free_secondary_structure(struct secondary_structure *s);
+void free_Lfold_arrays(struct fold_context *ctx);
 
 /**
  */
@@ -54,25 +69,69 @@ void free_secondary_structure(struct secondary_structure *s);
  *
  *  \ingroup local_mfe_fold
  *
+ *  \param ctx
  *  \param string
  *  \param structure
  *  \param maxdist
  */
-float Lfold(struct structure_list **result, const char *string, int maxdist);
+float Lfold(struct fold_context *ctx, struct structure_list **result,
+            const char *string, int maxdist);
 
 /**
  *  \brief
  *
  *  \ingroup local_mfe_fold
  *
+ *  \param ctx
  *  \param string
  *  \param structure
  *  \param maxdist
  *  \param zsc
  *  \param min_z
  */
-float Lfoldz(struct structure_list **result, const char *string, int maxdist,
-             int zsc, double min_z);
+float Lfoldz(struct fold_context *ctx, struct structure_list **result,
+             const char *string, int maxdist, int zsc, double min_z);
+
+/**
+ *  \brief Lfoldz() that only reports the structures that contain a core
+ *  region
+ *
+ *  Only structures that start at or before core_start and end at or after
+ *  core_end (1-based) are reported, they are the same as the ones Lfoldz()
+ *  reports. The rows of the arrays whose structures cannot reach the core are
+ *  not filled.
+ *
+ *  \ingroup local_mfe_fold
+ *
+ *  \param ctx
+ *  \param result
+ *  \param string
+ *  \param maxdist
+ *  \param zsc
+ *  \param min_z
+ *  \param core_start
+ *  \param core_end
+ *  \return The energy of the part that was folded
+ */
+float Lfold_core(struct fold_context *ctx, struct structure_list **result,
+                 const char *string, int maxdist, int zsc, double min_z,
+                 int core_start, int core_end);
+
+/**
+ *  \brief The minimum free energy of the whole sequence if only base pairs
+ *  with a span smaller than 'maxdist' are allowed
+ *
+ *  This is the energy f3[1] of the arrays Lfold() fills, no structure is
+ *  reported.
+ *
+ *  \ingroup local_mfe_fold
+ *
+ *  \param ctx
+ *  \param string
+ *  \param maxdist
+ *  \return The minimum free energy (kcal/mol)
+ */
+float Lfold_mfe(struct fold_context *ctx, const char *string, int maxdist);
 
 /**
  *  \addtogroup local_consensus_fold
@@ -30,6 +30,8 @@
 #include "data_structures.h"
 #include "gquad.h"
 #include "fold.h"
+#include "fold_batch.h"
+#include "Lfold.h"
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -38,7 +40,6 @@
 #define PAREN
 #define STACK_BULGE1 1 /* stacking energies for bulges of size 1 */
 #define NEW_NINIO 1    /* new asymetry penalty */
-#define MAXSECTORS 500 /* dimension for a backtrack array */
 #define LOCALITY 0.    /* locality parameter for base-pairs */
 
 #define SAME_STRAND(I, J) (((I) >= cut_point) || ((J) < cut_point))
@@ -54,92 +55,37 @@ PUBLIC int uniq_ML = 0;    /* do ML decomposition uniquely (for subopt) */
 PUBLIC int cut_point = -1; /* set to first pos of second seq for cofolding */
 PUBLIC int eos_debug = 0;  /* verbose info from energy_of_struct */
 
-/*
-#################################
-# PRIVATE VARIABLES             #
-#################################
-*/
-PRIVATE int *indx =
-    NULL; /* index for moving in the triangle matrices c[] and fMl[]*/
-PRIVATE int *c = NULL;   /* energy array, given that i-j pair */
-PRIVATE int *cc = NULL;  /* linear array for calculating canonical structures */
-PRIVATE int *cc1 = NULL; /*   "     "        */
-PRIVATE int *f5 = NULL;  /* energy of 5' end */
-PRIVATE int *f53 =
-    NULL; /* energy of 5' end with 3' nucleotide not available for mismatches */
-PRIVATE int *fML = NULL;    /* multi-loop auxiliary energy array */
-PRIVATE int *fM1 = NULL;    /* second ML array, only for subopt */
-PRIVATE int *fM2 = NULL;    /* fM2 = multiloop region with exactly two stems,
-                               extending to 3' end        */
-PRIVATE int *Fmi = NULL;    /* holds row i of fML (avoids jumps in memory) */
-PRIVATE int *DMLi = NULL;   /* DMLi[j] holds MIN(fML[i,k]+fML[k+1,j])  */
-PRIVATE int *DMLi1 = NULL;  /*             MIN(fML[i+1,k]+fML[k+1,j])  */
-PRIVATE int *DMLi2 = NULL;  /*             MIN(fML[i+2,k]+fML[k+1,j])  */
-PRIVATE int *DMLi_a = NULL; /* DMLi_a[j] holds min energy for at least two
-                               multiloop stems in [i,j], where j is available
-                               for dangling onto a surrounding stem */
-PRIVATE int *DMLi_o = NULL; /* DMLi_o[j] holds min energy for at least two
-                               multiloop stems in [i,j], where j is unavailable
-                               for dangling onto a surrounding stem */
-PRIVATE int *DMLi1_a = NULL;
-PRIVATE int *DMLi1_o = NULL;
-PRIVATE int *DMLi2_a = NULL;
-PRIVATE int *DMLi2_o = NULL;
-PRIVATE int Fc, FcH, FcI, FcM; /* parts of the exterior loop energies */
-PRIVATE sect
-    sector[MAXSECTORS];     /* stack of partial structures for backtracking */
-PRIVATE char *ptype = NULL; /* precomputed array of pair types */
-PRIVATE short *S = NULL, *S1 = NULL;
-PRIVATE paramT *P = NULL;
-PRIVATE int init_length = -1;
-PRIVATE int *BP = NULL;           /* contains the structure constrainsts: BP[i]
-                              -1: | = base must be paired
-                              -2: < = base must be paired with j<i
-                              -3: > = base must be paired with j>i
-                              -4: x = base must not pair
-                              positive int: base is paired with int      */
-PRIVATE short *pair_table = NULL; /* needed by energy of struct */
-PRIVATE bondT *base_pair2 = NULL; /* this replaces base_pair from fold_vars.c */
-PRIVATE int circular = 0;
-PRIVATE int struct_constrained = 0;
-PRIVATE int with_gquad = 0;
-
-PRIVATE int *ggg = NULL; /* minimum free energies of the gquadruplexes */
-
-#ifdef _OPENMP
-
-#pragma omp threadprivate(indx, c, cc, cc1, f5, f53, fML, fM1, fM2, Fmi, DMLi, \
-                          DMLi1, DMLi2, DMLi_a, DMLi_o, DMLi1_a, DMLi1_o,      \
-                          DMLi2_a, DMLi2_o, Fc, FcH, FcI, FcM, sector, ptype,  \
-                          S, S1, P, init_length, BP, pair_table, base_pair2,   \
-                          circular, struct_constrained, ggg, with_gquad)
-
-#endif
-
 /*
 #################################
 # PRIVATE FUNCTION DECLARATIONS #
 #################################
 */
-PRIVATE void get_arrays(unsigned int size);
-PRIVATE int stack_energy(int i, const char *string, int verbostiy_level);
-PRIVATE int energy_of_extLoop_pt(int i, short *pair_table);
-PRIVATE int energy_of_ml_pt(int i, short *pt);
-PRIVATE int ML_Energy(int i, int is_extloop);
-PRIVATE void make_ptypes(const short *S, const char *structure, paramT *P);
-PRIVATE void backtrack(const char *sequence, int s);
-PRIVATE int fill_arrays(const char *sequence);
-PRIVATE void fill_arrays_circ(const char *string, int *bt);
-PRIVATE void init_fold(int length, paramT *parameters);
+PRIVATE void get_arrays(struct fold_context *ctx, unsigned int size);
+PRIVATE int stack_energy(struct fold_context *ctx, int i, const char *string,
+                         int verbostiy_level);
+PRIVATE int energy_of_extLoop_pt(struct fold_context *ctx, int i,
+                                 short *pair_table);
+PRIVATE int energy_of_ml_pt(struct fold_context *ctx, int i, short *pt);
+PRIVATE int ML_Energy(struct fold_context *ctx, int i, int is_extloop);
+PRIVATE void make_ptypes(struct fold_context *ctx, const short *S,
+                         const char *structure, paramT *P);
+PRIVATE void backtrack(struct fold_context *ctx, const char *sequence, int s);
+PRIVATE int fill_arrays(struct fold_context *ctx, const char *sequence);
+PRIVATE void fill_arrays_circ(struct fold_context *ctx, const char *string,
+                              int *bt);
+PRIVATE void init_fold(struct fold_context *ctx, int length,
+                       paramT *parameters);
 /* needed by cofold/eval */
-PRIVATE int cut_in_loop(int i);
+PRIVATE int cut_in_loop(struct fold_context *ctx, int i);
 
 /* deprecated functions */
 /*@unused@*/
-int oldLoopEnergy(int i, int j, int p, int q, int type, int type_2);
-int LoopEnergy(int n1, int n2, int type, int type_2, int si1, int sj1, int sp1,
-               int sq1);
-int HairpinE(int size, int type, int si1, int sj1, const char *string);
+int oldLoopEnergy(struct fold_context *ctx, int i, int j, int p, int q,
+                  int type, int type_2);
+int LoopEnergy(struct fold_context *ctx, int n1, int n2, int type, int type_2,
+               int si1, int sj1, int sp1, int sq1);
+int HairpinE(struct fold_context *ctx, int size, int type, int si1, int sj1,
+             const char *string);
 
 /*
 #################################
@@ -147,8 +93,31 @@ int HairpinE(int size, int type, int si1, int sj1, const char *string);
 #################################
 */
 
+PUBLIC int create_fold_context(struct fold_context **ctx) {
+  struct fold_context *tmp =
+      (struct fold_context *)calloc(1, sizeof(struct fold_context));
+  if (tmp == NULL)
+    return 1;
+  tmp->init_length = -1;
+  *ctx = tmp;
+  return 0;
+}
+
+PUBLIC void free_fold_context(struct fold_context *ctx) {
+  if (ctx == NULL)
+    return;
+  free_arrays(ctx);
+  free_batch_arrays(ctx);
+  free_Lfold_arrays(ctx);
+  free_ml_candidates(&ctx->ml);
+  free(ctx);
+}
+
+/*--------------------------------------------------------------------------*/
+
 /* allocate memory for folding process */
-PRIVATE void init_fold(int length, paramT *parameters) {
+PRIVATE void init_fold(struct fold_context *ctx, int length,
+                       paramT *parameters) {
 
 #ifdef _OPENMP
   /* Explicitly turn off dynamic threads */
@@ -157,249 +126,242 @@ PRIVATE void init_fold(int length, paramT *parameters) {
 
   if (length < 1)
     nrerror("initialize_fold: argument must be greater 0");
-  free_arrays();
-  get_arrays((unsigned)length);
-  init_length = length;
+  free_arrays(ctx);
+  get_arrays(ctx, (unsigned)length);
+  ctx->init_length = length;
 
-  indx = get_indx((unsigned)length);
+  ctx->indx = get_indx((unsigned)length);
 
-  update_fold_params_par(parameters);
+  update_fold_params_par(ctx, parameters);
 }
 
 /*--------------------------------------------------------------------------*/
 
-PRIVATE void get_arrays(unsigned int size) {
+PRIVATE void get_arrays(struct fold_context *ctx, unsigned int size) {
+  int circular = ctx->circular;
   if (size >= (unsigned int)sqrt((double)INT_MAX))
     nrerror("get_arrays@fold.c: sequence length exceeds addressable range");
 
-  c = (int *)space(sizeof(int) * ((size * (size + 1)) / 2 + 2));
-  fML = (int *)space(sizeof(int) * ((size * (size + 1)) / 2 + 2));
+  ctx->c = (int *)space(sizeof(int) * ((size * (size + 1)) / 2 + 2));
+  ctx->fML = (int *)space(sizeof(int) * ((size * (size + 1)) / 2 + 2));
   if (uniq_ML)
-    fM1 = (int *)space(sizeof(int) * ((size * (size + 1)) / 2 + 2));
-
-  ptype = (char *)space(sizeof(char) * ((size * (size + 1)) / 2 + 2));
-  f5 = (int *)space(sizeof(int) * (size + 2));
-  f53 = (int *)space(sizeof(int) * (size + 2));
-  cc = (int *)space(sizeof(int) * (size + 2));
-  cc1 = (int *)space(sizeof(int) * (size + 2));
-  Fmi = (int *)space(sizeof(int) * (size + 1));
-  DMLi = (int *)space(sizeof(int) * (size + 1));
-  DMLi1 = (int *)space(sizeof(int) * (size + 1));
-  DMLi2 = (int *)space(sizeof(int) * (size + 1));
-
-  DMLi_a = (int *)space(sizeof(int) * (size + 1));
-  DMLi_o = (int *)space(sizeof(int) * (size + 1));
-  DMLi1_a = (int *)space(sizeof(int) * (size + 1));
-  DMLi1_o = (int *)space(sizeof(int) * (size + 1));
-  DMLi2_a = (int *)space(sizeof(int) * (size + 1));
-  DMLi2_o = (int *)space(sizeof(int) * (size + 1));
-
-  base_pair2 = (bondT *)space(sizeof(bondT) * (1 + size / 2));
+    ctx->fM1 = (int *)space(sizeof(int) * ((size * (size + 1)) / 2 + 2));
+
+  ctx->ptype = (char *)space(sizeof(char) * ((size * (size + 1)) / 2 + 2));
+  ctx->f5 = (int *)space(sizeof(int) * (size + 2));
+  ctx->f53 = (int *)space(sizeof(int) * (size + 2));
+  ctx->cc = (int *)space(sizeof(int) * (size + 2));
+  ctx->cc1 = (int *)space(sizeof(int) * (size + 2));
+  ctx->Fmi = (int *)space(sizeof(int) * (size + 1));
+  ctx->DMLi = (int *)space(sizeof(int) * (size + 1));
+  ctx->DMLi1 = (int *)space(sizeof(int) * (size + 1));
+  ctx->DMLi2 = (int *)space(sizeof(int) * (size + 1));
+
+  ctx->DMLi_a = (int *)space(sizeof(int) * (size + 1));
+  ctx->DMLi_o = (int *)space(sizeof(int) * (size + 1));
+  ctx->DMLi1_a = (int *)space(sizeof(int) * (size + 1));
+  ctx->DMLi1_o = (int *)space(sizeof(int) * (size + 1));
+  ctx->DMLi2_a = (int *)space(sizeof(int) * (size + 1));
+  ctx->DMLi2_o = (int *)space(sizeof(int) * (size + 1));
+
+  ctx->base_pair2 = (bondT *)space(sizeof(bondT) * (1 + size / 2));
 
   /* extra array(s) for circfold() */
   if (circular)
-    fM2 = (int *)space(sizeof(int) * (size + 2));
+    ctx->fM2 = (int *)space(sizeof(int) * (size + 2));
 }
 
 /*--------------------------------------------------------------------------*/
 
-PUBLIC void free_arrays(void) {
-  if (indx)
-    free(indx);
-  if (c)
-    free(c);
-  if (fML)
-    free(fML);
-  if (f5)
-    free(f5);
-  if (f53)
-    free(f53);
-  if (cc)
-    free(cc);
-  if (cc1)
-    free(cc1);
-  if (ptype)
-    free(ptype);
-  if (fM1)
-    free(fM1);
-  if (fM2)
-    free(fM2);
-  if (base_pair2)
-    free(base_pair2);
-  if (Fmi)
-    free(Fmi);
-  if (DMLi)
-    free(DMLi);
-  if (DMLi1)
-    free(DMLi1);
-  if (DMLi2)
-    free(DMLi2);
-  if (DMLi_a)
-    free(DMLi_a);
-  if (DMLi_o)
-    free(DMLi_o);
-  if (DMLi1_a)
-    free(DMLi1_a);
-  if (DMLi1_o)
-    free(DMLi1_o);
-  if (DMLi2_a)
-    free(DMLi2_a);
-  if (DMLi2_o)
-    free(DMLi2_o);
-  if (P)
-    free(P);
-  if (ggg)
-    free(ggg);
-
-  indx = c = fML = f5 = f53 = cc = cc1 = fM1 = fM2 = Fmi = DMLi = DMLi1 =
-      DMLi2 = ggg = NULL;
-  DMLi_a = DMLi_o = DMLi1_a = DMLi1_o = DMLi2_a = DMLi2_o = NULL;
-  ptype = NULL;
-  base_pair = NULL;
-  base_pair2 = NULL;
-  P = NULL;
-  init_length = 0;
+PUBLIC void free_arrays(struct fold_context *ctx) {
+  if (ctx->indx)
+    free(ctx->indx);
+  if (ctx->c)
+    free(ctx->c);
+  if (ctx->fML)
+    free(ctx->fML);
+  if (ctx->f5)
+    free(ctx->f5);
+  if (ctx->f53)
+    free(ctx->f53);
+  if (ctx->cc)
+    free(ctx->cc);
+  if (ctx->cc1)
+    free(ctx->cc1);
+  if (ctx->ptype)
+    free(ctx->ptype);
+  if (ctx->fM1)
+    free(ctx->fM1);
+  if (ctx->fM2)
+    free(ctx->fM2);
+  if (ctx->base_pair2)
+    free(ctx->base_pair2);
+  if (ctx->Fmi)
+    free(ctx->Fmi);
+  if (ctx->DMLi)
+    free(ctx->DMLi);
+  if (ctx->DMLi1)
+    free(ctx->DMLi1);
+  if (ctx->DMLi2)
+    free(ctx->DMLi2);
+  if (ctx->DMLi_a)
+    free(ctx->DMLi_a);
+  if (ctx->DMLi_o)
+    free(ctx->DMLi_o);
+  if (ctx->DMLi1_a)
+    free(ctx->DMLi1_a);
+  if (ctx->DMLi1_o)
+    free(ctx->DMLi1_o);
+  if (ctx->DMLi2_a)
+    free(ctx->DMLi2_a);
+  if (ctx->DMLi2_o)
+    free(ctx->DMLi2_o);
+  if (ctx->P)
+    free(ctx->P);
+  if (ctx->ggg)
+    free(ctx->ggg);
+
+  ctx->indx = ctx->c = ctx->fML = ctx->f5 = ctx->f53 = ctx->cc = ctx->cc1 =
+      ctx->fM1 = ctx->fM2 = ctx->Fmi = ctx->DMLi = ctx->DMLi1 = ctx->DMLi2 =
+          ctx->ggg = NULL;
+  ctx->DMLi_a = ctx->DMLi_o = ctx->DMLi1_a = ctx->DMLi1_o = ctx->DMLi2_a =
+      ctx->DMLi2_o = NULL;
+  ctx->ptype = NULL;
+  ctx->base_pair2 = NULL;
+  ctx->P = NULL;
+  ctx->init_length = 0;
 }
 
 /*--------------------------------------------------------------------------*/
 
-PUBLIC void export_fold_arrays(int **f5_p, int **c_p, int **fML_p, int **fM1_p,
-                               int **indx_p, char **ptype_p) {
+PUBLIC void export_fold_arrays(struct fold_context *ctx, int **f5_p, int **c_p,
+                               int **fML_p, int **fM1_p, int **indx_p,
+                               char **ptype_p) {
   /* make the DP arrays available to routines such as subopt() */
-  *f5_p = f5;
-  *c_p = c;
-  *fML_p = fML;
-  *fM1_p = fM1;
-  *indx_p = indx;
-  *ptype_p = ptype;
+  *f5_p = ctx->f5;
+  *c_p = ctx->c;
+  *fML_p = ctx->fML;
+  *fM1_p = ctx->fM1;
+  *indx_p = ctx->indx;
+  *ptype_p = ctx->ptype;
 }
 
-PUBLIC void export_fold_arrays_par(int **f5_p, int **c_p, int **fML_p,
-                                   int **fM1_p, int **indx_p, char **ptype_p,
-                                   paramT **P_p) {
-  export_fold_arrays(f5_p, c_p, fML_p, fM1_p, indx_p, ptype_p);
-  *P_p = P;
+PUBLIC void export_fold_arrays_par(struct fold_context *ctx, int **f5_p,
+                                   int **c_p, int **fML_p, int **fM1_p,
+                                   int **indx_p, char **ptype_p, paramT **P_p) {
+  export_fold_arrays(ctx, f5_p, c_p, fML_p, fM1_p, indx_p, ptype_p);
+  *P_p = ctx->P;
 }
 
-PUBLIC void export_circfold_arrays(int *Fc_p, int *FcH_p, int *FcI_p,
-                                   int *FcM_p, int **fM2_p, int **f5_p,
-                                   int **c_p, int **fML_p, int **fM1_p,
-                                   int **indx_p, char **ptype_p) {
+PUBLIC void export_circfold_arrays(struct fold_context *ctx, int *Fc_p,
+                                   int *FcH_p, int *FcI_p, int *FcM_p,
+                                   int **fM2_p, int **f5_p, int **c_p,
+                                   int **fML_p, int **fM1_p, int **indx_p,
+                                   char **ptype_p) {
   /* make the DP arrays available to routines such as subopt() */
-  *f5_p = f5;
-  *c_p = c;
-  *fML_p = fML;
-  *fM1_p = fM1;
-  *fM2_p = fM2;
-  *Fc_p = Fc;
-  *FcH_p = FcH;
-  *FcI_p = FcI;
-  *FcM_p = FcM;
-  *indx_p = indx;
-  *ptype_p = ptype;
+  *f5_p = ctx->f5;
+  *c_p = ctx->c;
+  *fML_p = ctx->fML;
+  *fM1_p = ctx->fM1;
+  *fM2_p = ctx->fM2;
+  *Fc_p = ctx->Fc;
+  *FcH_p = ctx->FcH;
+  *FcI_p = ctx->FcI;
+  *FcM_p = ctx->FcM;
+  *indx_p = ctx->indx;
+  *ptype_p = ctx->ptype;
 }
 
-PUBLIC void export_circfold_arrays_par(int *Fc_p, int *FcH_p, int *FcI_p,
-                                       int *FcM_p, int **fM2_p, int **f5_p,
-                                       int **c_p, int **fML_p, int **fM1_p,
-                                       int **indx_p, char **ptype_p,
-                                       paramT **P_p) {
-  export_circfold_arrays(Fc_p, FcH_p, FcI_p, FcM_p, fM2_p, f5_p, c_p, fML_p,
-                         fM1_p, indx_p, ptype_p);
-  *P_p = P;
+PUBLIC void export_circfold_arrays_par(struct fold_context *ctx, int *Fc_p,
+                                       int *FcH_p, int *FcI_p, int *FcM_p,
+                                       int **fM2_p, int **f5_p, int **c_p,
+                                       int **fML_p, int **fM1_p, int **indx_p,
+                                       char **ptype_p, paramT **P_p) {
+  export_circfold_arrays(ctx, Fc_p, FcH_p, FcI_p, FcM_p, fM2_p, f5_p, c_p,
+                         fML_p, fM1_p, indx_p, ptype_p);
+  *P_p = ctx->P;
 }
 /*--------------------------------------------------------------------------*/
 
-PUBLIC float fold(const char *string, char *structure) {
-  return fold_par(string, structure, NULL, fold_constrained, 0);
+PUBLIC float fold(struct fold_context *ctx, const char *string,
+                  char *structure) {
+  return fold_par(ctx, string, structure, NULL, fold_constrained, 0);
 }
 
-PUBLIC float circfold(const char *string, char *structure) {
-  return fold_par(string, structure, NULL, fold_constrained, 1);
+PUBLIC float circfold(struct fold_context *ctx, const char *string,
+                      char *structure) {
+  return fold_par(ctx, string, structure, NULL, fold_constrained, 1);
 }
 
-PUBLIC float fold_par(const char *string, char *structure, paramT *parameters,
-                      int is_constrained, int is_circular) {
+PUBLIC float fold_par(struct fold_context *ctx, const char *string,
+                      char *structure, paramT *parameters, int is_constrained,
+                      int is_circular) {
 
   int i, length, energy, bonus, bonus_cnt, s;
 
   bonus = 0;
   bonus_cnt = 0;
   s = 0;
-  circular = is_circular;
-  struct_constrained = is_constrained;
+  ctx->circular = is_circular;
+  ctx->struct_constrained = is_constrained;
   length = (int)strlen(string);
 
-#ifdef _OPENMP
-  init_fold(length, parameters);
-#else
+  /* the arrays of the context are reused as long as they are large enough */
   if (parameters)
-    init_fold(length, parameters);
-  else if (length > init_length)
-    init_fold(length, parameters);
-  else if (fabs(P->temperature - temperature) > 1e-6)
-    update_fold_params();
-#endif
-
-  with_gquad = P->model_details.gquad;
-  S = encode_sequence(string, 0);
-  S1 = encode_sequence(string, 1);
-  BP = (int *)space(sizeof(int) * (length + 2));
-  if (with_gquad) { /* add a guess of how many G's may be involved in a G
-                       quadruplex */
-    if (base_pair2)
-      free(base_pair2);
-    base_pair2 = (bondT *)space(sizeof(bondT) * (4 * (1 + length / 2)));
+    init_fold(ctx, length, parameters);
+  else if (length > ctx->init_length)
+    init_fold(ctx, length, parameters);
+  else if ((is_circular && !ctx->fM2) || (uniq_ML && !ctx->fM1))
+    init_fold(ctx, length, parameters);
+  else if (fabs(ctx->P->temperature - temperature) > 1e-6)
+    update_fold_params(ctx);
+
+  ctx->with_gquad = ctx->P->model_details.gquad;
+  ctx->S = encode_sequence(string, 0);
+  ctx->S1 = encode_sequence(string, 1);
+  ctx->BP = (int *)space(sizeof(int) * (length + 2));
+  if (ctx->with_gquad) { /* add a guess of how many G's may be involved in a G
+                            quadruplex */
+    if (ctx->base_pair2)
+      free(ctx->base_pair2);
+    ctx->base_pair2 = (bondT *)space(sizeof(bondT) * (4 * (1 + length / 2)));
   }
 
-  make_ptypes(S, structure, P);
+  make_ptypes(ctx, ctx->S, structure, ctx->P);
 
-  energy = fill_arrays(string);
+  energy = fill_arrays(ctx, string);
 
-  if (circular) {
-    fill_arrays_circ(string, &s);
-    energy = Fc;
+  if (ctx->circular) {
+    fill_arrays_circ(ctx, string, &s);
+    energy = ctx->Fc;
   }
-  backtrack(string, s);
+  backtrack(ctx, string, s);
 
 #ifdef PAREN
-  parenthesis_structure(structure, base_pair2, length);
+  parenthesis_structure(structure, ctx->base_pair2, length);
 #else
-  letter_structure(structure, base_pair2, length);
+  letter_structure(structure, ctx->base_pair2, length);
 #endif
 
-  /*
-  *  Backward compatibility:
-  *  This block may be removed if deprecated functions
-  *  relying on the global variable "base_pair" vanishs from within the package!
-  */
-  base_pair = base_pair2;
-  /*
-  {
-    if(base_pair) free(base_pair);
-    base_pair = (bondT *)space(sizeof(bondT) * (1+length/2));
-    memcpy(base_pair, base_pair2, sizeof(bondT) * (1+length/2));
-  }
-  */
-
   /* check constraints */
   for (i = 1; i <= length; i++) {
-    if ((BP[i] < 0) && (BP[i] > -4)) {
+    if ((ctx->BP[i] < 0) && (ctx->BP[i] > -4)) {
       bonus_cnt++;
-      if ((BP[i] == -3) && (structure[i - 1] == ')'))
+      if ((ctx->BP[i] == -3) && (structure[i - 1] == ')'))
         bonus++;
-      if ((BP[i] == -2) && (structure[i - 1] == '('))
+      if ((ctx->BP[i] == -2) && (structure[i - 1] == '('))
         bonus++;
-      if ((BP[i] == -1) && (structure[i - 1] != '.'))
+      if ((ctx->BP[i] == -1) && (structure[i - 1] != '.'))
         bonus++;
     }
 
-    if (BP[i] > i) {
+    if (ctx->BP[i] > i) {
       int l;
       bonus_cnt++;
-      for (l = 1; l <= base_pair2[0].i; l++)
-        if (base_pair2[l].i != base_pair2[l].j)
-          if ((i == base_pair2[l].i) && (BP[i] == base_pair2[l].j))
+      for (l = 1; l <= ctx->base_pair2[0].i; l++)
+        if (ctx->base_pair2[l].i != ctx->base_pair2[l].j)
+          if ((i == ctx->base_pair2[l].i) &&
+              (ctx->BP[i] == ctx->base_pair2[l].j))
             bonus++;
     }
   }
@@ -408,16 +370,16 @@ PUBLIC float fold_par(const char *string, char *structure, paramT *parameters,
     fprintf(stderr, "\ncould not enforce all constraints\n");
   bonus *= BONUS;
 
-  free(S);
-  free(S1);
-  free(BP);
+  free(ctx->S);
+  free(ctx->S1);
+  free(ctx->BP);
 
   energy += bonus; /*remove bonus energies from result */
 
   if (backtrack_type == 'C')
-    return (float)c[indx[length] + 1] / 100.;
+    return (float)ctx->c[ctx->indx[length] + 1] / 100.;
   else if (backtrack_type == 'M')
-    return (float)fML[indx[length] + 1] / 100.;
+    return (float)ctx->fML[ctx->indx[length] + 1] / 100.;
   else
     return (float)energy / 100.;
 }
@@ -425,25 +387,52 @@ PUBLIC float fold_par(const char *string, char *structure, paramT *parameters,
 /**
 *** fill "c", "fML" and "f5" arrays and return  optimal energy
 **/
-PRIVATE int fill_arrays(const char *string) {
-
+PRIVATE int fill_arrays(struct fold_context *ctx, const char *string) {
+  int *indx = ctx->indx;
+  int *c = ctx->c;
+  int *cc = ctx->cc;
+  int *cc1 = ctx->cc1;
+  int *f5 = ctx->f5;
+  int *fML = ctx->fML;
+  int *fM1 = ctx->fM1;
+  int *Fmi = ctx->Fmi;
+  int *DMLi = ctx->DMLi;
+  int *DMLi1 = ctx->DMLi1;
+  int *DMLi2 = ctx->DMLi2;
+  char *ptype = ctx->ptype;
+  short *S = ctx->S;
+  short *S1 = ctx->S1;
+  paramT *P = ctx->P;
+  int *BP = ctx->BP;
+  int circular = ctx->circular;
+  int with_gquad = ctx->with_gquad;
+  int *ggg = ctx->ggg;
+
+  struct ml_candidates *ml = &ctx->ml;
   int i, j, k, length, energy, en, mm5, mm3;
-  int decomp, new_fML, max_separation;
+  int decomp, new_fML, stem, max_separation;
   int no_close, type, type_2, tt;
   int bonus = 0;
 
-  int dangle_model, noGUclosure, with_gquads;
+  int dangle_model, noGUclosure, with_gquads, sparse;
 
   dangle_model = P->model_details.dangles;
   noGUclosure = P->model_details.noGUclosure;
+  sparse = ctx->sparse_ml && (dangle_model == 0 || dangle_model == 2);
 
   length = (int)strlen(string);
+  if (sparse)
+    prepare_ml_candidates(ml, length);
 
   max_separation =
       (int)((1. - LOCALITY) * (double)(length - 2)); /* not in use */
 
-  if (with_gquad)
+  if (with_gquad) {
+    if (ggg)
+      free(ggg);
     ggg = get_gquad_matrix(S, P);
+    ctx->ggg = ggg;
+  }
 
   for (j = 1; j <= length; j++) {
     Fmi[j] = DMLi[j] = DMLi1[j] = DMLi2[j] = INF;
@@ -622,6 +611,7 @@ PRIVATE int fill_arrays(const char *string) {
       if (uniq_ML) {
         fM1[ij] = MIN2(fM1[indx[j - 1] + i] + P->MLbase, new_fML);
       }
+      stem = new_fML;
 
       /* free ends ? -----------------------------------------*/
       /*  we must not just extend 3'/5' end by unpaired nucleotides if
@@ -664,8 +654,17 @@ PRIVATE int fill_arrays(const char *string) {
       }
 
       /* modular decomposition -------------------------------*/
-      for (decomp = INF, k = i + 1 + TURN; k <= j - 2 - TURN; k++)
-        decomp = MIN2(decomp, Fmi[k] + fML[indx[j] + k + 1]);
+      if (sparse) {
+        /* one stem starting at i, the bases after it up to j unpaired */
+        int fm1 = (j > i + TURN + 1) ? ml->fM1[j - 1] + P->MLbase : INF;
+        ml->fM1[j] = fm1 = MIN2(fm1, stem);
+        decomp = ml_decomposition(ml, j, Fmi, 0);
+        if (fm1 < decomp && fm1 < INF)
+          add_ml_candidate(ml, j, i, fm1);
+      } else {
+        for (decomp = INF, k = i + 1 + TURN; k <= j - 2 - TURN; k++)
+          decomp = MIN2(decomp, Fmi[k] + fML[indx[j] + k + 1]);
+      }
       DMLi[j] = decomp; /* store for use in ML decompositon */
       new_fML = MIN2(new_fML, decomp);
 
@@ -851,7 +850,21 @@ PRIVATE int fill_arrays(const char *string) {
 *** normally s=0.
 *** If s>0 then s items have been already pushed onto the sector stack
 **/
-PRIVATE void backtrack(const char *string, int s) {
+PRIVATE void backtrack(struct fold_context *ctx, const char *string, int s) {
+  int *indx = ctx->indx;
+  int *c = ctx->c;
+  int *f5 = ctx->f5;
+  int *fML = ctx->fML;
+  sect *sector = ctx->sector;
+  char *ptype = ctx->ptype;
+  short *S = ctx->S;
+  short *S1 = ctx->S1;
+  paramT *P = ctx->P;
+  int *BP = ctx->BP;
+  bondT *base_pair2 = ctx->base_pair2;
+  int struct_constrained = ctx->struct_constrained;
+  int with_gquad = ctx->with_gquad;
+  int *ggg = ctx->ggg;
   int i, j, ij, k, l1, mm5, mm3, length, energy, en, new;
   int no_close, type, type_2, tt, minq, maxq, c0, c1, c2, c3;
   int bonus;
@@ -1371,19 +1384,22 @@ PRIVATE void backtrack(const char *string, int s) {
   base_pair2[0].i = b; /* save the total number of base pairs */
 }
 
-PUBLIC char *backtrack_fold_from_pair(char *sequence, int i, int j) {
+PUBLIC char *backtrack_fold_from_pair(struct fold_context *ctx, char *sequence,
+                                      int i, int j) {
+  sect *sector = ctx->sector;
+  bondT *base_pair2 = ctx->base_pair2;
   char *structure;
   sector[1].i = i;
   sector[1].j = j;
   sector[1].ml = 2;
   base_pair2[0].i = 0;
-  S = encode_sequence(sequence, 0);
-  S1 = encode_sequence(sequence, 1);
-  backtrack(sequence, 1);
+  ctx->S = encode_sequence(sequence, 0);
+  ctx->S1 = encode_sequence(sequence, 1);
+  backtrack(ctx, sequence, 1);
   structure = (char *)space((strlen(sequence) + 1) * sizeof(char));
   parenthesis_structure(structure, base_pair2, strlen(sequence));
-  free(S);
-  free(S1);
+  free(ctx->S);
+  free(ctx->S1);
   return structure;
 }
 
@@ -1468,54 +1484,59 @@ PUBLIC void parenthesis_zuker(char *structure, bondT *bp, int length) {
 
 /*---------------------------------------------------------------------------*/
 
-PUBLIC void update_fold_params(void) { update_fold_params_par(NULL); }
+PUBLIC void update_fold_params(struct fold_context *ctx) {
+  update_fold_params_par(ctx, NULL);
+}
 
-PUBLIC void update_fold_params_par(paramT *parameters) {
-  if (P)
-    free(P);
+PUBLIC void update_fold_params_par(struct fold_context *ctx,
+                                   paramT *parameters) {
+  if (ctx->P)
+    free(ctx->P);
   if (parameters) {
-    P = get_parameter_copy(parameters);
+    ctx->P = get_parameter_copy(parameters);
   } else {
     model_detailsT md;
     set_model_details(&md);
-    P = get_scaled_parameters(temperature, md);
+    ctx->P = get_scaled_parameters(temperature, md);
   }
   make_pair_matrix();
-  if (init_length < 0)
-    init_length = 0;
+  if (ctx->init_length < 0)
+    ctx->init_length = 0;
 }
 
 /*---------------------------------------------------------------------------*/
-PUBLIC float energy_of_structure(const char *string, const char *structure,
-                                 int verbosity_level) {
-  return energy_of_struct_par(string, structure, NULL, verbosity_level);
+PUBLIC float energy_of_structure(struct fold_context *ctx, const char *string,
+                                 const char *structure, int verbosity_level) {
+  return energy_of_struct_par(ctx, string, structure, NULL, verbosity_level);
 }
 
-PUBLIC float energy_of_struct_par(const char *string, const char *structure,
-                                  paramT *parameters, int verbosity_level) {
+PUBLIC float energy_of_struct_par(struct fold_context *ctx, const char *string,
+                                  const char *structure, paramT *parameters,
+                                  int verbosity_level) {
   int energy;
   short *ss, *ss1;
 
-  update_fold_params_par(parameters);
+  update_fold_params_par(ctx, parameters);
 
   if (strlen(structure) != strlen(string))
     nrerror("energy_of_struct: string and structure have unequal length");
 
   /* save the S and S1 pointers in case they were already in use */
-  ss = S;
-  ss1 = S1;
-  S = encode_sequence(string, 0);
-  S1 = encode_sequence(string, 1);
+  ss = ctx->S;
+  ss1 = ctx->S1;
+  ctx->S = encode_sequence(string, 0);
+  ctx->S1 = encode_sequence(string, 1);
 
-  pair_table = make_pair_table(structure);
+  ctx->pair_table = make_pair_table(structure);
 
-  energy = energy_of_structure_pt(string, pair_table, S, S1, verbosity_level);
+  energy = energy_of_structure_pt(ctx, string, ctx->pair_table, ctx->S, ctx->S1,
+                                  verbosity_level);
 
-  free(pair_table);
-  free(S);
-  free(S1);
-  S = ss;
-  S1 = ss1;
+  free(ctx->pair_table);
+  free(ctx->S);
+  free(ctx->S1);
+  ctx->S = ss;
+  ctx->S1 = ss1;
   return (float)energy / 100.;
 }
 
@@ -1527,9 +1548,10 @@ PUBLIC float energy_of_struct_par(const char *string, const char *structure,
 
     recursive variant
 */
-PRIVATE int en_corr_of_loop_gquad(int i, int j, const char *string,
-                                  const char *structure, short *pt,
-                                  int *loop_idx, const short *s1) {
+PRIVATE int en_corr_of_loop_gquad(struct fold_context *ctx, int i, int j,
+                                  const char *string, const char *structure,
+                                  short *pt, int *loop_idx, const short *s1) {
+  paramT *P = ctx->P;
 
   int pos, energy, p, q, r, s, u, type, type2;
   int L, l[3];
@@ -1617,7 +1639,7 @@ PRIVATE int en_corr_of_loop_gquad(int i, int j, const char *string,
           num_elem++;
           elem_i = u;
           elem_j = pt[u];
-          energy += en_corr_of_loop_gquad(u, pt[u], string, structure, pt,
+          energy += en_corr_of_loop_gquad(ctx, u, pt[u], string, structure, pt,
                                           loop_idx, s1);
           u = pt[u] + 1;
         }
@@ -1666,14 +1688,17 @@ PRIVATE int en_corr_of_loop_gquad(int i, int j, const char *string,
   return energy;
 }
 
-PUBLIC float energy_of_gquad_structure(const char *string,
+PUBLIC float energy_of_gquad_structure(struct fold_context *ctx,
+                                       const char *string,
                                        const char *structure,
                                        int verbosity_level) {
 
-  return energy_of_gquad_struct_par(string, structure, NULL, verbosity_level);
+  return energy_of_gquad_struct_par(ctx, string, structure, NULL,
+                                    verbosity_level);
 }
 
-PUBLIC float energy_of_gquad_struct_par(const char *string,
+PUBLIC float energy_of_gquad_struct_par(struct fold_context *ctx,
+                                        const char *string,
                                         const char *structure,
                                         paramT *parameters,
                                         int verbosity_level) {
@@ -1681,16 +1706,16 @@ PUBLIC float energy_of_gquad_struct_par(const char *string,
   int energy, gge, *loop_idx;
   short *ss, *ss1;
 
-  update_fold_params_par(parameters);
+  update_fold_params_par(ctx, parameters);
 
   if (strlen(structure) != strlen(string))
     nrerror("energy_of_struct: string and structure have unequal length");
 
   /* save the S and S1 pointers in case they were already in use */
-  ss = S;
-  ss1 = S1;
-  S = encode_sequence(string, 0);
-  S1 = encode_sequence(string, 1);
+  ss = ctx->S;
+  ss1 = ctx->S1;
+  ctx->S = encode_sequence(string, 0);
+  ctx->S1 = encode_sequence(string, 1);
 
   /* the pair_table looses every information about the gquad position
      thus we have to find add the energy contributions for each loop
@@ -1698,74 +1723,80 @@ PUBLIC float energy_of_gquad_struct_par(const char *string,
      contributions, i.e. loops that actually contain a gquad, from
      energy_of_structure_pt()
   */
-  pair_table = make_pair_table(structure);
-  energy = energy_of_structure_pt(string, pair_table, S, S1, verbosity_level);
+  ctx->pair_table = make_pair_table(structure);
+  energy = energy_of_structure_pt(ctx, string, ctx->pair_table, ctx->S, ctx->S1,
+                                  verbosity_level);
 
-  loop_idx = make_loop_index_pt(pair_table);
-  gge = en_corr_of_loop_gquad(1, S[0], string, structure, pair_table, loop_idx,
-                              S1);
+  loop_idx = make_loop_index_pt(ctx->pair_table);
+  gge = en_corr_of_loop_gquad(ctx, 1, ctx->S[0], string, structure,
+                              ctx->pair_table, loop_idx, ctx->S1);
   energy += gge;
 
-  free(pair_table);
+  free(ctx->pair_table);
   free(loop_idx);
-  free(S);
-  free(S1);
-  S = ss;
-  S1 = ss1;
+  free(ctx->S);
+  free(ctx->S1);
+  ctx->S = ss;
+  ctx->S1 = ss1;
   return (float)energy / 100.;
 }
 
-PUBLIC int energy_of_structure_pt(const char *string, short *ptable, short *s,
-                                  short *s1, int verbosity_level) {
-  return energy_of_struct_pt_par(string, ptable, s, s1, NULL, verbosity_level);
+PUBLIC int energy_of_structure_pt(struct fold_context *ctx, const char *string,
+                                  short *ptable, short *s, short *s1,
+                                  int verbosity_level) {
+  return energy_of_struct_pt_par(ctx, string, ptable, s, s1, NULL,
+                                 verbosity_level);
 }
 
-PUBLIC int energy_of_struct_pt_par(const char *string, short *ptable, short *s,
-                                   short *s1, paramT *parameters,
-                                   int verbosity_level) {
+PUBLIC int energy_of_struct_pt_par(struct fold_context *ctx, const char *string,
+                                   short *ptable, short *s, short *s1,
+                                   paramT *parameters, int verbosity_level) {
   /* auxiliary function for kinfold,
      for most purposes call energy_of_struct instead */
 
   int i, length, energy;
   short *ss, *ss1;
 
-  update_fold_params_par(parameters);
+  update_fold_params_par(ctx, parameters);
 
-  pair_table = ptable;
-  ss = S;
-  ss1 = S1;
-  S = s;
-  S1 = s1;
+  ctx->pair_table = ptable;
+  ss = ctx->S;
+  ss1 = ctx->S1;
+  ctx->S = s;
+  ctx->S1 = s1;
 
-  length = S[0];
+  length = ctx->S[0];
   /*   energy =  backtrack_type=='M' ? ML_Energy(0, 0) : ML_Energy(0, 1); */
-  energy = backtrack_type == 'M' ? energy_of_ml_pt(0, ptable)
-                                 : energy_of_extLoop_pt(0, ptable);
+  energy = backtrack_type == 'M' ? energy_of_ml_pt(ctx, 0, ptable)
+                                 : energy_of_extLoop_pt(ctx, 0, ptable);
   if (verbosity_level > 0)
     printf("External loop                           : %5d\n", energy);
   for (i = 1; i <= length; i++) {
-    if (pair_table[i] == 0)
+    if (ctx->pair_table[i] == 0)
       continue;
-    energy += stack_energy(i, string, verbosity_level);
-    i = pair_table[i];
+    energy += stack_energy(ctx, i, string, verbosity_level);
+    i = ctx->pair_table[i];
   }
   for (i = 1; !SAME_STRAND(i, length); i++) {
-    if (!SAME_STRAND(i, pair_table[i])) {
-      energy += P->DuplexInit;
+    if (!SAME_STRAND(i, ctx->pair_table[i])) {
+      energy += ctx->P->DuplexInit;
       break;
     }
   }
-  S = ss;
-  S1 = ss1;
+  ctx->S = ss;
+  ctx->S1 = ss1;
   return energy;
 }
 
-PUBLIC float energy_of_circ_structure(const char *string, const char *structure,
+PUBLIC float energy_of_circ_structure(struct fold_context *ctx,
+                                      const char *string, const char *structure,
                                       int verbosity_level) {
-  return energy_of_circ_struct_par(string, structure, NULL, verbosity_level);
+  return energy_of_circ_struct_par(ctx, string, structure, NULL,
+                                   verbosity_level);
 }
 
-PUBLIC float energy_of_circ_struct_par(const char *string,
+PUBLIC float energy_of_circ_struct_par(struct fold_context *ctx,
+                                       const char *string,
                                        const char *structure,
                                        paramT *parameters,
                                        int verbosity_level) {
@@ -1773,81 +1804,83 @@ PUBLIC float energy_of_circ_struct_par(const char *string,
   int i, j, length, energy = 0, en0, degree = 0, type;
   short *ss, *ss1;
 
-  update_fold_params_par(parameters);
+  update_fold_params_par(ctx, parameters);
 
-  int dangle_model = P->model_details.dangles;
+  int dangle_model = ctx->P->model_details.dangles;
 
   if (strlen(structure) != strlen(string))
     nrerror("energy_of_struct: string and structure have unequal length");
 
   /* save the S and S1 pointers in case they were already in use */
-  ss = S;
-  ss1 = S1;
-  S = encode_sequence(string, 0);
-  S1 = encode_sequence(string, 1);
+  ss = ctx->S;
+  ss1 = ctx->S1;
+  ctx->S = encode_sequence(string, 0);
+  ctx->S1 = encode_sequence(string, 1);
 
-  pair_table = make_pair_table(structure);
+  ctx->pair_table = make_pair_table(structure);
 
-  length = S[0];
+  length = ctx->S[0];
 
   for (i = 1; i <= length; i++) {
-    if (pair_table[i] == 0)
+    if (ctx->pair_table[i] == 0)
       continue;
     degree++;
-    energy += stack_energy(i, string, verbosity_level);
-    i = pair_table[i];
+    energy += stack_energy(ctx, i, string, verbosity_level);
+    i = ctx->pair_table[i];
   }
 
   if (degree == 0)
     return 0.;
-  for (i = 1; pair_table[i] == 0; i++)
+  for (i = 1; ctx->pair_table[i] == 0; i++)
     ;
-  j = pair_table[i];
-  type = pair[S[j]][S[i]];
+  j = ctx->pair_table[i];
+  type = pair[ctx->S[j]][ctx->S[i]];
   if (type == 0)
     type = 7;
   if (degree == 1) {
     char loopseq[10];
     int u, si1, sj1;
-    for (i = 1; pair_table[i] == 0; i++)
+    for (i = 1; ctx->pair_table[i] == 0; i++)
       ;
     u = length - j + i - 1;
     if (u < 7) {
       strcpy(loopseq, string + j - 1);
       strncat(loopseq, string, i);
     }
-    si1 = (i == 1) ? S1[length] : S1[i - 1];
-    sj1 = (j == length) ? S1[1] : S1[j + 1];
-    en0 = E_Hairpin(u, type, sj1, si1, loopseq, P);
+    si1 = (i == 1) ? ctx->S1[length] : ctx->S1[i - 1];
+    sj1 = (j == length) ? ctx->S1[1] : ctx->S1[j + 1];
+    en0 = E_Hairpin(u, type, sj1, si1, loopseq, ctx->P);
   } else if (degree == 2) {
     int p, q, u1, u2, si1, sq1, type_2;
-    for (p = j + 1; pair_table[p] == 0; p++)
+    for (p = j + 1; ctx->pair_table[p] == 0; p++)
       ;
-    q = pair_table[p];
+    q = ctx->pair_table[p];
     u1 = p - j - 1;
     u2 = i - 1 + length - q;
-    type_2 = pair[S[q]][S[p]];
+    type_2 = pair[ctx->S[q]][ctx->S[p]];
     if (type_2 == 0)
       type_2 = 7;
-    si1 = (i == 1) ? S1[length] : S1[i - 1];
-    sq1 = (q == length) ? S1[1] : S1[q + 1];
-    en0 = E_IntLoop(u1, u2, type, type_2, S1[j + 1], si1, S1[p - 1], sq1, P);
+    si1 = (i == 1) ? ctx->S1[length] : ctx->S1[i - 1];
+    sq1 = (q == length) ? ctx->S1[1] : ctx->S1[q + 1];
+    en0 = E_IntLoop(u1, u2, type, type_2, ctx->S1[j + 1], si1, ctx->S1[p - 1],
+                    sq1, ctx->P);
   } else { /* degree > 2 */
-    en0 = ML_Energy(0, 0) - P->MLintern[0];
+    en0 = ML_Energy(ctx, 0, 0) - ctx->P->MLintern[0];
     if (dangle_model) {
       int d5, d3;
-      if (pair_table[1]) {
-        j = pair_table[1];
-        type = pair[S[1]][S[j]];
+      if (ctx->pair_table[1]) {
+        j = ctx->pair_table[1];
+        type = pair[ctx->S[1]][ctx->S[j]];
         if (dangle_model == 2)
-          en0 += P->dangle5[type][S1[length]];
+          en0 += ctx->P->dangle5[type][ctx->S1[length]];
         else { /* dangle_model==1 */
-          if (pair_table[length] == 0) {
-            d5 = P->dangle5[type][S1[length]];
-            if (pair_table[length - 1] != 0) {
+          if (ctx->pair_table[length] == 0) {
+            d5 = ctx->P->dangle5[type][ctx->S1[length]];
+            if (ctx->pair_table[length - 1] != 0) {
               int tt;
-              tt = pair[S[pair_table[length - 1]]][S[length - 1]];
-              d3 = P->dangle3[tt][S1[length]];
+              tt = pair[ctx->S[ctx->pair_table[length - 1]]]
+                       [ctx->S[length - 1]];
+              d3 = ctx->P->dangle3[tt][ctx->S1[length]];
               if (d3 < d5)
                 d5 = 0;
               else
@@ -1857,18 +1890,18 @@ PUBLIC float energy_of_circ_struct_par(const char *string,
           }
         }
       }
-      if (pair_table[length]) {
-        i = pair_table[length];
-        type = pair[S[i]][S[length]];
+      if (ctx->pair_table[length]) {
+        i = ctx->pair_table[length];
+        type = pair[ctx->S[i]][ctx->S[length]];
         if (dangle_model == 2)
-          en0 += P->dangle3[type][S1[1]];
+          en0 += ctx->P->dangle3[type][ctx->S1[1]];
         else { /* dangle_model==1 */
-          if (pair_table[1] == 0) {
-            d3 = P->dangle3[type][S1[1]];
-            if (pair_table[2]) {
+          if (ctx->pair_table[1] == 0) {
+            d3 = ctx->P->dangle3[type][ctx->S1[1]];
+            if (ctx->pair_table[2]) {
               int tt;
-              tt = pair[S[2]][S[pair_table[2]]];
-              d5 = P->dangle5[tt][1];
+              tt = pair[ctx->S[2]][ctx->S[ctx->pair_table[2]]];
+              d5 = ctx->P->dangle5[tt][1];
               if (d5 < d3)
                 d3 = 0;
               else
@@ -1885,16 +1918,21 @@ PUBLIC float energy_of_circ_struct_par(const char *string,
     printf("External loop                           : %5d\n", en0);
   energy += en0;
   /* fprintf(stderr, "ext loop degree %d tot %d\n", degree, energy); */
-  free(S);
-  free(S1);
-  S = ss;
-  S1 = ss1;
+  free(ctx->S);
+  free(ctx->S1);
+  ctx->S = ss;
+  ctx->S1 = ss1;
   return (float)energy / 100.0;
 }
 
 /*---------------------------------------------------------------------------*/
-PRIVATE int stack_energy(int i, const char *string, int verbosity_level) {
+PRIVATE int stack_energy(struct fold_context *ctx, int i, const char *string,
+                         int verbosity_level) {
   /* calculate energy of substructure enclosed by (i,j) */
+  short *S = ctx->S;
+  short *S1 = ctx->S1;
+  paramT *P = ctx->P;
+  short *pair_table = ctx->pair_table;
   int ee, energy = 0;
   int j, p, q, type;
 
@@ -1929,7 +1967,7 @@ PRIVATE int stack_energy(int i, const char *string, int verbosity_level) {
       ee = E_IntLoop(p - i - 1, j - q - 1, type, type_2, S1[i + 1], S1[j - 1],
                      S1[p - 1], S1[q + 1], P);
     else
-      ee = energy_of_extLoop_pt(cut_in_loop(i), pair_table);
+      ee = energy_of_extLoop_pt(ctx, cut_in_loop(ctx, i), pair_table);
     if (verbosity_level > 0)
       printf("Interior loop (%3d,%3d) %c%c; (%3d,%3d) %c%c: %5d\n", i, j,
              string[i - 1], string[j - 1], p, q, string[p - 1], string[q - 1],
@@ -1946,7 +1984,7 @@ PRIVATE int stack_energy(int i, const char *string, int verbosity_level) {
     if (SAME_STRAND(i, j))
       ee = E_Hairpin(j - i - 1, type, S1[i + 1], S1[j - 1], string + i - 1, P);
     else
-      ee = energy_of_extLoop_pt(cut_in_loop(i), pair_table);
+      ee = energy_of_extLoop_pt(ctx, cut_in_loop(ctx, i), pair_table);
     energy += ee;
     if (verbosity_level > 0)
       printf("Hairpin  loop (%3d,%3d) %c%c              : %5d\n", i, j,
@@ -1958,7 +1996,7 @@ PRIVATE int stack_energy(int i, const char *string, int verbosity_level) {
   /* (i,j) is exterior pair of multiloop */
   while (p < j) {
     /* add up the contributions of the substructures of the ML */
-    energy += stack_energy(p, string, verbosity_level);
+    energy += stack_energy(ctx, p, string, verbosity_level);
     p = pair_table[p];
     /* search for next base pair in multiloop */
     while (pair_table[++p] == 0)
@@ -1966,9 +2004,9 @@ PRIVATE int stack_energy(int i, const char *string, int verbosity_level) {
   }
   {
     int ii;
-    ii = cut_in_loop(i);
-    ee = (ii == 0) ? energy_of_ml_pt(i, pair_table)
-                   : energy_of_extLoop_pt(ii, pair_table);
+    ii = cut_in_loop(ctx, i);
+    ee = (ii == 0) ? energy_of_ml_pt(ctx, i, pair_table)
+                   : energy_of_extLoop_pt(ctx, ii, pair_table);
   }
   energy += ee;
   if (verbosity_level > 0)
@@ -1986,7 +2024,11 @@ PRIVATE int stack_energy(int i, const char *string, int verbosity_level) {
 *** for all stems branching off the exterior
 *** loop
 **/
-PRIVATE int energy_of_extLoop_pt(int i, short *pair_table) {
+PRIVATE int energy_of_extLoop_pt(struct fold_context *ctx, int i,
+                                 short *pair_table) {
+  short *S = ctx->S;
+  short *S1 = ctx->S1;
+  paramT *P = ctx->P;
   int energy, mm5, mm3;
   int p, q, q_prev;
   int length = (int)pair_table[0];
@@ -2080,7 +2122,11 @@ PRIVATE int energy_of_extLoop_pt(int i, short *pair_table) {
 *** We don't allow the last helix to stack with the first, thus we have to
 *** walk around the Loop twice with two starting points and take the minimum
 ***/
-PRIVATE int energy_of_ml_pt(int i, short *pt) {
+PRIVATE int energy_of_ml_pt(struct fold_context *ctx, int i, short *pt) {
+  short *S = ctx->S;
+  short *S1 = ctx->S1;
+  paramT *P = ctx->P;
+  short *pair_table = ctx->pair_table;
 
   int energy, cx_energy, tmp, tmp2, best_energy = INF;
   int i1, j, p, q, q_prev, q_prev2, u, x, type, count, mm5, mm3, tt, ld5,
@@ -2356,41 +2402,43 @@ PRIVATE int energy_of_ml_pt(int i, short *pt) {
 
 /*---------------------------------------------------------------------------*/
 
-PUBLIC int loop_energy(short *ptable, short *s, short *s1, int i) {
+PUBLIC int loop_energy(struct fold_context *ctx, short *ptable, short *s,
+                       short *s1, int i) {
   /* compute energy of a single loop closed by base pair (i,j) */
+  paramT *P = ctx->P;
   int j, type, p, q, energy;
   short *Sold, *S1old, *ptold;
 
-  ptold = pair_table;
-  Sold = S;
-  S1old = S1;
-  pair_table = ptable;
-  S = s;
-  S1 = s1;
+  ptold = ctx->pair_table;
+  Sold = ctx->S;
+  S1old = ctx->S1;
+  ctx->pair_table = ptable;
+  ctx->S = s;
+  ctx->S1 = s1;
 
   if (i == 0) { /* evaluate exterior loop */
-    energy = energy_of_extLoop_pt(0, pair_table);
-    pair_table = ptold;
-    S = Sold;
-    S1 = S1old;
+    energy = energy_of_extLoop_pt(ctx, 0, ctx->pair_table);
+    ctx->pair_table = ptold;
+    ctx->S = Sold;
+    ctx->S1 = S1old;
     return energy;
   }
-  j = pair_table[i];
+  j = ctx->pair_table[i];
   if (j < i)
     nrerror("i is unpaired in loop_energy()");
-  type = pair[S[i]][S[j]];
+  type = pair[ctx->S[i]][ctx->S[j]];
   if (type == 0) {
     type = 7;
     if (eos_debug >= 0)
       fprintf(stderr, "WARNING: bases %d and %d (%c%c) can't pair!\n", i, j,
-              Law_and_Order[S[i]], Law_and_Order[S[j]]);
+              Law_and_Order[ctx->S[i]], Law_and_Order[ctx->S[j]]);
   }
   p = i;
   q = j;
 
-  while (pair_table[++p] == 0)
+  while (ctx->pair_table[++p] == 0)
     ;
-  while (pair_table[--q] == 0)
+  while (ctx->pair_table[--q] == 0)
     ;
   if (p > q) { /* Hairpin */
     char loopseq[8] = "";
@@ -2398,84 +2446,87 @@ PUBLIC int loop_energy(short *ptable, short *s, short *s1, int i) {
       if (j - i - 1 < 7) {
         int u;
         for (u = 0; i + u <= j; u++)
-          loopseq[u] = Law_and_Order[S[i + u]];
+          loopseq[u] = Law_and_Order[ctx->S[i + u]];
         loopseq[u] = '\0';
       }
-      energy = E_Hairpin(j - i - 1, type, S1[i + 1], S1[j - 1], loopseq, P);
+      energy = E_Hairpin(j - i - 1, type, ctx->S1[i + 1], ctx->S1[j - 1],
+                         loopseq, P);
     } else {
-      energy = energy_of_extLoop_pt(cut_in_loop(i), pair_table);
+      energy = energy_of_extLoop_pt(ctx, cut_in_loop(ctx, i), ctx->pair_table);
     }
-  } else if (pair_table[q] != (short)p) { /* multi-loop */
+  } else if (ctx->pair_table[q] != (short)p) { /* multi-loop */
     int ii;
-    ii = cut_in_loop(i);
-    energy = (ii == 0) ? energy_of_ml_pt(i, pair_table)
-                       : energy_of_extLoop_pt(ii, pair_table);
+    ii = cut_in_loop(ctx, i);
+    energy = (ii == 0) ? energy_of_ml_pt(ctx, i, ctx->pair_table)
+                       : energy_of_extLoop_pt(ctx, ii, ctx->pair_table);
   } else { /* found interior loop */
     int type_2;
-    type_2 = pair[S[q]][S[p]];
+    type_2 = pair[ctx->S[q]][ctx->S[p]];
     if (type_2 == 0) {
       type_2 = 7;
       if (eos_debug >= 0)
         fprintf(stderr, "WARNING: bases %d and %d (%c%c) can't pair!\n", p, q,
-                Law_and_Order[S[p]], Law_and_Order[S[q]]);
+                Law_and_Order[ctx->S[p]], Law_and_Order[ctx->S[q]]);
     }
     /* energy += LoopEnergy(i, j, p, q, type, type_2); */
     if (SAME_STRAND(i, p) && SAME_STRAND(q, j))
-      energy = E_IntLoop(p - i - 1, j - q - 1, type, type_2, S1[i + 1],
-                         S1[j - 1], S1[p - 1], S1[q + 1], P);
+      energy = E_IntLoop(p - i - 1, j - q - 1, type, type_2, ctx->S1[i + 1],
+                         ctx->S1[j - 1], ctx->S1[p - 1], ctx->S1[q + 1], P);
     else
-      energy = energy_of_extLoop_pt(cut_in_loop(i), pair_table);
+      energy = energy_of_extLoop_pt(ctx, cut_in_loop(ctx, i), ctx->pair_table);
   }
 
-  pair_table = ptold;
-  S = Sold;
-  S1 = S1old;
+  ctx->pair_table = ptold;
+  ctx->S = Sold;
+  ctx->S1 = S1old;
   return energy;
 }
 
 /*---------------------------------------------------------------------------*/
 
-PUBLIC float energy_of_move(const char *string, const char *structure, int m1,
-                            int m2) {
+PUBLIC float energy_of_move(struct fold_context *ctx, const char *string,
+                            const char *structure, int m1, int m2) {
   int energy;
   short *ss, *ss1;
 
 #ifdef _OPENMP
-  if (P == NULL)
-    update_fold_params();
+  if (ctx->P == NULL)
+    update_fold_params(ctx);
 #else
-  if ((init_length < 0) || (P == NULL))
-    update_fold_params();
+  if ((ctx->init_length < 0) || (ctx->P == NULL))
+    update_fold_params(ctx);
 #endif
 
-  if (fabs(P->temperature - temperature) > 1e-6)
-    update_fold_params();
+  if (fabs(ctx->P->temperature - temperature) > 1e-6)
+    update_fold_params(ctx);
 
   if (strlen(structure) != strlen(string))
     nrerror("energy_of_struct: string and structure have unequal length");
 
   /* save the S and S1 pointers in case they were already in use */
-  ss = S;
-  ss1 = S1;
-  S = encode_sequence(string, 0);
-  S1 = encode_sequence(string, 1);
+  ss = ctx->S;
+  ss1 = ctx->S1;
+  ctx->S = encode_sequence(string, 0);
+  ctx->S1 = encode_sequence(string, 1);
 
-  pair_table = make_pair_table(structure);
+  ctx->pair_table = make_pair_table(structure);
 
-  energy = energy_of_move_pt(pair_table, S, S1, m1, m2);
+  energy = energy_of_move_pt(ctx, ctx->pair_table, ctx->S, ctx->S1, m1, m2);
 
-  free(pair_table);
-  free(S);
-  free(S1);
-  S = ss;
-  S1 = ss1;
+  free(ctx->pair_table);
+  free(ctx->S);
+  free(ctx->S1);
+  ctx->S = ss;
+  ctx->S1 = ss1;
   return (float)energy / 100.;
 }
 
 /*---------------------------------------------------------------------------*/
 
-PUBLIC int energy_of_move_pt(short *pt, short *s, short *s1, int m1, int m2) {
+PUBLIC int energy_of_move_pt(struct fold_context *ctx, short *pt, short *s,
+                             short *s1, int m1, int m2) {
   /*compute change in energy given by move (m1,m2)*/
+  paramT *P = ctx->P;
   int en_post, en_pre, i, j, k, l, len;
 
   len = pt[0];
@@ -2495,18 +2546,18 @@ PUBLIC int energy_of_move_pt(short *pt, short *s, short *s1, int m1, int m2) {
     }
   }
   i = (j <= len) ? pt[j] : 0;
-  en_pre = loop_energy(pt, s, s1, i);
+  en_pre = loop_energy(ctx, pt, s, s1, i);
   en_post = 0;
   if (m1 < 0) { /*it's a delete move */
-    en_pre += loop_energy(pt, s, s1, k);
+    en_pre += loop_energy(ctx, pt, s, s1, k);
     pt[k] = 0;
     pt[l] = 0;
   } else { /* insert move */
     pt[k] = l;
     pt[l] = k;
-    en_post += loop_energy(pt, s, s1, k);
+    en_post += loop_energy(ctx, pt, s, s1, k);
   }
-  en_post += loop_energy(pt, s, s1, i);
+  en_post += loop_energy(ctx, pt, s, s1, i);
   /*  restore pair table */
   if (m1 < 0) {
     pt[k] = l;
@@ -2538,9 +2589,10 @@ PUBLIC int energy_of_move_pt(short *pt, short *s, short *s1, int m1, int m2) {
   return (en_post - en_pre);
 }
 
-PRIVATE int cut_in_loop(int i) {
+PRIVATE int cut_in_loop(struct fold_context *ctx, int i) {
   /* walk around the loop;  return j pos of pair after cut if
      cut_point in loop else 0 */
+  short *pair_table = ctx->pair_table;
   int p, j;
   p = j = pair_table[i];
   do {
@@ -2554,7 +2606,12 @@ PRIVATE int cut_in_loop(int i) {
 
 /*---------------------------------------------------------------------------*/
 
-PRIVATE void make_ptypes(const short *S, const char *structure, paramT *P) {
+PRIVATE void make_ptypes(struct fold_context *ctx, const short *S,
+                         const char *structure, paramT *P) {
+  int *indx = ctx->indx;
+  char *ptype = ctx->ptype;
+  int *BP = ctx->BP;
+  int struct_constrained = ctx->struct_constrained;
   int n, i, j, k, l;
 
   n = S[0];
@@ -2636,7 +2693,9 @@ PUBLIC void assign_plist_from_db(plist **pl, const char *struc, float pr) {
 /*# deprecated functions below              #*/
 /*###########################################*/
 
-PUBLIC int HairpinE(int size, int type, int si1, int sj1, const char *string) {
+PUBLIC int HairpinE(struct fold_context *ctx, int size, int type, int si1,
+                    int sj1, const char *string) {
+  paramT *P = ctx->P;
   int energy;
 
   energy = (size <= 30) ? P->hairpin[size]
@@ -2675,8 +2734,11 @@ PUBLIC int HairpinE(int size, int type, int si1, int sj1, const char *string) {
 
 /*---------------------------------------------------------------------------*/
 
-PUBLIC int oldLoopEnergy(int i, int j, int p, int q, int type, int type_2) {
+PUBLIC int oldLoopEnergy(struct fold_context *ctx, int i, int j, int p, int q,
+                         int type, int type_2) {
   /* compute energy of degree 2 loop (stack bulge or interior) */
+  short *S1 = ctx->S1;
+  paramT *P = ctx->P;
   int n1, n2, m, energy;
   n1 = p - i - 1;
   n2 = j - q - 1;
@@ -2724,9 +2786,10 @@ PUBLIC int oldLoopEnergy(int i, int j, int p, int q, int type, int type_2) {
 
 /*--------------------------------------------------------------------------*/
 
-PUBLIC int LoopEnergy(int n1, int n2, int type, int type_2, int si1, int sj1,
-                      int sp1, int sq1) {
+PUBLIC int LoopEnergy(struct fold_context *ctx, int n1, int n2, int type,
+                      int type_2, int si1, int sj1, int sp1, int sq1) {
   /* compute energy of degree 2 loop (stack bulge or interior) */
+  paramT *P = ctx->P;
   int nl, ns, energy;
 
   if (n1 > n2) {
@@ -2796,7 +2859,7 @@ PUBLIC int LoopEnergy(int n1, int n2, int type, int type_2, int si1, int sj1,
   return energy;
 }
 
-PRIVATE int ML_Energy(int i, int is_extloop) {
+PRIVATE int ML_Energy(struct fold_context *ctx, int i, int is_extloop) {
   /* i is the 5'-base of the closing pair (or 0 for exterior loop)
      loop is scored as ML if extloop==0 else as exterior loop
 
@@ -2808,6 +2871,10 @@ PRIVATE int ML_Energy(int i, int is_extloop) {
      We don't allow the last helix to stack with the first, thus we have to
      walk around the Loop twice with two starting points and take the minimum
   */
+  short *S = ctx->S;
+  short *S1 = ctx->S1;
+  paramT *P = ctx->P;
+  short *pair_table = ctx->pair_table;
 
   int energy, cx_energy, best_energy = INF;
   int i1, j, p, q, u, x, type, count;
@@ -3039,15 +3106,17 @@ PRIVATE int ML_Energy(int i, int is_extloop) {
 PUBLIC void initialize_fold(int length) { /* DO NOTHING */
 }
 
-PUBLIC float energy_of_struct(const char *string, const char *structure) {
-  return energy_of_structure(string, structure, eos_debug);
+PUBLIC float energy_of_struct(struct fold_context *ctx, const char *string,
+                              const char *structure) {
+  return energy_of_structure(ctx, string, structure, eos_debug);
 }
 
-PUBLIC int energy_of_struct_pt(const char *string, short *ptable, short *s,
-                               short *s1) {
-  return energy_of_structure_pt(string, ptable, s, s1, eos_debug);
+PUBLIC int energy_of_struct_pt(struct fold_context *ctx, const char *string,
+                               short *ptable, short *s, short *s1) {
+  return energy_of_structure_pt(ctx, string, ptable, s, s1, eos_debug);
 }
 
-PUBLIC float energy_of_circ_struct(const char *string, const char *structure) {
-  return energy_of_circ_structure(string, structure, eos_debug);
+PUBLIC float energy_of_circ_struct(struct fold_context *ctx, const char *string,
+                                   const char *structure) {
+  return energy_of_circ_structure(ctx, string, structure, eos_debug);
 }
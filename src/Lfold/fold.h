@@ -2,6 +2,7 @@
 #define __VIENNA_RNA_PACKAGE_FOLD_H__
 
 #include "data_structures.h"
+#include "fold_context.h"
 
 #ifdef __GNUC__
 #define DEPRECATED(func) func __attribute__ ((deprecated))
@@ -106,6 +107,7 @@ extern  int eos_debug;
  *
  *  \see fold(), circfold(), #model_detailsT, set_energy_model(), get_scaled_parameters()
  *
+ *  \param ctx            The working memory of the folding, see create_fold_context()
  *  \param sequence       RNA sequence
  *  \param structure      A pointer to the character array where the
  *                        secondary structure in dot-bracket notation will be written to
@@ -116,7 +118,8 @@ extern  int eos_debug;
  *
  *  \return the minimum free energy (MFE) in kcal/mol
  */
-float fold_par( const char *sequence,
+float fold_par( struct fold_context *ctx,
+                const char *sequence,
                 char *structure,
                 paramT *parameters,
                 int is_constrained,
@@ -140,7 +143,8 @@ float fold_par( const char *sequence,
  *         secondary structure in dot-bracket notation will be written to
  *  \return the minimum free energy (MFE) in kcal/mol
  */
-float fold( const char *sequence,
+float fold( struct fold_context *ctx,
+            const char *sequence,
             char *structure);
 
 /**
@@ -161,7 +165,8 @@ float fold( const char *sequence,
  *         secondary structure in dot-bracket notation will be written to
  *  \return the minimum free energy (MFE) in kcal/mol
  */
-float circfold( const char *sequence,
+float circfold( struct fold_context *ctx,
+                const char *sequence,
                 char *structure);
 
 
@@ -192,7 +197,8 @@ float circfold( const char *sequence,
  *  \param verbosity_level a flag to turn verbose output on/off
  *  \return          the free energy of the input structure given the input sequence in kcal/mol
  */
-float energy_of_structure(const char *string,
+float energy_of_structure(struct fold_context *ctx,
+                          const char *string,
                           const char *structure,
                           int verbosity_level);
 
@@ -211,7 +217,8 @@ float energy_of_structure(const char *string,
  *  \param verbosity_level  A flag to turn verbose output on/off
  *  \return                The free energy of the input structure given the input sequence in kcal/mol
  */
-float energy_of_struct_par( const char *string,
+float energy_of_struct_par( struct fold_context *ctx,
+                            const char *string,
                             const char *structure,
                             paramT *parameters,
                             int verbosity_level);
@@ -234,7 +241,8 @@ float energy_of_struct_par( const char *string,
  *  \param verbosity_level  A flag to turn verbose output on/off
  *  \return                The free energy of the input structure given the input sequence in kcal/mol
  */
-float energy_of_circ_structure( const char *string,
+float energy_of_circ_structure( struct fold_context *ctx,
+                                const char *string,
                                 const char *structure,
                                 int verbosity_level);
 
@@ -253,17 +261,20 @@ float energy_of_circ_structure( const char *string,
  *  \param verbosity_level  A flag to turn verbose output on/off
  *  \return                The free energy of the input structure given the input sequence in kcal/mol
  */
-float energy_of_circ_struct_par(const char *string,
+float energy_of_circ_struct_par(struct fold_context *ctx,
+                                const char *string,
                                 const char *structure,
                                 paramT *parameters,
                                 int verbosity_level);
 
 
-float energy_of_gquad_structure(const char *string,
+float energy_of_gquad_structure(struct fold_context *ctx,
+                                const char *string,
                                 const char *structure,
                                 int verbosity_level);
 
-float energy_of_gquad_struct_par( const char *string,
+float energy_of_gquad_struct_par( struct fold_context *ctx,
+                                  const char *string,
                                   const char *structure,
                                   paramT *parameters,
                                   int verbosity_level);
@@ -288,7 +299,8 @@ float energy_of_gquad_struct_par( const char *string,
  *  \param verbosity_level a flag to turn verbose output on/off
  *  \return          the free energy of the input structure given the input sequence in 10kcal/mol
  */
-int energy_of_structure_pt( const char *string,
+int energy_of_structure_pt( struct fold_context *ctx,
+                            const char *string,
                             short *ptable,
                             short *s,
                             short *s1,
@@ -311,7 +323,8 @@ int energy_of_structure_pt( const char *string,
  *  \param verbosity_level  A flag to turn verbose output on/off
  *  \return                The free energy of the input structure given the input sequence in 10kcal/mol
  */
-int energy_of_struct_pt_par(const char *string,
+int energy_of_struct_pt_par(struct fold_context *ctx,
+                            const char *string,
                             short *ptable,
                             short *s,
                             short *s1,
@@ -324,7 +337,7 @@ int energy_of_struct_pt_par(const char *string,
  *  \ingroup mfe_fold
  *
  */
-void  free_arrays(void);
+void  free_arrays(struct fold_context *ctx);
 
 
 /**
@@ -356,21 +369,23 @@ void letter_structure(char *structure,
  *
  *  \ingroup mfe_fold
  */
-void  update_fold_params(void);
+void  update_fold_params(struct fold_context *ctx);
 
 /**
  *
  *  \ingroup mfe_fold
  * 
  */
-void update_fold_params_par(paramT *parameters);
+void update_fold_params_par(struct fold_context *ctx,
+                            paramT *parameters);
 
 /**
  *
  *  \ingroup mfe_fold
  * 
  */
-char  *backtrack_fold_from_pair(char *sequence,
+char  *backtrack_fold_from_pair(struct fold_context *ctx,
+                                char *sequence,
                                 int i,
                                 int j);
 
@@ -387,7 +402,8 @@ char  *backtrack_fold_from_pair(char *sequence,
  *  \param m2         second coordinate of base pair
  *  \returns          energy change of the move in kcal/mol
  */
-float energy_of_move( const char *string,
+float energy_of_move( struct fold_context *ctx,
+                      const char *string,
                       const char *structure,
                       int m1,
                       int m2);
@@ -408,7 +424,8 @@ float energy_of_move( const char *string,
  *  \param m2         second coordinate of base pair
  *  \returns          energy change of the move in 10cal/mol
  */
-int energy_of_move_pt(short *pt,
+int energy_of_move_pt(struct fold_context *ctx,
+                      short *pt,
                    short *s,
                    short *s1,
                    int m1,
@@ -423,7 +440,8 @@ int energy_of_move_pt(short *pt,
  *  \param i          position of covering base pair
  *  \returns          free energy of the loop in 10cal/mol
  */
-int   loop_energy(short *ptable,
+int   loop_energy(struct fold_context *ctx,
+                  short *ptable,
                   short *s,
                   short *s1,
                   int i);
@@ -433,7 +451,8 @@ int   loop_energy(short *ptable,
  *  \ingroup mfe_fold
  * 
  */
-void export_fold_arrays(int **f5_p,
+void export_fold_arrays(struct fold_context *ctx,
+                        int **f5_p,
                         int **c_p,
                         int **fML_p,
                         int **fM1_p,
@@ -445,7 +464,8 @@ void export_fold_arrays(int **f5_p,
  *  \ingroup mfe_fold
  * 
  */
-void export_fold_arrays_par(int **f5_p,
+void export_fold_arrays_par(struct fold_context *ctx,
+                            int **f5_p,
                             int **c_p,
                             int **fML_p,
                             int **fM1_p,
@@ -458,7 +478,8 @@ void export_fold_arrays_par(int **f5_p,
  *  \ingroup mfe_fold
  * 
  */
-void export_circfold_arrays(int *Fc_p,
+void export_circfold_arrays(struct fold_context *ctx,
+                            int *Fc_p,
                             int *FcH_p,
                             int *FcI_p,
                             int *FcM_p,
@@ -475,7 +496,8 @@ void export_circfold_arrays(int *Fc_p,
  *  \ingroup mfe_fold
  * 
  */
-void export_circfold_arrays_par(int *Fc_p,
+void export_circfold_arrays_par(struct fold_context *ctx,
+                                int *Fc_p,
                                 int *FcH_p,
                                 int *FcI_p,
                                 int *FcM_p,
@@ -520,7 +542,8 @@ void assign_plist_from_db(plist **pl,
  *  \deprecated {This function is deprecated and will be removed soon.
  *  Use \ref E_IntLoop() instead!}
  */
-DEPRECATED(int LoopEnergy(int n1,
+DEPRECATED(int LoopEnergy(struct fold_context *ctx,
+                          int n1,
                           int n2,
                           int type,
                           int type_2,
@@ -533,7 +556,8 @@ DEPRECATED(int LoopEnergy(int n1,
  *  \deprecated {This function is deprecated and will be removed soon.
  *  Use \ref E_Hairpin() instead!}
  */
-DEPRECATED(int HairpinE(int size,
+DEPRECATED(int HairpinE(struct fold_context *ctx,
+                        int size,
                         int type,
                         int si1,
                         int sj1,
@@ -560,7 +584,8 @@ DEPRECATED(void initialize_fold(int length));
  *  \param structure  secondary structure in dot-bracket notation
  *  \return          the free energy of the input structure given the input sequence in kcal/mol
  */
-DEPRECATED(float energy_of_struct(const char *string,
+DEPRECATED(float energy_of_struct(struct fold_context *ctx,
+                                  const char *string,
                                   const char *structure));
 
 /**
@@ -579,7 +604,8 @@ DEPRECATED(float energy_of_struct(const char *string,
  *  \param s1         encoded RNA sequence
  *  \return          the free energy of the input structure given the input sequence in 10kcal/mol
  */
-DEPRECATED(int energy_of_struct_pt( const char *string,
+DEPRECATED(int energy_of_struct_pt( struct fold_context *ctx,
+                                    const char *string,
                                     short *ptable,
                                     short *s,
                                     short *s1));
@@ -598,7 +624,8 @@ DEPRECATED(int energy_of_struct_pt( const char *string,
  *  \param structure  secondary structure in dot-bracket notation
  *  \return          the free energy of the input structure given the input sequence in kcal/mol
  */
-DEPRECATED(float energy_of_circ_struct( const char *string,
+DEPRECATED(float energy_of_circ_struct( struct fold_context *ctx,
+                                        const char *string,
                                         const char *structure));
 
 #endif
@@ -0,0 +1,583 @@
+/** \file **/
+
+/*
+                  minimum free energy of several sequences
+                  of the same length at once
+
+                  The recursions of fill_arrays() in fold.c,
+                  every array entry holds one energy per sequence
+*/
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <ctype.h>
+#include <string.h>
+#include <limits.h>
+
+#include "utils.h"
+#include "energy_par.h"
+#include "fold_vars.h"
+#include "pair_mat.h"
+#include "params.h"
+#include "loop_energies.h"
+#include "data_structures.h"
+#include "fold.h"
+#include "Lfold.h"
+#include "fold_batch.h"
+
+#define LANES FOLD_BATCH_LANES
+
+/* the number of ints an index of a parameter table steps over */
+#define STRIDE(entry) ((int)(sizeof(entry) / sizeof(int)))
+
+/* the loops over the lanes are the ones to be vectorized */
+#ifdef _OPENMP
+#define FOR_LANES(l) _Pragma("omp simd") for (l = 0; l < LANES; l++)
+#else
+#define FOR_LANES(l) for (l = 0; l < LANES; l++)
+#endif
+
+/*
+#################################
+# PRIVATE FUNCTION DECLARATIONS #
+#################################
+*/
+PRIVATE void get_batch_arrays(struct batch_arrays *b, int length, int width);
+PRIVATE void make_batch_ptypes(struct batch_arrays *b, const short *S,
+                               int maxdist, int lane);
+PRIVATE void fill_batch_arrays(struct fold_context *ctx, const char **strings,
+                               int length);
+PRIVATE void fold_one_by_one(struct fold_context *ctx, const char **sequences,
+                             int count, int maxdist, float *energies);
+
+/*
+#################################
+# BEGIN OF FUNCTION DEFINITIONS #
+#################################
+*/
+
+PUBLIC void fold_batch(struct fold_context *ctx, const char **sequences,
+                       int count, int maxdist, float *energies) {
+  struct batch_arrays *b = &ctx->batch;
+  const char *strings[LANES];
+  int i, l, length;
+
+  if (count <= 0)
+    return;
+  if (ctx->P == NULL || fabs(ctx->P->temperature - temperature) > 1e-6)
+    update_fold_params(ctx);
+
+  length = (int)strlen(sequences[0]);
+  if (maxdist <= 0 || maxdist > length)
+    maxdist = length;
+  if (count > LANES || length < TURN + 2 || fold_constrained ||
+      backtrack_type != 'F' || ctx->P->model_details.gquad ||
+      (ctx->P->model_details.dangles != 0 &&
+       ctx->P->model_details.dangles != 2)) {
+    fold_one_by_one(ctx, sequences, count, maxdist, energies);
+    return;
+  }
+  for (l = 1; l < count; l++) {
+    if ((int)strlen(sequences[l]) != length) {
+      fold_one_by_one(ctx, sequences, count, maxdist, energies);
+      return;
+    }
+  }
+
+  make_pair_matrix();
+  /* the band has to hold the short spans the recursions initialize */
+  get_batch_arrays(b, length, MAX2(maxdist, TURN + 2));
+
+  /* unused lanes fold the first sequence again */
+  for (l = 0; l < LANES; l++) {
+    short *S, *S1;
+    strings[l] = sequences[(l < count) ? l : 0];
+    S = encode_sequence(strings[l], 0);
+    S1 = encode_sequence(strings[l], 1);
+    make_batch_ptypes(b, S, maxdist, l);
+    for (i = 0; i <= length + 1; i++)
+      b->S1[i * LANES + l] = S1[i];
+    free(S);
+    free(S1);
+  }
+
+  fill_batch_arrays(ctx, strings, length);
+
+  for (l = 0; l < count; l++)
+    energies[l] = (float)b->f5[length * LANES + l] / 100.;
+}
+
+PUBLIC void free_batch_arrays(struct fold_context *ctx) {
+  struct batch_arrays *b = &ctx->batch;
+  free(b->indx);
+  free(b->c);
+  free(b->fML);
+  free(b->cI);
+  free(b->c1n);
+  free(b->cB);
+  free(b->ptype);
+  free(b->rptype);
+  free(b->S1);
+  free(b->f5);
+  free(b->cc);
+  free(b->cc1);
+  free(b->Fmi);
+  free(b->DMLi);
+  free(b->DMLi1);
+  free(b->DMLi2);
+  memset(b, 0, sizeof(struct batch_arrays));
+}
+
+/*--------------------------------------------------------------------------*/
+
+/* The entries (i,j), j - width < i <= j, of column j lie next to each other
+ * with i descending, (i,j) is at indx[j] - i. With a width of at least the
+ * length the columns are the ones of the triangle matrices of fold(),
+ * otherwise only the band along the diagonal is stored. */
+PRIVATE void get_batch_arrays(struct batch_arrays *b, int length, int width) {
+  size_t size = 1;
+  int j;
+
+  if ((unsigned int)length > b->length) {
+    free(b->indx);
+    free(b->S1);
+    free(b->f5);
+    free(b->cc);
+    free(b->cc1);
+    free(b->Fmi);
+    free(b->DMLi);
+    free(b->DMLi1);
+    free(b->DMLi2);
+    b->indx = (int *)space(sizeof(int) * (length + 1));
+    b->S1 = (int *)space(sizeof(int) * (length + 2) * LANES);
+    b->f5 = (int *)space(sizeof(int) * (length + 2) * LANES);
+    b->cc = (int *)space(sizeof(int) * (length + 2) * LANES);
+    b->cc1 = (int *)space(sizeof(int) * (length + 2) * LANES);
+    b->Fmi = (int *)space(sizeof(int) * (length + 1) * LANES);
+    b->DMLi = (int *)space(sizeof(int) * (length + 1) * LANES);
+    b->DMLi1 = (int *)space(sizeof(int) * (length + 1) * LANES);
+    b->DMLi2 = (int *)space(sizeof(int) * (length + 1) * LANES);
+    b->length = (unsigned int)length;
+  }
+
+  for (j = 1; j <= length; j++) {
+    b->indx[j] = (int)size + j;
+    size += (size_t)MIN2(j, width);
+  }
+  if (size > (size_t)INT_MAX / LANES)
+    nrerror("get_batch_arrays@fold_batch.c: sequence length exceeds "
+            "addressable range");
+  b->width = width;
+
+  if (size > b->size) {
+    free(b->c);
+    free(b->fML);
+    free(b->cI);
+    free(b->c1n);
+    free(b->cB);
+    free(b->ptype);
+    free(b->rptype);
+    b->c = (int *)space(sizeof(int) * size * LANES);
+    b->fML = (int *)space(sizeof(int) * size * LANES);
+    b->cI = (int *)space(sizeof(int) * size * LANES);
+    b->c1n = (int *)space(sizeof(int) * size * LANES);
+    b->cB = (int *)space(sizeof(int) * size * LANES);
+    b->ptype = (char *)space(sizeof(char) * size * LANES);
+    b->rptype = (char *)space(sizeof(char) * size * LANES);
+    b->size = size;
+  }
+}
+
+/* make_ptypes() of fold.c for a single lane, only pairs (i,j) with
+ * j - i < maxdist are allowed */
+PRIVATE void make_batch_ptypes(struct batch_arrays *b, const short *S,
+                               int maxdist, int lane) {
+  int *indx = b->indx;
+  char *ptype = b->ptype;
+  char *rptype = b->rptype;
+  int n, i, j, k, l;
+
+  n = S[0];
+  for (k = 1; k < n - TURN; k++)
+    for (l = 1; l <= 2; l++) {
+      int type, ntype = 0, otype = 0;
+      i = k;
+      j = i + TURN + l;
+      if (j > n)
+        continue;
+      type = pair[S[i]][S[j]];
+      while ((i >= 1) && (j <= n) && (j - i < b->width)) {
+        if ((i > 1) && (j < n))
+          ntype = pair[S[i - 1]][S[j + 1]];
+        if (noLonelyPairs && (!otype) && (!ntype))
+          type = 0; /* i.j can only form isolated pairs */
+        if (j - i >= maxdist)
+          type = 0;
+        ptype[(indx[j] - i) * LANES + lane] = (char)type;
+        rptype[(indx[j] - i) * LANES + lane] = (char)rtype[type];
+        otype = type;
+        type = ntype;
+        i--;
+        j++;
+      }
+    }
+}
+
+/**
+*** fill the "c", "fML" and "f5" arrays of all lanes, dangles 0 and 2 only
+**/
+VECTOR_KERNEL PRIVATE void fill_batch_arrays(struct fold_context *ctx,
+                                             const char **strings,
+                                             int length) {
+  struct batch_arrays *b = &ctx->batch;
+  int *indx = b->indx;
+  int width = b->width;
+  int *c = b->c;
+  int *fML = b->fML;
+  char *ptype = b->ptype;
+  int *S1 = b->S1;
+  int *f5 = b->f5;
+  int *cc = b->cc;
+  int *cc1 = b->cc1;
+  int *Fmi = b->Fmi;
+  int *DMLi = b->DMLi;
+  int *DMLi1 = b->DMLi1;
+  int *DMLi2 = b->DMLi2;
+  char *rptype = b->rptype;
+  int *cI = b->cI;
+  int *c1n = b->c1n;
+  int *cB = b->cB;
+  paramT *P = ctx->P;
+  /* the energy tables as flat arrays, indexed by int offsets in the lanes.
+   * The strides of their dimensions follow from the types of the tables, so
+   * they change with NBPAIRS and the number of bases. */
+  const int *stack = &P->stack[0][0];
+  const int *int11 = &P->int11[0][0][0][0];
+  const int *int21 = &P->int21[0][0][0][0][0];
+  const int *int22 = &P->int22[0][0][0][0][0][0];
+  const int *mismatch1nI = &P->mismatch1nI[0][0][0];
+  const int *mismatch23I = &P->mismatch23I[0][0][0];
+  const int *mismatchI = &P->mismatchI[0][0][0];
+  const int st0 = STRIDE(P->stack[0]);
+  const int s11_0 = STRIDE(P->int11[0]);
+  const int s11_1 = STRIDE(P->int11[0][0]);
+  const int s11_2 = STRIDE(P->int11[0][0][0]);
+  const int s21_0 = STRIDE(P->int21[0]);
+  const int s21_1 = STRIDE(P->int21[0][0]);
+  const int s21_2 = STRIDE(P->int21[0][0][0]);
+  const int s21_3 = STRIDE(P->int21[0][0][0][0]);
+  const int s22_0 = STRIDE(P->int22[0]);
+  const int s22_1 = STRIDE(P->int22[0][0]);
+  const int s22_2 = STRIDE(P->int22[0][0][0]);
+  const int s22_3 = STRIDE(P->int22[0][0][0][0]);
+  const int s22_4 = STRIDE(P->int22[0][0][0][0][0]);
+  /* the three mismatch tables have the same shape */
+  const int smm_0 = STRIDE(P->mismatchI[0]);
+  const int smm_1 = STRIDE(P->mismatchI[0][0]);
+
+  int i, j, k, l, p, q;
+  int dangle_model, noGUclosure;
+  int rt[NBPAIRS + 1];
+
+  dangle_model = P->model_details.dangles;
+  noGUclosure = P->model_details.noGUclosure;
+  for (k = 0; k <= NBPAIRS; k++)
+    rt[k] = rtype[k];
+
+  for (j = 0; j <= length + 1; j++)
+    FOR_LANES(l) { cc[j * LANES + l] = cc1[j * LANES + l] = INF; }
+  for (j = 1; j <= length; j++)
+    FOR_LANES(l) {
+      Fmi[j * LANES + l] = DMLi[j * LANES + l] = DMLi1[j * LANES + l] =
+          DMLi2[j * LANES + l] = INF;
+    }
+  for (j = 1; j <= length; j++)
+    for (i = (j > TURN ? (j - TURN) : 1); i < j; i++)
+      FOR_LANES(l) {
+        c[(indx[j] - i) * LANES + l] = fML[(indx[j] - i) * LANES + l] = INF;
+      }
+
+  for (i = length - TURN - 1; i >= 1; i--) { /* i,j in [1..length] */
+
+    for (j = i + TURN + 1; j <= length && j - i < width; j++) {
+      int ij = indx[j] - i;
+      int type[LANES], no_close[LANES], si1[LANES], sj1[LANES];
+      int new_c[LANES], stack_energy[LANES], new_fML[LANES], decomp[LANES];
+      int off11[LANES], off21[LANES], off12[LANES], off22[LANES];
+      int mm1n[LANES], mm23[LANES], mmI[LANES], au[LANES];
+      int any_pair = 0;
+
+      for (l = 0; l < LANES; l++) {
+        type[l] = ptype[ij * LANES + l];
+        any_pair |= type[l];
+      }
+
+      if (any_pair) {
+        /* hairpin ----------------------------------------------*/
+        for (l = 0; l < LANES; l++) {
+          si1[l] = S1[(i + 1) * LANES + l];
+          sj1[l] = S1[(j - 1) * LANES + l];
+          no_close[l] = (((type[l] == 3) || (type[l] == 4)) && noGUclosure);
+          stack_energy[l] = INF;
+          if (!type[l])
+            new_c[l] = INF;
+          else
+            new_c[l] = (no_close[l])
+                           ? FORBIDDEN
+                           : E_Hairpin(j - i - 1, type[l], si1[l], sj1[l],
+                                       strings[l] + i - 1, P);
+        }
+
+        /* stacks, bulges and interior loops, the loop sizes are the same
+         * in all lanes, only the table entries differ. The parts of the
+         * table offsets that only depend on (i,j) are computed once. */
+        for (l = 0; l < LANES; l++) {
+          int t = type[l];
+          off11[l] = t * s11_0 + si1[l] * s11_2 + sj1[l];
+          off21[l] = t * s21_0 + si1[l] * s21_2 + sj1[l];
+          off12[l] = t * s21_1 + si1[l] * s21_3;
+          off22[l] = t * s22_0 + si1[l] * s22_2 + sj1[l];
+          mm1n[l] = P->mismatch1nI[t][si1[l]][sj1[l]];
+          mm23[l] = P->mismatch23I[t][si1[l]][sj1[l]];
+          mmI[l] = P->mismatchI[t][si1[l]][sj1[l]];
+          au[l] = (t > 2) ? P->TerminalAU : 0;
+        }
+        /* q in the outer loop, (p,q) and (p+1,q) are next to each other
+         * in c */
+        for (q = j - 1; q >= i + 2 + TURN && j - q - 1 <= MAXLOOP; q--) {
+          int maxp = MIN2(q - 1 - TURN, i + 1 + MAXLOOP - (j - q - 1));
+          for (p = i + 1; p <= maxp; p++) {
+            const char *tp = rptype + (indx[q] - p) * LANES;
+            const int *sp1 = S1 + (p - 1) * LANES;
+            const int *sq1 = S1 + (q + 1) * LANES;
+            int u1 = p - i - 1;
+            int u2 = j - q - 1;
+            int nl = MAX2(u1, u2);
+            int ns = MIN2(u1, u2);
+            int type_2[LANES], ee[LANES];
+            int base;
+
+            if ((ns == 0 && nl > 1) || (ns == 1 && nl > 2) ||
+                (ns == 2 && nl > 3) || ns > 2) {
+              /* the most frequent loops, the part of the energy that only
+               * depends on (p,q) is already added to c[p,q] */
+              const int *inner, *outer;
+              if (ns == 0) { /* bulge */
+                base = (nl <= MAXLOOP)
+                           ? P->bulge[nl]
+                           : (P->bulge[30] + (int)(P->lxc * log(nl / 30.)));
+                inner = cB + (indx[q] - p) * LANES;
+                outer = au;
+              } else if (ns == 1) { /* 1xn loop */
+                base = (nl + 1 <= MAXLOOP)
+                           ? (P->internal_loop[nl + 1])
+                           : (P->internal_loop[30] +
+                              (int)(P->lxc * log((nl + 1) / 30.)));
+                base += MIN2(MAX_NINIO, (nl - ns) * P->ninio[2]);
+                inner = c1n + (indx[q] - p) * LANES;
+                outer = mm1n;
+              } else { /* generic interior loop */
+                base = (u1 + u2 <= MAXLOOP)
+                           ? (P->internal_loop[u1 + u2])
+                           : (P->internal_loop[30] +
+                              (int)(P->lxc * log((u1 + u2) / 30.)));
+                base += MIN2(MAX_NINIO, (nl - ns) * P->ninio[2]);
+                inner = cI + (indx[q] - p) * LANES;
+                outer = mmI;
+              }
+              FOR_LANES(l) { ee[l] = base + outer[l] + inner[l]; }
+            } else {
+              const int *cpq = c + (indx[q] - p) * LANES;
+              int energy[LANES];
+              for (l = 0; l < LANES; l++)
+                type_2[l] = tp[l];
+              if (nl == 0) { /* stack */
+                FOR_LANES(l) { energy[l] = stack[type[l] * st0 + type_2[l]]; }
+              } else if (ns == 0) { /* bulge of size 1 */
+                base = P->bulge[1];
+                FOR_LANES(l) {
+                  energy[l] = base + stack[type[l] * st0 + type_2[l]];
+                }
+              } else if (nl == 1) { /* 1x1 loop */
+                FOR_LANES(l) {
+                  energy[l] = int11[off11[l] + type_2[l] * s11_1];
+                }
+              } else if (ns == 1) { /* 2x1 loop */
+                if (u1 == 1) {
+                  FOR_LANES(l) {
+                    energy[l] =
+                        int21[off21[l] + type_2[l] * s21_1 + sq1[l] * s21_3];
+                  }
+                } else {
+                  FOR_LANES(l) {
+                    energy[l] = int21[off12[l] + type_2[l] * s21_0 +
+                                      sq1[l] * s21_2 + sp1[l]];
+                  }
+                }
+              } else if (nl == 2) { /* 2x2 loop */
+                FOR_LANES(l) {
+                  energy[l] = int22[off22[l] + type_2[l] * s22_1 +
+                                    sp1[l] * s22_3 + sq1[l] * s22_4];
+                }
+              } else { /* 2x3 loop */
+                base = P->internal_loop[5] + P->ninio[2];
+                FOR_LANES(l) {
+                  energy[l] =
+                      base + mm23[l] +
+                      mismatch23I[type_2[l] * smm_0 + sq1[l] * smm_1 + sp1[l]];
+                }
+              }
+              FOR_LANES(l) { ee[l] = energy[l] + cpq[l]; }
+              if (nl == 0) {
+                FOR_LANES(l) {
+                  if (type_2[l])
+                    stack_energy[l] = energy[l]; /* remember stack energy */
+                }
+              }
+            }
+
+            if (noGUclosure && nl > 0) {
+              for (l = 0; l < LANES; l++) {
+                type_2[l] = tp[l];
+                if (no_close[l] || (type_2[l] == 3) || (type_2[l] == 4))
+                  ee[l] = INF;
+              }
+            }
+            /* c[p,q] is INF in lanes without a (p,q) pair, so these never
+             * win against the hairpin of lanes with an (i,j) pair */
+            FOR_LANES(l) { new_c[l] = MIN2(new_c[l], ee[l]); }
+          } /* end p-loop */
+        }   /* end q-loop */
+
+        /* multi-loop decomposition ------------------------*/
+        FOR_LANES(l) {
+          int tt = rt[type[l]];
+          int ml = DMLi1[(j - 1) * LANES + l] + P->MLintern[tt] +
+                   ((tt > 2) ? P->TerminalAU : 0);
+          if (dangle_model == 2)
+            ml += P->mismatchM[tt][sj1[l]][si1[l]];
+          ml += P->MLclosing;
+          if (type[l] && !no_close[l])
+            new_c[l] = MIN2(new_c[l], ml);
+        }
+
+        FOR_LANES(l) {
+          int stacked = cc1[(j - 1) * LANES + l] + stack_energy[l];
+          if (type[l]) {
+            new_c[l] = MIN2(new_c[l], stacked);
+            cc[j * LANES + l] = new_c[l];
+            c[ij * LANES + l] = (noLonelyPairs) ? stacked : new_c[l];
+          } else {
+            c[ij * LANES + l] = INF;
+          }
+        }
+      } /* end >> if (pair) << */
+
+      else
+        FOR_LANES(l) { c[ij * LANES + l] = INF; }
+
+      /* (i,j) as the inner pair of a loop closed by a pair (i-1-u1,j+1+u2) */
+      FOR_LANES(l) {
+        int type_2 = rptype[ij * LANES + l];
+        int mm = type_2 * smm_0 + S1[(j + 1) * LANES + l] * smm_1 +
+                 S1[(i - 1) * LANES + l];
+        cI[ij * LANES + l] = c[ij * LANES + l] + mismatchI[mm];
+        c1n[ij * LANES + l] = c[ij * LANES + l] + mismatch1nI[mm];
+        cB[ij * LANES + l] =
+            c[ij * LANES + l] + ((type_2 > 2) ? P->TerminalAU : 0);
+      }
+
+      /* done with c[i,j], now compute fML[i,j] */
+      FOR_LANES(l) {
+        int en = INF;
+        if (type[l]) {
+          en = c[ij * LANES + l] + P->MLintern[type[l]] +
+               ((type[l] > 2) ? P->TerminalAU : 0);
+          if (dangle_model == 2)
+            en += P->mismatchM[type[l]][S1[(i - 1) * LANES + l]]
+                              [S1[(j + 1) * LANES + l]];
+        }
+        en = MIN2(en, fML[(ij - 1) * LANES + l] + P->MLbase);
+        new_fML[l] = MIN2(fML[(indx[j - 1] - i) * LANES + l] + P->MLbase, en);
+        decomp[l] = INF;
+      }
+
+      /* modular decomposition -------------------------------*/
+      for (k = i + 1 + TURN; k <= j - 2 - TURN; k++) {
+        const int *fmi = Fmi + k * LANES;
+        const int *fml = fML + (indx[j] - k - 1) * LANES;
+        FOR_LANES(l) { decomp[l] = MIN2(decomp[l], fmi[l] + fml[l]); }
+      }
+      FOR_LANES(l) {
+        DMLi[j * LANES + l] = decomp[l]; /* store for use in ML decompositon */
+        fML[ij * LANES + l] = Fmi[j * LANES + l] = MIN2(new_fML[l], decomp[l]);
+      }
+    }
+
+    {
+      int *FF; /* rotate the auxilliary arrays */
+      FF = DMLi2;
+      DMLi2 = DMLi1;
+      DMLi1 = DMLi;
+      DMLi = FF;
+      FF = cc1;
+      cc1 = cc;
+      cc = FF;
+      for (j = 1; j <= length; j++)
+        FOR_LANES(l) {
+          cc[j * LANES + l] = Fmi[j * LANES + l] = DMLi[j * LANES + l] = INF;
+        }
+    }
+  }
+
+  /* calculate energies of 5' and 3' fragments */
+
+  for (j = 0; j <= TURN + 1; j++)
+    FOR_LANES(l) { f5[j * LANES + l] = 0; }
+
+  for (j = TURN + 2; j <= length; j++) {
+    /* with dangles 2, the 3' end has no neighbour at the end of the
+     * sequence */
+    int has_3 = (dangle_model == 2) && (j < length);
+    FOR_LANES(l) { f5[j * LANES + l] = f5[(j - 1) * LANES + l]; }
+    for (i = j - TURN - 1; i >= 1 && j - i < width; i--) {
+      const char *tp = ptype + (indx[j] - i) * LANES;
+      const int *cij = c + (indx[j] - i) * LANES;
+      int has_5 = (dangle_model == 2) && (i > 1);
+      FOR_LANES(l) {
+        int type = tp[l];
+        int en = cij[l] + ((type > 2) ? P->TerminalAU : 0);
+        if (has_5 && has_3)
+          en += P->mismatchExt[type][S1[(i - 1) * LANES + l]]
+                              [S1[(j + 1) * LANES + l]];
+        else if (has_5)
+          en += P->dangle5[type][S1[(i - 1) * LANES + l]];
+        else if (has_3)
+          en += P->dangle3[type][S1[(j + 1) * LANES + l]];
+        if (i > 1)
+          en += f5[(i - 1) * LANES + l];
+        if (type)
+          f5[j * LANES + l] = MIN2(f5[j * LANES + l], en);
+      }
+    }
+  }
+}
+
+/* fold() or, with a span limit, Lfold_mfe() for the models the batch
+ * recursions do not cover */
+PRIVATE void fold_one_by_one(struct fold_context *ctx, const char **sequences,
+                             int count, int maxdist, float *energies) {
+  int l;
+  for (l = 0; l < count; l++) {
+    int length = (int)strlen(sequences[l]);
+    if (maxdist < length) {
+      energies[l] = Lfold_mfe(ctx, sequences[l], maxdist);
+    } else {
+      char *structure = (char *)space(sizeof(char) * (length + 1));
+      energies[l] = fold(ctx, sequences[l], structure);
+      free(structure);
+    }
+  }
+}
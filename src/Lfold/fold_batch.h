@@ -0,0 +1,43 @@
+#ifndef __VIENNA_RNA_PACKAGE_FOLD_BATCH_H__
+#define __VIENNA_RNA_PACKAGE_FOLD_BATCH_H__
+
+#include "fold_context.h"
+
+/**
+ *  \file fold_batch.h
+ *  \brief MFE folding of several sequences of the same length at once
+ *
+ *  Every entry of the dynamic programming arrays holds one energy per
+ *  sequence (lane), so all sequences run through the recursions of fold()
+ *  together and the innermost loops work on contiguous lanes that the
+ *  compiler turns into vector instructions.
+ */
+
+#define FOLD_BATCH_LANES 8
+
+/**
+ *  \brief Compute the minimum free energies of up to #FOLD_BATCH_LANES
+ *  sequences of the same length
+ *
+ *  Only base pairs with a span smaller than maxdist are allowed, as in
+ *  Lfold(), and only the band of the arrays that holds them is stored. The
+ *  energies equal the ones returned by Lfold_mfe() or, if maxdist is not
+ *  smaller than the length, by fold(). No structures are backtracked. Models
+ *  the batch recursions do not cover (dangles 1 and 3, g-quadruplexes,
+ *  constraints or lengths that differ) are folded one by one.
+ *
+ *  \param ctx        The folding context, it keeps the arrays between calls
+ *  \param sequences  The sequences
+ *  \param count      The number of sequences
+ *  \param maxdist    The span limit, 0 for none
+ *  \param energies   The minimum free energies (kcal/mol) of the sequences
+ */
+void fold_batch(struct fold_context *ctx, const char **sequences, int count,
+                int maxdist, float *energies);
+
+/**
+ *  \brief Free the arrays of fold_batch()
+ */
+void free_batch_arrays(struct fold_context *ctx);
+
+#endif
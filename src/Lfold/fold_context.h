@@ -0,0 +1,146 @@
+#ifndef __VIENNA_RNA_PACKAGE_FOLD_CONTEXT_H__
+#define __VIENNA_RNA_PACKAGE_FOLD_CONTEXT_H__
+
+#include "data_structures.h"
+#include "sparse_ml.h"
+
+/**
+ *  \file fold_context.h
+ *  \brief Working memory of the MFE folding routines
+ */
+
+#define MAXSECTORS 500 /* dimension for a backtrack array */
+
+/**
+ *  \brief The arrays of Lfold()
+ *
+ *  They are kept after Lfold() returns, so the structures it reports can be
+ *  backtracked on demand, until the next call. All arrays but ggg live in one
+ *  block that is reused by the following calls and only grows.
+ */
+struct lfold_arrays {
+  int **c;       /* energy array, given that i-j pair */
+  int *cc;       /* linear array for calculating canonical structures */
+  int *cc1;      /*   "     "        */
+  int *f3;       /* energy of 5' end */
+  int **fML;     /* multi-loop auxiliary energy array */
+  int *Fmi;      /* holds row i of fML (avoids jumps in memory) */
+  int *DMLi;     /* DMLi[j] holds MIN(fML[i,k]+fML[k+1,j])  */
+  int *DMLi1;    /*             MIN(fML[i+1,k]+fML[k+1,j])  */
+  int *DMLi2;    /*             MIN(fML[i+2,k]+fML[k+1,j])  */
+  int **fMLt;    /* fML by columns, fMLt[j][i - j + maxdist] = fML[i][j - i] */
+  int **cI;      /* c plus the inner terms of interior loops, 1xn loops */
+  int **c1n;     /*   and bulges, for the last MAXLOOP + 2 rows         */
+  int **cB;
+  char **ptype;  /* precomputed array of pair types */
+  unsigned int length;
+  int maxdist;
+  int **ggg;     /* g-quadruplex energies, with gquad only */
+  char *buffer;  /* the structure written by the backtracking */
+  void *arena;          /* the block of the arrays */
+  size_t arena_size;
+  const char *sequence; /* the folded sequence, not owned */
+  short *S, *S1; /* encoded sequence */
+};
+
+/**
+ *  \brief The arrays of fold_batch(), every entry holds one value per lane
+ */
+struct batch_arrays {
+  int *indx;     /* index for moving in the columns of the band */
+  int *c;        /* energy array, given that i-j pair */
+  int *fML;      /* multi-loop auxiliary energy array */
+  int *cI;       /* c plus the mismatch of i-j as inner pair of a loop */
+  int *c1n;      /*   "     "    of a 1xn loop */
+  int *cB;       /* c plus the terminal AU penalty of i-j in a bulge */
+  char *ptype;   /* pair types */
+  char *rptype;  /* reversed pair types, rtype[ptype] */
+  int *S1;       /* encoded sequences */
+  int *f5;       /* energy of 5' end */
+  int *cc;       /* linear array for calculating canonical structures */
+  int *cc1;      /*   "     "        */
+  int *Fmi;      /* holds row i of fML */
+  int *DMLi;     /* DMLi[j] holds MIN(fML[i,k]+fML[k+1,j])  */
+  int *DMLi1;    /*             MIN(fML[i+1,k]+fML[k+1,j])  */
+  int *DMLi2;    /*             MIN(fML[i+2,k]+fML[k+1,j])  */
+  unsigned int length;
+  int width;   /* the pairs (i,j) with j - i < width are stored */
+  size_t size; /* the entries per lane of the band arrays */
+};
+
+/**
+ *  \brief Everything fold(), Lfold() and the energy evaluation need between
+ *  calls
+ *
+ *  A context must not be shared by concurrent calls, every thread keeps its
+ *  own. The arrays of fold() are kept and only grow when a longer sequence is
+ *  folded, the energy parameters are kept as long as the temperature does not
+ *  change.
+ */
+struct fold_context {
+  paramT *P;
+  short *S, *S1;
+  int with_gquad;
+  int sparse_ml;     /* decompose multiloops with the candidate lists of
+                        sparse folding (dangles 0 and 2) */
+  struct ml_candidates ml;
+
+  int init_length;   /* length the arrays of fold() were allocated for */
+  int *indx;         /* index for moving in the triangle matrices c[] and fMl[]*/
+  int *c;            /* energy array, given that i-j pair */
+  int *cc;           /* linear array for calculating canonical structures */
+  int *cc1;          /*   "     "        */
+  int *f5;           /* energy of 5' end */
+  int *f53;          /* energy of 5' end with 3' nucleotide not available for
+                        mismatches */
+  int *fML;          /* multi-loop auxiliary energy array */
+  int *fM1;          /* second ML array, only for subopt */
+  int *fM2;          /* fM2 = multiloop region with exactly two stems,
+                        extending to 3' end        */
+  int *Fmi;          /* holds row i of fML (avoids jumps in memory) */
+  int *DMLi;         /* DMLi[j] holds MIN(fML[i,k]+fML[k+1,j])  */
+  int *DMLi1;        /*             MIN(fML[i+1,k]+fML[k+1,j])  */
+  int *DMLi2;        /*             MIN(fML[i+2,k]+fML[k+1,j])  */
+  int *DMLi_a;       /* DMLi_a[j] holds min energy for at least two
+                        multiloop stems in [i,j], where j is available
+                        for dangling onto a surrounding stem */
+  int *DMLi_o;       /* DMLi_o[j] holds min energy for at least two
+                        multiloop stems in [i,j], where j is unavailable
+                        for dangling onto a surrounding stem */
+  int *DMLi1_a;
+  int *DMLi1_o;
+  int *DMLi2_a;
+  int *DMLi2_o;
+  int Fc, FcH, FcI, FcM; /* parts of the exterior loop energies */
+  sect sector[MAXSECTORS]; /* stack of partial structures for backtracking */
+  char *ptype;       /* precomputed array of pair types */
+  int *BP;           /* contains the structure constrainsts: BP[i]
+                        -1: | = base must be paired
+                        -2: < = base must be paired with j<i
+                        -3: > = base must be paired with j>i
+                        -4: x = base must not pair
+                        positive int: base is paired with int      */
+  short *pair_table; /* needed by energy of struct */
+  bondT *base_pair2; /* this replaces base_pair from fold_vars.c */
+  int circular;
+  int struct_constrained;
+  int *ggg;          /* minimum free energies of the gquadruplexes */
+
+  struct lfold_arrays lfold;
+  struct batch_arrays batch;
+};
+
+/**
+ *  \brief Allocate an empty folding context, the arrays are allocated by the
+ *  first fold
+ *
+ *  \return 0 on success, 1 if the memory could not be allocated
+ */
+int create_fold_context(struct fold_context **ctx);
+
+/**
+ *  \brief Free a folding context and all arrays it holds
+ */
+void free_fold_context(struct fold_context *ctx);
+
+#endif
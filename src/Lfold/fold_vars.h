@@ -12,6 +12,19 @@
 #define PUBLIC
 #define PRIVATE static
 
+/**
+ *  \brief Marks a folding kernel to be compiled for every instruction set
+ *
+ *  The best version the processor supports is chosen at runtime. Needs
+ *  config.h to be included first.
+ */
+#ifdef HAVE_TARGET_CLONES
+#define VECTOR_KERNEL                                                          \
+  __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define VECTOR_KERNEL
+#endif
+
 /**
  *  \brief Global switch to activate/deactivate folding with structure constraints
  */
@@ -364,6 +364,36 @@ PUBLIC int **get_gquad_L_matrix(short *S, int start, int maxdist, int n,
   return data;
 }
 
+PUBLIC void fill_gquad_L_matrix(short *S, int start, int maxdist, int n,
+                                int **g, int is_first, paramT *P) {
+  int i, j, k, *gg;
+
+  gg = get_g_islands_sub(S, start, MIN2(n, start + maxdist + 4));
+
+  if (is_first) {
+    for (k = n; (k > n - maxdist - 5) && (k >= 0); k--)
+      for (i = 0; i < maxdist + 5; i++)
+        g[k][i] = INF;
+
+    FOR_EACH_GQUAD(i, j, start, n) {
+      process_gquad_enumeration(gg, i, j, &gquad_mfe, (void *)(&(g[i][j - i])),
+                                (void *)P, NULL, NULL);
+    }
+  } else {
+    for (i = 0; i < maxdist + 5; i++)
+      g[start][i] = INF;
+
+    FOR_EACH_GQUAD_AT(start, j, start + maxdist + 4) {
+      process_gquad_enumeration(gg, start, j, &gquad_mfe,
+                                (void *)(&(g[start][j - start])), (void *)P,
+                                NULL, NULL);
+    }
+  }
+
+  gg += start - 1;
+  free(gg);
+}
+
 PUBLIC plist *get_plist_gquad_from_db(const char *structure, float pr) {
   int x, size, actual_size, L, n, ge, ee, gb, l[3];
   plist *pl;
@@ -75,6 +75,23 @@ int         **get_gquad_L_matrix( short *S,
                                   int **g,
                                   paramT *P);
 
+/**
+ *  \brief Fill the g-quadruplex matrix of the sliding window in rows owned
+ *  by the caller
+ *
+ *  Like get_gquad_L_matrix(), but g holds a row of maxdist + 5 entries for
+ *  every position up to n, so nothing is allocated or rotated. With is_first
+ *  the rows of the first window from start to n are filled, otherwise only
+ *  row start.
+ */
+void        fill_gquad_L_matrix(short *S,
+                                int start,
+                                int maxdist,
+                                int n,
+                                int **g,
+                                int is_first,
+                                paramT *P);
+
 void        get_gquad_pattern_mfe(short *S,
                                   int i,
                                   int j,
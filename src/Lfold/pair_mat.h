@@ -125,9 +125,9 @@ static void make_pair_matrix(void)
    }
 }
 
-static short *encode_sequence(const char *sequence, short how){
+/* S has to hold strlen(sequence) + 2 entries */
+static void encode_sequence_to(short *S, const char *sequence, short how){
   unsigned int i,l = (unsigned int)strlen(sequence);
-  short         *S = (short *) space(sizeof(short)*(l+2));
 
   switch(how){
     /* standard encoding as always used for S */
@@ -143,6 +143,12 @@ static short *encode_sequence(const char *sequence, short how){
               S[0] = S[l];
               break;
   }
+}
+
+static short *encode_sequence(const char *sequence, short how){
+  unsigned int l = (unsigned int)strlen(sequence);
+  short         *S = (short *) space(sizeof(short)*(l+2));
 
+  encode_sequence_to(S, sequence, how);
   return S;
 }
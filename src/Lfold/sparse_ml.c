@@ -0,0 +1,61 @@
+/** \file **/
+
+/*
+                  candidate lists for the multiloop
+                  decomposition of sparse folding
+*/
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "fold_vars.h"
+#include "sparse_ml.h"
+
+PUBLIC void prepare_ml_candidates(struct ml_candidates *m, int length) {
+  int j;
+
+  if (length > m->length) {
+    for (j = 0; j <= m->length + 1 && m->list != NULL; j++)
+      free(m->list[j]);
+    free(m->list);
+    free(m->count);
+    free(m->size);
+    free(m->fM1);
+    m->list = (struct ml_candidate **)space(sizeof(struct ml_candidate *) *
+                                            (length + 2));
+    m->count = (int *)space(sizeof(int) * (length + 2));
+    m->size = (int *)space(sizeof(int) * (length + 2));
+    m->fM1 = (int *)space(sizeof(int) * (length + 2));
+    m->length = length;
+  }
+  /* the lists keep their memory */
+  memset(m->count, 0, sizeof(int) * (m->length + 2));
+}
+
+PUBLIC void add_ml_candidate(struct ml_candidates *m, int j, int k,
+                             int energy) {
+  if (m->count[j] == m->size[j]) {
+    m->size[j] = (m->size[j] > 0) ? 2 * m->size[j] : 8;
+    m->list[j] = (struct ml_candidate *)xrealloc(
+        m->list[j], sizeof(struct ml_candidate) * m->size[j]);
+  }
+  m->list[j][m->count[j]].k = k;
+  m->list[j][m->count[j]].energy = energy;
+  m->count[j]++;
+}
+
+PUBLIC void free_ml_candidates(struct ml_candidates *m) {
+  int j;
+
+  if (m->list != NULL)
+    for (j = 0; j <= m->length + 1; j++)
+      free(m->list[j]);
+  free(m->list);
+  free(m->count);
+  free(m->size);
+  free(m->fM1);
+  memset(m, 0, sizeof(struct ml_candidates));
+}
@@ -0,0 +1,87 @@
+#ifndef __VIENNA_RNA_PACKAGE_SPARSE_ML_H__
+#define __VIENNA_RNA_PACKAGE_SPARSE_ML_H__
+
+#include "energy_const.h"
+
+#ifndef INLINE
+#ifdef __GNUC__
+#define INLINE inline
+#else
+#define INLINE
+#endif
+#endif
+
+/**
+ *  \file sparse_ml.h
+ *  \brief Candidate lists for the multiloop decomposition of sparse folding
+ *
+ *  The decomposition of fML[i,j] into two parts, min_k fML[i,k] +
+ *  fML[k+1,j], is the same as min_k fML[i,k-1] + fM1[k,j], where fM1[k,j] is
+ *  the energy of a part with a single stem that starts at k. A start k only
+ *  has to be looked at if fM1[k,j] is smaller than the decomposition of
+ *  [k,j] itself: otherwise the split of [k,j] at some q combined with
+ *  [i,k-1] is never worse than the split of [i,j] at q. These candidates are
+ *  few, so the decomposition takes a time proportional to their number
+ *  instead of the span, and the energies stay the same.
+ *
+ *  Only the dangle models 0 and 2 are covered, where a multiloop part is the
+ *  sum of its stems and unpaired bases.
+ */
+
+/**
+ *  \brief A candidate k of column j
+ */
+struct ml_candidate {
+  int k;
+  int energy; /* fM1[k,j] */
+};
+
+/**
+ *  \brief The candidates of all columns and fM1 of the row being filled
+ */
+struct ml_candidates {
+  struct ml_candidate **list; /* list[j] holds the candidates of column j */
+  int *count;
+  int *size;
+  int *fM1; /* fM1[j] of the current row */
+  int length;
+};
+
+/**
+ *  \brief Empty the candidate lists for a sequence of the given length
+ */
+void prepare_ml_candidates(struct ml_candidates *m, int length);
+
+/**
+ *  \brief Add the start k to the candidates of column j
+ */
+void add_ml_candidate(struct ml_candidates *m, int j, int k, int energy);
+
+/**
+ *  \brief Free the candidate lists
+ */
+void free_ml_candidates(struct ml_candidates *m);
+
+/**
+ *  \brief The decomposition of [i,j] from the candidates of column j
+ *
+ *  \param m        The candidate lists
+ *  \param j        The column
+ *  \param Fmi      Row i of fML, Fmi[x - offset] holds fML[i,x]
+ *  \param offset   The offset of the row
+ */
+INLINE static int ml_decomposition(const struct ml_candidates *m, int j,
+                                   const int *Fmi, int offset) {
+  const struct ml_candidate *list = m->list[j];
+  int n = m->count[j];
+  int decomp = INF;
+  int l;
+
+  for (l = 0; l < n; l++) {
+    int en = Fmi[list[l].k - 1 - offset] + list[l].energy;
+    decomp = (en < decomp) ? en : decomp;
+  }
+  return decomp;
+}
+
+#endif
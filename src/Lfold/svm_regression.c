@@ -0,0 +1,186 @@
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include "svm_regression.h"
+#include "model_avg.inc"
+#include "model_sd.inc"
+
+#define MIN_MODEL_LENGTH 50
+#define MAX_MODEL_LENGTH 400
+#define MIN_MODEL_GC 0.2
+#define MAX_MODEL_GC 0.8
+
+/* Reads the value of a header line like "gamma 6". */
+static int parse_model_value(const char *model_string, const char *key,
+                             double *value) {
+  size_t key_length = strlen(key);
+  const char *line = model_string;
+  while (line != NULL && *line != 0) {
+    if (strncmp(line, key, key_length) == 0 && line[key_length] == ' ') {
+      *value = strtod(line + key_length + 1, NULL);
+      return 0;
+    }
+    line = strchr(line, '\n');
+    if (line != NULL) {
+      line++;
+    }
+  }
+  return 1;
+}
+
+int create_svm_model(struct svm_model **model, const char *model_string) {
+  double gamma, rho, total_sv;
+  if (parse_model_value(model_string, "gamma", &gamma) ||
+      parse_model_value(model_string, "rho", &rho) ||
+      parse_model_value(model_string, "total_sv", &total_sv)) {
+    return 1;
+  }
+  const char *line = strstr(model_string, "SV\n");
+  if (line == NULL) {
+    return 1;
+  }
+  line += 3;
+
+  struct svm_model *tmp = (struct svm_model *)malloc(sizeof(struct svm_model));
+  if (tmp == NULL) {
+    return 1;
+  }
+  tmp->n = (int)total_sv;
+  tmp->gamma = gamma;
+  tmp->rho = rho;
+  tmp->coef = (double *)malloc(tmp->n * sizeof(double));
+  tmp->sv = (double *)calloc(tmp->n * SVM_FEATURE_COUNT, sizeof(double));
+  if (tmp->coef == NULL || tmp->sv == NULL) {
+    free_svm_model(tmp);
+    return 1;
+  }
+
+  /* every line holds the coefficient followed by index:value pairs, features
+   * that are 0 may be missing */
+  for (int i = 0; i < tmp->n; i++) {
+    char *end = NULL;
+    tmp->coef[i] = strtod(line, &end);
+    if (end == line) {
+      free_svm_model(tmp);
+      return 1;
+    }
+    line = end;
+    while (*line == ' ') {
+      line++;
+    }
+    while (*line != '\n' && *line != 0) {
+      long index = strtol(line, &end, 10);
+      if (end == line || *end != ':' || index < 1 ||
+          index > SVM_FEATURE_COUNT) {
+        free_svm_model(tmp);
+        return 1;
+      }
+      line = end + 1;
+      tmp->sv[i * SVM_FEATURE_COUNT + index - 1] = strtod(line, &end);
+      line = end;
+      while (*line == ' ') {
+        line++;
+      }
+    }
+    if (*line == '\n') {
+      line++;
+    }
+  }
+  *model = tmp;
+  return 0;
+}
+
+void free_svm_model(struct svm_model *model) {
+  if (model == NULL) {
+    return;
+  }
+  free(model->coef);
+  free(model->sv);
+  free(model);
+}
+
+double svm_predict(const struct svm_model *model, const double *features) {
+  double sum = 0.0;
+  for (int i = 0; i < model->n; i++) {
+    const double *sv = model->sv + i * SVM_FEATURE_COUNT;
+    double distance = 0.0;
+    for (int k = 0; k < SVM_FEATURE_COUNT; k++) {
+      double d = sv[k] - features[k];
+      distance += d * d;
+    }
+    sum += model->coef[i] * exp(-model->gamma * distance);
+  }
+  return sum - model->rho;
+}
+
+int create_mfe_models(struct mfe_models **models) {
+  struct mfe_models *tmp =
+      (struct mfe_models *)malloc(sizeof(struct mfe_models));
+  if (tmp == NULL) {
+    return 1;
+  }
+  tmp->avg = NULL;
+  tmp->sd = NULL;
+  if (create_svm_model(&tmp->avg, avg_model_string) ||
+      create_svm_model(&tmp->sd, sd_model_string)) {
+    free_mfe_models(tmp);
+    return 1;
+  }
+  *models = tmp;
+  return 0;
+}
+
+void free_mfe_models(struct mfe_models *models) {
+  if (models == NULL) {
+    return;
+  }
+  free_svm_model(models->avg);
+  free_svm_model(models->sd);
+  free(models);
+}
+
+int predict_mfe_distribution(const struct mfe_models *models,
+                             const char *seq, int n, double *mean,
+                             double *sd) {
+  int counts[4] = {0, 0, 0, 0}; /* A, C, G, U */
+  for (int i = 0; i < n; i++) {
+    switch (toupper(seq[i])) {
+    case 'A':
+      counts[0]++;
+      break;
+    case 'C':
+      counts[1]++;
+      break;
+    case 'G':
+      counts[2]++;
+      break;
+    case 'T':
+    case 'U':
+      counts[3]++;
+      break;
+    }
+  }
+  int at = counts[0] + counts[3];
+  int gc = counts[1] + counts[2];
+  if (n < MIN_MODEL_LENGTH || n > MAX_MODEL_LENGTH || at == 0 || gc == 0) {
+    return 1;
+  }
+  double gc_content = (double)gc / (double)(at + gc);
+  if (gc_content < MIN_MODEL_GC || gc_content > MAX_MODEL_GC) {
+    return 1;
+  }
+  double features[SVM_FEATURE_COUNT];
+  features[0] = gc_content;
+  features[1] = (double)counts[0] / (double)at;
+  features[2] = (double)counts[1] / (double)gc;
+  features[3] = (double)(n - MIN_MODEL_LENGTH) /
+                (double)(MAX_MODEL_LENGTH - MIN_MODEL_LENGTH);
+  /* the models predict the mean per nt and the standard deviation per square
+   * root of nt */
+  *mean = svm_predict(models->avg, features) * n;
+  *sd = svm_predict(models->sd, features) * sqrt(n);
+  return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef __VIENNA_RNA_PACKAGE_SVM_REGRESSION_H__
+#define __VIENNA_RNA_PACKAGE_SVM_REGRESSION_H__
+
+/**
+ *  \file svm_regression.h
+ *  \brief Predicting the mfe distribution of shuffled sequences
+ *
+ *  The support vector regression models of model_avg.inc and model_sd.inc
+ *  predict mean and standard deviation of the mfe of mononucleotide shuffled
+ *  sequences from the length and the nucleotide composition of a sequence.
+ */
+
+#define SVM_FEATURE_COUNT 4
+
+/**
+ *  \brief A nu-SVR model with a radial basis function kernel
+ */
+struct svm_model {
+  int n;        /* number of support vectors */
+  double gamma; /* kernel parameter */
+  double rho;   /* offset of the decision function */
+  double *coef; /* coefficients of the support vectors */
+  double *sv;   /* n * SVM_FEATURE_COUNT support vector features */
+};
+
+/**
+ *  \brief The models used for predicting the mfe distribution
+ */
+struct mfe_models {
+  struct svm_model *avg;
+  struct svm_model *sd;
+};
+
+/**
+ *  \brief Parse a model in the libsvm text format
+ *
+ *  \return 0 on success, 1 if the model is invalid or memory could not be
+ *  allocated
+ */
+int create_svm_model(struct svm_model **model, const char *model_string);
+
+/**
+ *  \brief Free a model, NULL is allowed
+ */
+void free_svm_model(struct svm_model *model);
+
+/**
+ *  \brief Evaluate the regression function of a model
+ */
+double svm_predict(const struct svm_model *model, const double *features);
+
+/**
+ *  \brief Load the bundled models for mean and standard deviation
+ *
+ *  \return 0 on success, 1 otherwise
+ */
+int create_mfe_models(struct mfe_models **models);
+
+/**
+ *  \brief Free the models, NULL is allowed
+ */
+void free_mfe_models(struct mfe_models *models);
+
+/**
+ *  \brief Predict mean and standard deviation of the mfe (kcal/mol) of
+ *  shuffled versions of a sequence
+ *
+ *  The models are only trained for sequences of 50 to 400 nt with a GC
+ *  content between 0.2 and 0.8, other sequences are rejected.
+ *
+ *  \return 0 on success, 1 if the sequence is outside of the range of the
+ *  models
+ */
+int predict_mfe_distribution(const struct mfe_models *models,
+                             const char *seq, int n, double *mean,
+                             double *sd);
+
+#endif
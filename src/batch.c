@@ -63,8 +63,8 @@ int batch(int argc, char **argv) {
   if (err) {
     return err;
   }
-  for (size_t i = 0; i < sam_headers->header_n; ++i) {
-    char *selected_chrom = sam_headers->headers[i]->sn;
+  for (size_t i = 0; i < sam_headers->chromosomes->n; ++i) {
+    char *selected_chrom = sam_headers->chromosomes->names[i];
     log_basic(
         config->log_level,
         "##############################################################\n");
@@ -99,13 +99,22 @@ int batch_main(struct configuration_params *config, char *mira_bin,
     return err;
   }
 
+  struct sam_file *sam = NULL;
+  log_basic_timestamp(config->log_level, "Reading SAM file...\n");
+  err = parse_sam(&sam, sam_file, selected_chrom);
+  if (err) {
+    print_error(err);
+    return err;
+  }
+
   char bed_filename[] = "cluster_contigs.bed";
   char *bed_file_path = NULL;
   create_file_path(&bed_file_path, output_path, bed_filename);
 
-  err = cluster_main(config, sam_file, bed_file_path, selected_chrom);
+  err = cluster_sam_main(config, sam, bed_file_path);
   if (err) {
     free(bed_file_path);
+    free_sam(sam);
     return err;
   }
   char mira_filename[] = "fold_candidates.miRA";
@@ -116,10 +125,11 @@ int batch_main(struct configuration_params *config, char *mira_bin,
   if (err) {
     free(bed_file_path);
     free(mira_file_path);
+    free_sam(sam);
     return err;
   }
-  err = coverage_main(config, mira_bin, mira_file_path, sam_file, output_path,
-                      selected_chrom);
+  err = coverage_sam_main(config, mira_bin, mira_file_path, sam, output_path);
+  free_sam(sam);
 
   free(bed_file_path);
   free(mira_file_path);
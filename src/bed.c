@@ -19,14 +19,18 @@ int write_bed_file(char *filename, struct cluster_list *list) {
     fixed_start = (c->start > 0) ? c->start - 1 : 0;
     fixed_flank_start = (c->flank_start > 0) ? c->flank_start - 1 : 0;
     fprintf(fp, "%s\t%llu\t%llu\tCluster_%ld\t%d\t%c\t%llu\t%llu\t%d\t%llu\n",
-            c->chrom, fixed_flank_start, c->flank_end, i, 0, c->strand,
-            fixed_start, c->end, 0, c->readcount);
+            list->chromosomes->names[c->chrom_id], fixed_flank_start,
+            c->flank_end, i, 0, c->strand, fixed_start, c->end, 0,
+            c->readcount);
   }
   fclose(fp);
   return E_SUCCESS;
 }
 
-int read_bed_file(struct cluster_list **list, char *filename) {
+/* Chromosome names are added to the given dictionary, which is referenced by
+ * the resulting list. */
+int read_bed_file(struct cluster_list **list, char *filename,
+                  struct chromosome_dict *chromosomes) {
   static const int MAXLINELENGHT = 2048;
   static const int STARTINGSIZE = 1024;
   struct cluster_list *tmp_list = NULL;
@@ -34,6 +38,7 @@ int read_bed_file(struct cluster_list **list, char *filename) {
   if (err) {
     return err;
   }
+  tmp_list->chromosomes = chromosomes;
   FILE *fp = fopen(filename, "r");
   if (fp == NULL) {
     free(tmp_list->clusters);
@@ -44,7 +49,7 @@ int read_bed_file(struct cluster_list **list, char *filename) {
 
   struct cluster *c = NULL;
   while (fgets(line, sizeof(line), fp) != NULL) {
-    err = parse_bed_line(&c, line);
+    err = parse_bed_line(&c, line, chromosomes);
     if (err) {
       free(tmp_list->clusters);
       free(tmp_list);
@@ -71,7 +76,8 @@ int read_bed_file(struct cluster_list **list, char *filename) {
   return E_SUCCESS;
 }
 
-int parse_bed_line(struct cluster **result, char *line) {
+int parse_bed_line(struct cluster **result, char *line,
+                   struct chromosome_dict *chromosomes) {
   const char seperator = '\t';
   const int num_entries = 10;
 
@@ -121,7 +127,14 @@ int parse_bed_line(struct cluster **result, char *line) {
   }
 
   char *check = NULL;
-  c->chrom = tokens[0];
+  u32 chrom_id;
+  if (add_chromosome_to_dict(chromosomes, tokens[0], strlen(tokens[0]), 0,
+                             &chrom_id) != E_SUCCESS) {
+    goto line_invalid;
+  }
+  c->chrom_id = chrom_id;
+  free(tokens[0]);
+  tokens[0] = NULL;
   c->flank_start = strtol(tokens[1], &check, 10);
   if (check == tokens[1] || *check != 0) {
     goto line_invalid;
@@ -6,7 +6,9 @@
 #include "cluster.h"
 
 int write_bed_file(char *filename, struct cluster_list *list);
-int read_bed_file(struct cluster_list **list, char *filename);
-int parse_bed_line(struct cluster **result, char *line);
+int read_bed_file(struct cluster_list **list, char *filename,
+                  struct chromosome_dict *chromosomes);
+int parse_bed_line(struct cluster **result, char *line,
+                   struct chromosome_dict *chromosomes);
 
 #endif
\ No newline at end of file
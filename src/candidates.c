@@ -13,6 +13,7 @@ int create_empty_candidate_list(struct candidate_list **cand_list) {
   }
   tmp_list->capacity = INITIAL_CAPACITY;
   tmp_list->n = 0;
+  tmp_list->chromosomes = NULL;
   tmp_list->candidates = (struct micro_rna_candidate **)malloc(
       tmp_list->capacity * sizeof(struct micro_rna_candidate *));
   if (tmp_list->candidates == NULL) {
@@ -44,6 +45,7 @@ int convert_seq_list_to_cand_list(struct candidate_list **cand_list,
                                   struct sequence_list *seq_list) {
   struct candidate_list *tmp_cand_list = NULL;
   create_empty_candidate_list(&tmp_cand_list);
+  tmp_cand_list->chromosomes = seq_list->chromosomes;
   struct foldable_sequence *fs = NULL;
   struct micro_rna_candidate *cand = NULL;
   for (size_t i = 0; i < seq_list->n; i++) {
@@ -97,16 +99,6 @@ int create_micro_rna_candidate(struct micro_rna_candidate **cand,
   memcpy(structure_copy, si->structure_string, si->n);
   structure_copy[si->n] = 0;
 
-  size_t tmp_n = strlen(c->chrom);
-  char *chrom_copy = (char *)malloc((tmp_n + 1) * sizeof(char));
-  if (chrom_copy == NULL) {
-    free(structure_sequence);
-    free(structure_copy);
-    return E_MALLOC_FAIL;
-  }
-  memcpy(chrom_copy, c->chrom, tmp_n);
-  chrom_copy[tmp_n] = 0;
-
   struct micro_rna_candidate *cand_tmp =
       (struct micro_rna_candidate *)malloc(sizeof(struct micro_rna_candidate));
   if (cand_tmp == NULL) {
@@ -115,7 +107,7 @@ int create_micro_rna_candidate(struct micro_rna_candidate **cand,
     return E_MALLOC_FAIL;
   }
   cand_tmp->id = c->id;
-  cand_tmp->chrom = chrom_copy;
+  cand_tmp->chrom_id = c->chrom_id;
   cand_tmp->strand = c->strand;
   cand_tmp->start = structure_start;
   cand_tmp->end = structure_end;
@@ -125,6 +117,7 @@ int create_micro_rna_candidate(struct micro_rna_candidate **cand,
   cand_tmp->pvalue = si->pvalue;
   cand_tmp->mean = si->mean;
   cand_tmp->sd = si->sd;
+  cand_tmp->permutation_count = si->permutation_count;
   cand_tmp->external_loop_count = si->external_loop_count;
   cand_tmp->paired_fraction = si->paired_fraction;
   cand_tmp->stem_start = si->stem_start;
@@ -146,7 +139,7 @@ int write_candidate_file(struct candidate_list *cand_list, char *filename) {
   struct micro_rna_candidate *cand = NULL;
   for (size_t i = 0; i < cand_list->n; i++) {
     cand = cand_list->candidates[i];
-    write_candidate_line(fp, cand);
+    write_candidate_line(fp, cand, cand_list->chromosomes);
   }
   if (fp != NULL) {
     fclose(fp);
@@ -154,14 +147,15 @@ int write_candidate_file(struct candidate_list *cand_list, char *filename) {
   return E_SUCCESS;
 }
 
-int write_candidate_line(FILE *fp, struct micro_rna_candidate *cand) {
+int write_candidate_line(FILE *fp, struct micro_rna_candidate *cand,
+                         struct chromosome_dict *chromosomes) {
   if (fp == NULL) {
     fp = stdout;
   }
   fprintf(fp, "Cluster_%lld_%s\t", cand->id,
           (cand->strand == '-') ? "minus" : "plus");
   fprintf(fp, "%lld\t", cand->id);
-  fprintf(fp, "%s\t", cand->chrom);
+  fprintf(fp, "%s\t", chromosomes->names[cand->chrom_id]);
   fprintf(fp, "%c\t", cand->strand);
   fprintf(fp, "%lld\t", cand->start);
   fprintf(fp, "%lld\t", cand->end);
@@ -177,17 +171,22 @@ int write_candidate_line(FILE *fp, struct micro_rna_candidate *cand) {
   fprintf(fp, "%d\t", cand->stem_start);
   fprintf(fp, "%d\t", cand->stem_end);
   fprintf(fp, "%d\t", cand->stem_start_with_mismatch);
-  fprintf(fp, "%d\n", cand->stem_end_with_mismatch);
+  fprintf(fp, "%d\t", cand->stem_end_with_mismatch);
+  fprintf(fp, "%d\n", cand->permutation_count);
 
   return E_SUCCESS;
 }
-int read_candidate_file(struct candidate_list **cand_list, char *filename) {
+/* Chromosomes of the candidates are looked up in the given dictionary, which
+ * is referenced by the resulting list. */
+int read_candidate_file(struct candidate_list **cand_list, char *filename,
+                        struct chromosome_dict *chromosomes) {
   static const int MAXLINELENGHT = 4096;
   struct candidate_list *tmp_list = NULL;
   int err = create_empty_candidate_list(&tmp_list);
   if (err) {
     return err;
   }
+  tmp_list->chromosomes = chromosomes;
   FILE *fp = fopen(filename, "r");
   if (fp == NULL) {
     free_candidate_list(tmp_list);
@@ -196,7 +195,7 @@ int read_candidate_file(struct candidate_list **cand_list, char *filename) {
   char line[MAXLINELENGHT];
   struct micro_rna_candidate *cand = NULL;
   while (fgets(line, sizeof(line), fp) != NULL) {
-    err = parse_candidate_line(&cand, line);
+    err = parse_candidate_line(&cand, line, chromosomes);
     if (err) {
       free_candidate_list(tmp_list);
       return err;
@@ -209,16 +208,19 @@ int read_candidate_file(struct candidate_list **cand_list, char *filename) {
   return E_SUCCESS;
 }
 
-int parse_candidate_line(struct micro_rna_candidate **cand, char *line) {
+int parse_candidate_line(struct micro_rna_candidate **cand, char *line,
+                         struct chromosome_dict *chromosomes) {
   const char seperator = '\t';
-  const int num_entries = 18;
+  const int num_entries = 19;
+  /* files of earlier versions lack the permutation_count column */
+  const int min_entries = 18;
 
   struct micro_rna_candidate *tmp_cand =
       (struct micro_rna_candidate *)malloc(sizeof(struct micro_rna_candidate));
   if (tmp_cand == NULL) {
     return E_MALLOC_FAIL;
   }
-  char **tokens = (char **)malloc(num_entries * sizeof(char *));
+  char **tokens = (char **)calloc(num_entries, sizeof(char *));
   if (tokens == NULL) {
     free(tmp_cand);
     return E_MALLOC_FAIL;
@@ -250,11 +252,12 @@ int parse_candidate_line(struct micro_rna_candidate **cand, char *line) {
     current_token++;
     start = end + 1;
   }
-  if (current_token < num_entries) {
+  if (current_token < min_entries) {
     for (int i = 0; i < current_token; i++) {
       free(tokens[i]);
     }
     free(tokens);
+    free(tmp_cand);
     return E_INVALID_CANDIDATE_LINE;
   }
   char *check = NULL;
@@ -267,7 +270,19 @@ int parse_candidate_line(struct micro_rna_candidate **cand, char *line) {
   free(tokens[1]);
   tokens[1] = NULL;
 
-  tmp_cand->chrom = tokens[2];
+  u32 chrom_id;
+  if (find_chromosome_id(chromosomes, tokens[2], strlen(tokens[2]),
+                         &chrom_id) != E_SUCCESS) {
+    for (int i = 0; i < num_entries; i++) {
+      free(tokens[i]);
+    }
+    free(tokens);
+    free(tmp_cand);
+    return E_CHROMOSOME_NOT_FOUND;
+  }
+  tmp_cand->chrom_id = chrom_id;
+  free(tokens[2]);
+  tokens[2] = NULL;
   tmp_cand->strand = *tokens[3];
   free(tokens[3]);
   tokens[3] = NULL;
@@ -349,6 +364,16 @@ int parse_candidate_line(struct micro_rna_candidate **cand, char *line) {
   }
   free(tokens[17]);
   tokens[17] = NULL;
+  /* 0 when the number of folded permutations is unknown */
+  tmp_cand->permutation_count = 0;
+  if (current_token > min_entries) {
+    tmp_cand->permutation_count = strtol(tokens[18], &check, 10);
+    if (check == tokens[18] || *check != 0) {
+      goto line_invalid;
+    }
+    free(tokens[18]);
+    tokens[18] = NULL;
+  }
   free(tokens);
 
   *cand = tmp_cand;
@@ -360,6 +385,7 @@ line_invalid:
     }
   }
   free(tokens);
+  free(tmp_cand);
   return E_INVALID_CANDIDATE_LINE;
 }
 
@@ -373,7 +399,6 @@ int free_candidate_list(struct candidate_list *cand_list) {
 }
 
 int free_micro_rna_candidate(struct micro_rna_candidate *cand) {
-  free(cand->chrom);
   free(cand->sequence);
   free(cand->structure);
   free(cand);
@@ -6,10 +6,11 @@
 #include <stddef.h>
 #include "defs.h"
 #include "vfold.h"
+#include "chromosomes.h"
 
 struct micro_rna_candidate {
   u64 id;
-  char *chrom;
+  u32 chrom_id;
   char strand;
   u64 start;
   u64 end;
@@ -19,6 +20,7 @@ struct micro_rna_candidate {
   double pvalue;
   double mean;
   double sd;
+  int permutation_count;
 
   int external_loop_count;
   double paired_fraction;
@@ -32,6 +34,7 @@ struct candidate_list {
   struct micro_rna_candidate **candidates;
   size_t n;
   size_t capacity;
+  struct chromosome_dict *chromosomes;
 };
 int create_empty_candidate_list(struct candidate_list **cand_list);
 int add_candidate_to_list(struct candidate_list *cand_list,
@@ -41,9 +44,12 @@ int convert_seq_list_to_cand_list(struct candidate_list **cand_list,
 int create_micro_rna_candidate(struct micro_rna_candidate **cand,
                                struct foldable_sequence *fs);
 int write_candidate_file(struct candidate_list *cand_list, char *filename);
-int write_candidate_line(FILE *fp, struct micro_rna_candidate *cand);
-int read_candidate_file(struct candidate_list **cand_list, char *filename);
-int parse_candidate_line(struct micro_rna_candidate **cand, char *line);
+int write_candidate_line(FILE *fp, struct micro_rna_candidate *cand,
+                         struct chromosome_dict *chromosomes);
+int read_candidate_file(struct candidate_list **cand_list, char *filename,
+                        struct chromosome_dict *chromosomes);
+int parse_candidate_line(struct micro_rna_candidate **cand, char *line,
+                         struct chromosome_dict *chromosomes);
 int free_candidate_list(struct candidate_list *cand_list);
 int free_micro_rna_candidate(struct micro_rna_candidate *cand);
 
@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <string.h>
+#include "chromosomes.h"
+#include "errors.h"
+
+static int compare_names(const void *a, const void *b);
+
+int create_chromosome_dict(struct chromosome_dict **dict) {
+  const int INITIAL_CAPACITY = 64;
+  struct chromosome_dict *tmp =
+      (struct chromosome_dict *)malloc(sizeof(struct chromosome_dict));
+  if (tmp == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  tmp->n = 0;
+  tmp->capacity = INITIAL_CAPACITY;
+  tmp->index = NULL;
+  tmp->names = (char **)malloc(tmp->capacity * sizeof(char *));
+  tmp->lengths = (long *)malloc(tmp->capacity * sizeof(long));
+  if (tmp->names == NULL || tmp->lengths == NULL) {
+    free(tmp->names);
+    free(tmp->lengths);
+    free(tmp);
+    return E_MALLOC_FAIL;
+  }
+  *dict = tmp;
+  return E_SUCCESS;
+}
+
+/* Returns the id of the name, the chromosome is added if it is not known yet.
+ * The name does not need to be null terminated. */
+int add_chromosome_to_dict(struct chromosome_dict *dict, const char *name,
+                           size_t n, long length, u32 *id) {
+  struct chromosome_index *entry = NULL;
+  HASH_FIND(hh, dict->index, name, n, entry);
+  if (entry != NULL) {
+    *id = entry->id;
+    return E_SUCCESS;
+  }
+  if (dict->n == dict->capacity) {
+    size_t capacity = dict->capacity * 2;
+    char **names = (char **)realloc(dict->names, capacity * sizeof(char *));
+    if (names == NULL) {
+      return E_REALLOC_FAIL;
+    }
+    dict->names = names;
+    long *lengths = (long *)realloc(dict->lengths, capacity * sizeof(long));
+    if (lengths == NULL) {
+      return E_REALLOC_FAIL;
+    }
+    dict->lengths = lengths;
+    dict->capacity = capacity;
+  }
+  char *name_copy = (char *)malloc((n + 1) * sizeof(char));
+  if (name_copy == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  memcpy(name_copy, name, n);
+  name_copy[n] = 0;
+  entry =
+      (struct chromosome_index *)malloc(sizeof(struct chromosome_index));
+  if (entry == NULL) {
+    free(name_copy);
+    return E_MALLOC_FAIL;
+  }
+  entry->name = name_copy;
+  entry->id = dict->n;
+  HASH_ADD_KEYPTR(hh, dict->index, entry->name, n, entry);
+  dict->names[dict->n] = name_copy;
+  dict->lengths[dict->n] = length;
+  dict->n++;
+  *id = entry->id;
+  return E_SUCCESS;
+}
+
+int find_chromosome_id(struct chromosome_dict *dict, const char *name,
+                       size_t n, u32 *id) {
+  struct chromosome_index *entry = NULL;
+  HASH_FIND(hh, dict->index, name, n, entry);
+  if (entry == NULL) {
+    return E_CHROMOSOME_NOT_FOUND;
+  }
+  *id = entry->id;
+  return E_SUCCESS;
+}
+
+/* Renumbers the chromosomes in lexical order of their names, so ids compare
+ * like the names do. Ids handed out before are invalid afterwards. */
+int sort_chromosome_dict(struct chromosome_dict *dict) {
+  long *lengths = (long *)malloc(dict->capacity * sizeof(long));
+  if (lengths == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  qsort(dict->names, dict->n, sizeof(char *), compare_names);
+  struct chromosome_index *entry = NULL;
+  for (size_t i = 0; i < dict->n; i++) {
+    HASH_FIND_STR(dict->index, dict->names[i], entry);
+    lengths[i] = dict->lengths[entry->id];
+  }
+  for (size_t i = 0; i < dict->n; i++) {
+    HASH_FIND_STR(dict->index, dict->names[i], entry);
+    entry->id = i;
+  }
+  free(dict->lengths);
+  dict->lengths = lengths;
+  return E_SUCCESS;
+}
+
+int free_chromosome_dict(struct chromosome_dict *dict) {
+  struct chromosome_index *entry = NULL;
+  struct chromosome_index *tmp = NULL;
+  HASH_ITER(hh, dict->index, entry, tmp) {
+    HASH_DEL(dict->index, entry);
+    free(entry);
+  }
+  for (size_t i = 0; i < dict->n; i++) {
+    free(dict->names[i]);
+  }
+  free(dict->names);
+  free(dict->lengths);
+  free(dict);
+  return E_SUCCESS;
+}
+
+static int compare_names(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
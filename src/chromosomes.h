@@ -0,0 +1,33 @@
+
+#ifndef CHROMOSOMES_H
+#define CHROMOSOMES_H
+
+#include <stddef.h>
+#include "defs.h"
+#include "uthash.h"
+
+struct chromosome_index {
+  const char *name;
+  u32 id;
+  UT_hash_handle hh;
+};
+
+/* Interned chromosome names. Everything downstream of the input files refers
+ * to a chromosome by its id, which indexes names and lengths. */
+struct chromosome_dict {
+  size_t n;
+  size_t capacity;
+  char **names;
+  long *lengths;
+  struct chromosome_index *index;
+};
+
+int create_chromosome_dict(struct chromosome_dict **dict);
+int add_chromosome_to_dict(struct chromosome_dict *dict, const char *name,
+                           size_t n, long length, u32 *id);
+int find_chromosome_id(struct chromosome_dict *dict, const char *name,
+                       size_t n, u32 *id);
+int sort_chromosome_dict(struct chromosome_dict *dict);
+int free_chromosome_dict(struct chromosome_dict *dict);
+
+#endif
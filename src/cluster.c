@@ -11,6 +11,8 @@
 #include "util.h"
 
 static int print_help();
+static int process_clusters(struct configuration_params *config,
+                            struct cluster_list *list, char *output_file);
 
 int cluster(int argc, char **argv) {
   int c;
@@ -71,18 +73,44 @@ static int print_help() {
 int cluster_main(struct configuration_params *config, char *sam_file,
                  char *output_file, char *selected_crom) {
   struct cluster_list *list = NULL;
-  struct chrom_info *chromosome_table = NULL;
+  struct chromosome_dict *chromosomes = NULL;
   log_basic_timestamp(config->log_level, "Clustering reads...\n");
 
   int err;
 
   log_verbose_timestamp(config->log_level, "\tReading SAM file...\n");
-  err =
-      parse_clusters(config, &chromosome_table, &list, sam_file, selected_crom);
+  err = parse_clusters(config, &chromosomes, &list, sam_file, selected_crom);
   if (err != E_SUCCESS) {
     print_error(err);
     return err;
   }
+  err = process_clusters(config, list, output_file);
+  free_chromosome_dict(chromosomes);
+  return err;
+}
+
+int cluster_sam_main(struct configuration_params *config, struct sam_file *sam,
+                     char *output_file) {
+  struct cluster_list *list = NULL;
+  log_basic_timestamp(config->log_level, "Clustering reads...\n");
+
+  int err;
+
+  log_verbose_timestamp(config->log_level,
+                        "\tCreating clusters from SAM entries...\n");
+  err = clusters_from_sam(&list, sam);
+  if (err != E_SUCCESS) {
+    print_error(err);
+    return err;
+  }
+  return process_clusters(config, list, output_file);
+}
+
+/* Runs the clustering pipeline on single read clusters and writes the result,
+ * frees the list in any case. */
+static int process_clusters(struct configuration_params *config,
+                            struct cluster_list *list, char *output_file) {
+  int err;
   log_verbose_timestamp(config->log_level,
                         "\tRead SAM file successfully. %ld entries\n", list->n);
 
@@ -114,7 +142,7 @@ int cluster_main(struct configuration_params *config, char *sam_file,
   log_verbose_timestamp(config->log_level,
                         "\tMerging done. %ld clusters left\n", list->n);
   log_verbose_timestamp(config->log_level, "\tExtending clusters...\n");
-  err = extend_clusters(list, &chromosome_table, config->cluster_flank_size);
+  err = extend_clusters(list, config->cluster_flank_size);
   if (err != E_SUCCESS) {
     goto error_clusters;
   }
@@ -145,7 +173,6 @@ int cluster_main(struct configuration_params *config, char *sam_file,
   }
   log_verbose_timestamp(config->log_level, "\tWriting bed file done.\n");
 
-  free_chromosome_table(&chromosome_table);
   free_clusters(list);
   log_basic_timestamp(config->log_level,
                       "Clustering completed successfully.\n");
@@ -155,79 +182,93 @@ int cluster_main(struct configuration_params *config, char *sam_file,
 error_clusters:
   print_error(err);
   free_clusters(list);
-  free_chromosome_table(&chromosome_table);
   return err;
 }
 
 int parse_clusters(struct configuration_params *config,
-                   struct chrom_info **table, struct cluster_list **list,
-                   char *file, char *selected_crom) {
-  static const int MAXLINELENGHT = 2048;
+                   struct chromosome_dict **chromosomes,
+                   struct cluster_list **list, char *file,
+                   char *selected_crom) {
   static const int STARTINGSIZE = 1024;
   struct cluster_list *tmp_list = NULL;
+  struct chromosome_dict *dict = NULL;
   int err = create_clusters(&tmp_list, STARTINGSIZE);
   if (err != E_SUCCESS) {
     return err;
   }
+  err = create_chromosome_dict(&dict);
+  if (err != E_SUCCESS) {
+    free_clusters(tmp_list);
+    return err;
+  }
+  tmp_list->chromosomes = dict;
 
-  FILE *fp = fopen(file, "r");
-  if (fp == NULL) {
-    free(tmp_list->clusters);
-    free(tmp_list);
-    return E_FILE_NOT_FOUND;
+  struct sam_reader *reader = NULL;
+  err = open_sam_reader(&reader, file);
+  if (err != E_SUCCESS) {
+    free_clusters(tmp_list);
+    free_chromosome_dict(dict);
+    return err;
   }
-  char line[MAXLINELENGHT];
-  struct sam_entry *tmp_entry = NULL;
+  struct sam_field line;
+  struct sam_view view;
   struct sq_header *tmp_header = NULL;
-  struct chrom_info *info = NULL;
   struct cluster *c = NULL;
   size_t ignored = 0;
-  size_t line_num = 0;
-  while (fgets(line, sizeof(line), fp) != NULL) {
-    line_num++;
-    int result = parse_line(&tmp_entry, line);
+  int headers_done = 0;
+  u32 chrom_id = 0;
+  struct sam_field last_rname = {NULL, 0};
+  while (next_sam_line(reader, &line)) {
+    int result = parse_sam_view(&view, line.data, line.n);
     if (result == E_SAM_HEADER_LINE) {
-      int err = parse_header(&tmp_header, line);
+      int err = parse_sq_header(&tmp_header, line.data, line.n);
       if (err != E_SUCCESS) {
         log_verbose_timestamp(config->log_level, "\tLine %ld ignored.\n",
-                              line_num);
+                              reader->line_num);
         ignored += 1;
         continue;
       }
-      info = (struct chrom_info *)malloc(sizeof(struct chrom_info));
-      if (info == NULL) {
-        free_sam_header(tmp_header);
-        continue;
-      }
-      strncpy(info->name, tmp_header->sn, 1024);
-      info->length = tmp_header->ln;
-      HASH_ADD_STR(*table, name, info);
+      add_chromosome_to_dict(dict, tmp_header->sn, strlen(tmp_header->sn),
+                             tmp_header->ln, &chrom_id);
       free_sam_header(tmp_header);
       continue;
     }
     if (result != E_SUCCESS) {
       log_verbose_timestamp(config->log_level, "\tLine %ld ignored.\n",
-                            line_num);
+                            reader->line_num);
       ignored += 1;
       continue;
     }
+    if (!headers_done) {
+      /* ids in name order keep the cluster order of the name comparison */
+      err = sort_chromosome_dict(dict);
+      if (err != E_SUCCESS) {
+        goto error;
+      }
+      headers_done = 1;
+    }
+    struct sam_field *rname = &view.fields[SAM_RNAME];
     if (selected_crom != NULL) {
-      if (strcmp(tmp_entry->rname, selected_crom) != 0) {
-        free_sam_entry(tmp_entry);
+      if (!sam_field_equals(rname, selected_crom)) {
         continue;
       }
     }
+    if (last_rname.data == NULL || rname->n != last_rname.n ||
+        memcmp(rname->data, last_rname.data, rname->n) != 0) {
+      err = find_chromosome_id(dict, rname->data, rname->n, &chrom_id);
+      if (err != E_SUCCESS) {
+        goto error;
+      }
+      last_rname = *rname;
+    }
 
     if (tmp_list->n == tmp_list->capacity) {
       tmp_list->capacity *= 2;
       struct cluster **tmp = (struct cluster **)realloc(
           tmp_list->clusters, tmp_list->capacity * sizeof(struct cluster *));
       if (tmp == NULL) {
-        free_sam_entry(tmp_entry);
-        free(tmp_list->clusters);
-        free(tmp_list);
-        fclose(fp);
-        return E_MALLOC_FAIL;
+        err = E_MALLOC_FAIL;
+        goto error;
       }
       tmp_list->clusters = tmp;
     }
@@ -235,21 +276,48 @@ int parse_clusters(struct configuration_params *config,
     if (c == NULL) {
       continue;
     }
-    sam_to_cluster(c, tmp_entry, tmp_list->n);
-    free_sam_entry(tmp_entry);
+    sam_to_cluster(c, &view, chrom_id, tmp_list->n);
     tmp_list->clusters[tmp_list->n] = c;
     tmp_list->n++;
   }
-  fclose(fp);
+  close_sam_reader(reader);
   if (ignored > 0) {
     log_basic_timestamp(
         config->log_level,
         "%ld lines of the SAM file were ignored because they were invalid \n",
         ignored);
   }
+  *chromosomes = dict;
   *list = tmp_list;
 
   return E_SUCCESS;
+
+error:
+  free_clusters(tmp_list);
+  free_chromosome_dict(dict);
+  close_sam_reader(reader);
+  return err;
+}
+
+int clusters_from_sam(struct cluster_list **list, struct sam_file *sam) {
+  struct cluster_list *tmp_list = NULL;
+  int err = create_clusters(&tmp_list, sam->n > 0 ? sam->n : 1);
+  if (err != E_SUCCESS) {
+    return err;
+  }
+  tmp_list->chromosomes = sam->chromosomes;
+  struct cluster *c = NULL;
+  for (size_t i = 0; i < sam->n; i++) {
+    c = (struct cluster *)malloc(sizeof(struct cluster));
+    if (c == NULL) {
+      continue;
+    }
+    sam_read_to_cluster(c, sam, i, tmp_list->n);
+    tmp_list->clusters[tmp_list->n] = c;
+    tmp_list->n++;
+  }
+  *list = tmp_list;
+  return E_SUCCESS;
 }
 
 int create_clusters(struct cluster_list **list, size_t n) {
@@ -266,6 +334,7 @@ int create_clusters(struct cluster_list **list, size_t n) {
     return E_MALLOC_FAIL;
   }
   tmp_list->n = 0;
+  tmp_list->chromosomes = NULL;
   *list = tmp_list;
   return E_SUCCESS;
 }
@@ -283,7 +352,7 @@ int compare_strand_chrom_start(const void *c1, const void *c2) {
   diff = cl1->strand - cl2->strand;
   if (diff != 0)
     return diff;
-  diff = strcmp(cl1->chrom, cl2->chrom);
+  diff = (int)cl1->chrom_id - (int)cl2->chrom_id;
   if (diff != 0)
     return diff;
   diff = cl1->start - cl2->start;
@@ -293,7 +362,7 @@ int compare_chrom_flank(const void *c1, const void *c2) {
   struct cluster *cl1 = *(struct cluster **)c1;
   struct cluster *cl2 = *(struct cluster **)c2;
   int diff;
-  diff = strcmp(cl1->chrom, cl2->chrom);
+  diff = (int)cl1->chrom_id - (int)cl2->chrom_id;
   if (diff != 0)
     return diff;
   diff = cl1->flank_start - cl2->flank_start;
@@ -306,7 +375,7 @@ int compare_strand_chrom_flank(const void *c1, const void *c2) {
   diff = cl1->strand - cl2->strand;
   if (diff != 0)
     return diff;
-  diff = strcmp(cl1->chrom, cl2->chrom);
+  diff = (int)cl1->chrom_id - (int)cl2->chrom_id;
   if (diff != 0)
     return diff;
   diff = cl1->flank_start - cl2->flank_start;
@@ -327,7 +396,7 @@ int merge_clusters(struct cluster_list *list, int max_gap) {
   struct cluster **top = new_clusters;
   for (size_t i = 1; i < list->n; i++) {
     struct cluster *c = list->clusters[i];
-    if (c->strand != (*top)->strand || strcmp(c->chrom, (*top)->chrom) != 0 ||
+    if (c->strand != (*top)->strand || c->chrom_id != (*top)->chrom_id ||
         c->start > (*top)->end + max_gap) {
       top++;
       *top = c;
@@ -389,24 +458,23 @@ int filter_clusters(struct cluster_list *list, int minreads) {
   return E_SUCCESS;
 }
 
-int extend_clusters(struct cluster_list *list, struct chrom_info **table,
-                    int window) {
+int extend_clusters(struct cluster_list *list, int window) {
   struct cluster *c;
-  struct chrom_info *info;
+  long length;
   int start;
   int end;
 
   for (size_t i = 0; i < list->n; i++) {
     c = list->clusters[i];
-    HASH_FIND_STR(*table, c->chrom, info);
-    if (info == NULL) {
+    if (c->chrom_id >= list->chromosomes->n) {
       return E_CHROMOSOME_NOT_FOUND;
     }
+    length = list->chromosomes->lengths[c->chrom_id];
     start = c->start - window;
     end = c->end + window;
 
     c->flank_start = (start > 0) ? start : 0;
-    c->flank_end = (end < info->length) ? end : info->length;
+    c->flank_end = (end < length) ? end : length;
   }
   return E_SUCCESS;
 }
@@ -424,7 +492,7 @@ int merge_extended_clusters(struct cluster_list *list, int max_length) {
   int total_readcount = (*top)->readcount;
   for (size_t i = 1; i < list->n; i++) {
     struct cluster *c = list->clusters[i];
-    if (c->strand != (*top)->strand || strcmp(c->chrom, (*top)->chrom) != 0 ||
+    if (c->strand != (*top)->strand || c->chrom_id != (*top)->chrom_id ||
         c->flank_start > (*top)->flank_end ||
         c->flank_end - (*top)->flank_start > max_length) {
       (*top)->readcount = total_readcount;
@@ -496,37 +564,41 @@ int filter_extended_clusters(struct cluster_list *list, int max_length) {
   return E_SUCCESS;
 }
 
-int sam_to_cluster(struct cluster *cluster, struct sam_entry *entry, long id) {
+int sam_to_cluster(struct cluster *cluster, struct sam_view *view,
+                   u32 chrom_id, long id) {
   const char POSITIVE_STRAND_SYMBOL = '+';
   const char NEGATIVE_STRAND_SYMBOL = '-';
 
   cluster->id = id;
-  if (entry->flag & REV_COMPLM) {
+  if (view->flag & REV_COMPLM) {
     cluster->strand = NEGATIVE_STRAND_SYMBOL;
   } else {
     cluster->strand = POSITIVE_STRAND_SYMBOL;
   }
-  int n = strlen(entry->rname) + 1;
-  cluster->chrom = (char *)malloc(n * sizeof(char));
-  if (cluster->chrom == NULL)
-    return E_MALLOC_FAIL;
-  strcpy(cluster->chrom, entry->rname);
-
-  cluster->start = entry->pos;
-  cluster->end = entry->pos + strlen(entry->seq);
+  cluster->chrom_id = chrom_id;
+  cluster->start = view->pos;
+  cluster->end = view->pos + view->fields[SAM_SEQ].n;
   cluster->readcount = 1;
 
   return E_SUCCESS;
 }
 
-int free_chromosome_table(struct chrom_info **table) {
-  struct chrom_info *info = NULL;
-  struct chrom_info *tmp = NULL;
+int sam_read_to_cluster(struct cluster *cluster, struct sam_file *sam,
+                        size_t read, long id) {
+  const char POSITIVE_STRAND_SYMBOL = '+';
+  const char NEGATIVE_STRAND_SYMBOL = '-';
 
-  HASH_ITER(hh, *table, info, tmp) {
-    HASH_DEL(*table, info);
-    free(info);
+  cluster->id = id;
+  if (sam->is_reverse[read]) {
+    cluster->strand = NEGATIVE_STRAND_SYMBOL;
+  } else {
+    cluster->strand = POSITIVE_STRAND_SYMBOL;
   }
+  cluster->chrom_id = sam->chrom_ids[read];
+  cluster->start = sam->starts[read] + 1;
+  cluster->end = cluster->start + sam->lengths[read];
+  cluster->readcount = 1;
+
   return E_SUCCESS;
 }
 
@@ -539,7 +611,6 @@ int free_clusters(struct cluster_list *list) {
   return E_SUCCESS;
 }
 int free_cluster(struct cluster *c) {
-  free(c->chrom);
   free(c);
   return E_SUCCESS;
 }
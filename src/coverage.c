@@ -14,7 +14,12 @@
 #include "structure_evaluation.h"
 #include "mirna_validation.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 static int print_help();
+static u64 coverage_before(struct coverage_track *track, u64 pos);
 
 int coverage(int argc, char **argv) {
   char *config_file = NULL;
@@ -69,10 +74,31 @@ int coverage_main(struct configuration_params *config, char *executable_file,
                   char *selected_crom) {
   int err;
   struct sam_file *sam = NULL;
+  log_verbose_timestamp(config->log_level, "\tParsing sam file...\n");
+  err = parse_sam(&sam, sam_file, selected_crom);
+  if (err) {
+    print_error(err);
+    return err;
+  }
+  err = coverage_sam_main(config, executable_file, mira_file, sam,
+                          output_path);
+  log_verbose_timestamp(config->log_level, "\tFreeing Sam file...\n");
+  free_sam(sam);
+  return err;
+}
+
+int coverage_sam_main(struct configuration_params *config,
+                      char *executable_file, char *mira_file,
+                      struct sam_file *sam, char *output_path) {
+  int err;
   struct candidate_list *c_list = NULL;
   struct extended_candidate_list *ec_list = NULL;
-  struct chrom_coverage *cov_table = NULL;
+  struct coverage_table *cov_table = NULL;
+  struct read_index *index = NULL;
   log_basic_timestamp(config->log_level, "Coverage based verification...\n");
+#ifdef _OPENMP
+  omp_set_num_threads(config->openmp_thread_count);
+#endif
 
   for (size_t i = strlen(executable_file); i > 0; i--) {
     if (executable_file[i] == '/') {
@@ -81,17 +107,17 @@ int coverage_main(struct configuration_params *config, char *executable_file,
     }
   }
   log_verbose_timestamp(config->log_level, "\tReading candidate file...\n");
-  err = read_candidate_file(&c_list, mira_file);
+  err = read_candidate_file(&c_list, mira_file, sam->chromosomes);
   if (err) {
     goto error;
   }
-  log_verbose_timestamp(config->log_level, "\tParsing sam file...\n");
-  err = parse_sam(&sam, sam_file, selected_crom);
+  log_verbose_timestamp(config->log_level, "\tIndexing reads...\n");
+  err = create_read_index(&index, sam);
   if (err) {
     goto error;
   }
   log_verbose_timestamp(config->log_level, "\tCreating coverage table...\n");
-  err = create_coverage_table(&cov_table, sam);
+  err = create_coverage_table(&cov_table, sam, index);
   if (err) {
     goto error;
   }
@@ -103,24 +129,22 @@ int coverage_main(struct configuration_params *config, char *executable_file,
   }
   log_verbose_timestamp(config->log_level,
                         "\tCoverage testing candidates...\n");
-  err = coverage_test_candidates(ec_list, &cov_table, sam, config);
+  err = coverage_test_candidates(ec_list, cov_table, sam, index, config);
   if (err) {
     goto error;
   }
-  log_verbose_timestamp(config->log_level, "\tFreeing Sam file...\n");
-
-  free_sam(sam);
   log_verbose_timestamp(config->log_level, "\tAll OK\n");
   log_basic_timestamp(config->log_level,
                       "Coverage based verification completed\n");
   log_basic_timestamp(config->log_level, "Generating reports...\n");
-  err = report_valid_candiates(ec_list, &cov_table, executable_file,
+  err = report_valid_candiates(ec_list, cov_table, executable_file,
                                output_path, config);
   if (err) {
     goto error;
   }
   log_basic_timestamp(config->log_level, "Generating reports completed\n");
-  free_coverage_table(&cov_table);
+  free_read_index(index);
+  free_coverage_table(cov_table);
   free_extended_candidate_list(ec_list);
   return E_SUCCESS;
 
@@ -129,10 +153,10 @@ error:
     free_extended_candidate_list(ec_list);
   }
   if (cov_table != NULL) {
-    free_coverage_table(&cov_table);
+    free_coverage_table(cov_table);
   }
-  if (sam != NULL) {
-    free_sam(sam);
+  if (index != NULL) {
+    free_read_index(index);
   }
   if (c_list != NULL) {
     free_candidate_list(c_list);
@@ -141,66 +165,85 @@ error:
   return err;
 }
 
-int create_coverage_table(struct chrom_coverage **table, struct sam_file *sam) {
+/* The tracks are built from the start and end events of the reads, one
+ * thread per chromosome strand (read index bucket). */
+int create_coverage_table(struct coverage_table **table, struct sam_file *sam,
+                          struct read_index *index) {
+  struct chromosome_dict *chromosomes = sam->chromosomes;
+  struct coverage_table *tmp_table =
+      (struct coverage_table *)malloc(sizeof(struct coverage_table));
+  if (tmp_table == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  tmp_table->n = chromosomes->n;
+  tmp_table->coverages = (struct chrom_coverage *)calloc(
+      chromosomes->n > 0 ? chromosomes->n : 1, sizeof(struct chrom_coverage));
+  if (tmp_table->coverages == NULL) {
+    free(tmp_table);
+    return E_MALLOC_FAIL;
+  }
   struct chrom_coverage *chrom_cov = NULL;
-  struct sq_header *header = NULL;
-  struct sam_entry *entry = NULL;
-  for (size_t i = 0; i < sam->header_n; i++) {
-    header = sam->headers[i];
-    chrom_cov = (struct chrom_coverage *)malloc(sizeof(struct chrom_coverage));
-    strncpy(chrom_cov->name, header->sn, 1024);
-    chrom_cov->name[1023] = 0;
-    chrom_cov->length = header->ln;
-    chrom_cov->coverage_plus = (u32 *)malloc(chrom_cov->length * sizeof(u32));
-    chrom_cov->coverage_minus = (u32 *)malloc(chrom_cov->length * sizeof(u32));
-    for (u32 i = 0; i < chrom_cov->length; i++) {
-      chrom_cov->coverage_plus[i] = 0;
-      chrom_cov->coverage_minus[i] = 0;
+  for (size_t i = 0; i < chromosomes->n; i++) {
+    chrom_cov = tmp_table->coverages + i;
+    chrom_cov->name = chromosomes->names[i];
+    chrom_cov->length = chromosomes->lengths[i];
+    if (create_coverage_track(&chrom_cov->coverage_plus, chrom_cov->length) ||
+        create_coverage_track(&chrom_cov->coverage_minus, chrom_cov->length)) {
+      free_coverage_table(tmp_table);
+      return E_MALLOC_FAIL;
     }
-    HASH_ADD_STR(*table, name, chrom_cov);
-  }
-  u32 start;
-  u32 stop;
-  for (size_t i = 0; i < sam->n; i++) {
-    entry = sam->entries[i];
-    if (strcmp(chrom_cov->name, entry->rname) != 0) {
-      HASH_FIND_STR(*table, entry->rname, chrom_cov);
+  }
+  int err = E_SUCCESS;
+#pragma omp parallel for schedule(dynamic)
+  for (size_t b = 0; b < index->bucket_n; b++) {
+    struct chrom_coverage *cov = tmp_table->coverages + b / 2;
+    struct coverage_track *track =
+        (b % 2 == 0) ? cov->coverage_plus : cov->coverage_minus;
+    int track_err = E_SUCCESS;
+    for (size_t k = index->bucket_offsets[b];
+         k < index->bucket_offsets[b + 1] && track_err == E_SUCCESS; k++) {
+      struct indexed_read *entry = index->entries + k;
+      track_err = add_coverage_event(track, entry->start,
+                                     entry->start + sam->lengths[entry->read]);
     }
-    if (chrom_cov == NULL) {
-      return E_CHROMOSOME_NOT_FOUND;
+    if (track_err == E_SUCCESS) {
+      track_err = finish_coverage_track(track);
     }
-
-    start = entry->pos - 1;
-    stop = start + strlen(entry->seq);
-    u32 *cov_list = chrom_cov->coverage_plus;
-    if (entry->flag & REV_COMPLM) {
-      cov_list = chrom_cov->coverage_minus;
-    }
-
-    for (u32 i = start; i < stop; i++) {
-      cov_list[i]++;
+    if (track_err != E_SUCCESS) {
+#pragma omp critical
+      err = track_err;
     }
   }
+  if (err != E_SUCCESS) {
+    free_coverage_table(tmp_table);
+    return err;
+  }
+  *table = tmp_table;
 
   return E_SUCCESS;
 }
 int coverage_test_candidates(struct extended_candidate_list *cand_list,
-                             struct chrom_coverage **coverage_table,
-                             struct sam_file *sam,
+                             struct coverage_table *coverage_table,
+                             struct sam_file *sam, struct read_index *index,
                              struct configuration_params *config) {
   struct extended_candidate *ecand = NULL;
   struct micro_rna_candidate *cand = NULL;
   struct chrom_coverage *chrom_cov = NULL;
 
   int err = 0;
+  int chromosome_missing = 0;
+  /* candidates only share read-only data (coverage table, reads, config) */
+#pragma omp parallel for private(ecand, cand, chrom_cov, err) schedule(dynamic)
   for (size_t i = 0; i < cand_list->n; i++) {
     ecand = cand_list->candidates[i];
     ecand->is_valid = 0;
     cand = ecand->cand;
-    HASH_FIND_STR(*coverage_table, cand->chrom, chrom_cov);
-    if (chrom_cov == NULL) {
-      return E_CHROMOSOME_NOT_FOUND;
+    if (cand->chrom_id >= coverage_table->n) {
+#pragma omp critical
+      chromosome_missing = 1;
+      continue;
     }
+    chrom_cov = coverage_table->coverages + cand->chrom_id;
 
     err = find_mature_micro_rnas(ecand, chrom_cov, config);
     if (err != E_SUCCESS) {
@@ -214,12 +257,15 @@ int coverage_test_candidates(struct extended_candidate_list *cand_list,
       continue;
     }
 
-    err = count_unique_reads(ecand, sam);
+    err = count_unique_reads(ecand, sam, index);
     if (err != E_SUCCESS) {
       continue;
     }
     ecand->is_valid = 1;
   }
+  if (chromosome_missing) {
+    return E_CHROMOSOME_NOT_FOUND;
+  }
 
   return E_SUCCESS;
 }
@@ -227,10 +273,10 @@ int coverage_test_candidates(struct extended_candidate_list *cand_list,
 int find_mature_micro_rnas(struct extended_candidate *ecand,
                            struct chrom_coverage *chrom_cov,
                            struct configuration_params *config) {
-  u32 *cov_list = chrom_cov->coverage_plus;
+  struct coverage_track *cov_track = chrom_cov->coverage_plus;
   struct micro_rna_candidate *cand = ecand->cand;
   if (cand->strand == '-') {
-    cov_list = chrom_cov->coverage_minus;
+    cov_track = chrom_cov->coverage_minus;
   }
 
   size_t n = cand->end - cand->start;
@@ -241,21 +287,24 @@ int find_mature_micro_rnas(struct extended_candidate *ecand,
 
   struct candidate_subsequence *mature_micro_rna = NULL;
 
-  get_coverage_in_range(&total_coverage, cov_list, cand->start, cand->end);
+  get_coverage_in_range(&total_coverage, cov_track, cand->start, cand->end);
   int err = 0;
 
   err = create_candidate_subseqence_list(&(ecand->possible_micro_rnas));
   u64 *pos_cov_spikes = (u64 *)malloc(n * sizeof(u64));
   u64 *neg_cov_spikes = (u64 *)malloc(n * sizeof(u64));
-  if (pos_cov_spikes == NULL || neg_cov_spikes == NULL || err) {
+  u32 *cov_list = (u32 *)malloc(n * sizeof(u32));
+  if (pos_cov_spikes == NULL || neg_cov_spikes == NULL || cov_list == NULL ||
+      err) {
     err = E_MALLOC_FAIL;
     goto error;
   }
+  /* dense copy of the candidate region for the spike scan */
+  get_coverage_window(cov_list, cov_track, cand->start, cand->end);
 
   for (size_t i = 0; i < (n - 1); i++) {
-    u64 global_index = cand->start + i;
-    u32 cov_local = cov_list[global_index];
-    u32 cov_next = cov_list[global_index + 1];
+    u32 cov_local = cov_list[i];
+    u32 cov_next = cov_list[i + 1];
     if (cov_next > cov_local) {
       pos_cov_spikes[pos_spike_count] = i;
       pos_spike_count++;
@@ -287,7 +336,7 @@ int find_mature_micro_rnas(struct extended_candidate *ecand,
         continue;
       }
       u64 segment_coverage = 0;
-      get_coverage_in_range(&segment_coverage, cov_list, cand->start + start,
+      get_coverage_in_range(&segment_coverage, cov_track, cand->start + start,
                             cand->start + end);
       err = create_candidate_subseqence(&mature_micro_rna, start, end,
                                         segment_coverage, paired_fraction);
@@ -303,6 +352,7 @@ int find_mature_micro_rnas(struct extended_candidate *ecand,
   }
   free(pos_cov_spikes);
   free(neg_cov_spikes);
+  free(cov_list);
   pos_cov_spikes = NULL;
   neg_cov_spikes = NULL;
   return E_SUCCESS;
@@ -314,17 +364,156 @@ error:
     free(pos_cov_spikes);
   }
   if (neg_cov_spikes != NULL) {
-    free(pos_cov_spikes);
+    free(neg_cov_spikes);
+  }
+  if (cov_list != NULL) {
+    free(cov_list);
   }
   return err;
 }
 
-int get_coverage_in_range(u64 *result, u32 *cov_list, u64 start, u64 end) {
-  u64 total_coverage = 0;
-  for (size_t i = start; i < end; i++) {
-    total_coverage += cov_list[i];
+int create_coverage_track(struct coverage_track **track, u64 length) {
+  struct coverage_track *tmp =
+      (struct coverage_track *)malloc(sizeof(struct coverage_track));
+  if (tmp == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  tmp->length = length;
+  tmp->chunk_n = (length + COVERAGE_CHUNK_SIZE - 1) / COVERAGE_CHUNK_SIZE;
+  size_t n = tmp->chunk_n > 0 ? tmp->chunk_n : 1;
+  tmp->chunks = (u32 **)calloc(n, sizeof(u32 *));
+  tmp->prefix_chunks = (u64 **)calloc(n, sizeof(u64 *));
+  tmp->chunk_offsets = (u64 *)calloc(tmp->chunk_n + 1, sizeof(u64));
+  if (tmp->chunks == NULL || tmp->prefix_chunks == NULL ||
+      tmp->chunk_offsets == NULL) {
+    free(tmp->chunks);
+    free(tmp->prefix_chunks);
+    free(tmp->chunk_offsets);
+    free(tmp);
+    return E_MALLOC_FAIL;
+  }
+  *track = tmp;
+  return E_SUCCESS;
+}
+
+/* Records a read covering [start, end) in the difference array, positions
+ * past the end of the chromosome are ignored. The track is only readable
+ * after finish_coverage_track. */
+int add_coverage_event(struct coverage_track *track, u64 start, u64 end) {
+  if (end > track->length) {
+    end = track->length;
+  }
+  if (start >= end) {
+    return E_SUCCESS;
+  }
+  /* every chunk with nonzero coverage has to exist for the prefix pass */
+  size_t last = (end < track->length ? end : end - 1) / COVERAGE_CHUNK_SIZE;
+  for (size_t c = start / COVERAGE_CHUNK_SIZE; c <= last; c++) {
+    if (track->chunks[c] == NULL) {
+      track->chunks[c] = (u32 *)calloc(COVERAGE_CHUNK_SIZE, sizeof(u32));
+      if (track->chunks[c] == NULL) {
+        return E_MALLOC_FAIL;
+      }
+    }
+  }
+  /* unsigned wrap around, the prefix pass restores the counts */
+  track->chunks[start / COVERAGE_CHUNK_SIZE][start % COVERAGE_CHUNK_SIZE]++;
+  if (end < track->length) {
+    track->chunks[end / COVERAGE_CHUNK_SIZE][end % COVERAGE_CHUNK_SIZE]--;
+  }
+  return E_SUCCESS;
+}
+
+/* Turns the difference array into per base coverage and builds the prefix
+ * sums: prefix_chunks[c][k] is the coverage of chunk c before offset k,
+ * chunk_offsets[c] the coverage of the chromosome before chunk c. */
+int finish_coverage_track(struct coverage_track *track) {
+  u32 running = 0;
+  u64 total = 0;
+  for (size_t c = 0; c < track->chunk_n; c++) {
+    track->chunk_offsets[c] = total;
+    u32 *chunk = track->chunks[c];
+    if (chunk == NULL) {
+      continue;
+    }
+    u64 *prefix = (u64 *)malloc((COVERAGE_CHUNK_SIZE + 1) * sizeof(u64));
+    if (prefix == NULL) {
+      return E_MALLOC_FAIL;
+    }
+    u64 sum = 0;
+    for (size_t k = 0; k < COVERAGE_CHUNK_SIZE; k++) {
+      running += chunk[k];
+      chunk[k] = running;
+      prefix[k] = sum;
+      sum += running;
+    }
+    prefix[COVERAGE_CHUNK_SIZE] = sum;
+    track->prefix_chunks[c] = prefix;
+    total += sum;
+  }
+  track->chunk_offsets[track->chunk_n] = total;
+  return E_SUCCESS;
+}
+
+/* Coverage of [0, pos). */
+static u64 coverage_before(struct coverage_track *track, u64 pos) {
+  if (pos >= track->length) {
+    return track->chunk_offsets[track->chunk_n];
+  }
+  size_t c = pos / COVERAGE_CHUNK_SIZE;
+  u64 sum = track->chunk_offsets[c];
+  if (track->prefix_chunks[c] != NULL) {
+    sum += track->prefix_chunks[c][pos % COVERAGE_CHUNK_SIZE];
+  }
+  return sum;
+}
+
+int get_coverage_in_range(u64 *result, struct coverage_track *track, u64 start,
+                          u64 end) {
+  if (start >= end) {
+    *result = 0;
+    return E_SUCCESS;
   }
-  *result = total_coverage;
+  *result = coverage_before(track, end) - coverage_before(track, start);
+  return E_SUCCESS;
+}
+
+/* Writes the coverage of [start, end) to window, which has to hold
+ * end - start values. */
+int get_coverage_window(u32 *window, struct coverage_track *track, u64 start,
+                        u64 end) {
+  u64 offset = start;
+  while (start < end) {
+    size_t c = start / COVERAGE_CHUNK_SIZE;
+    u64 chunk_start = (u64)c * COVERAGE_CHUNK_SIZE;
+    u64 chunk_end = chunk_start + COVERAGE_CHUNK_SIZE;
+    if (chunk_end > end) {
+      chunk_end = end;
+    }
+    size_t bytes = (chunk_end - start) * sizeof(u32);
+    if (c >= track->chunk_n || track->chunks[c] == NULL) {
+      memset(window + (start - offset), 0, bytes);
+    } else {
+      memcpy(window + (start - offset),
+             track->chunks[c] + (start - chunk_start), bytes);
+    }
+    start = chunk_end;
+  }
+  return E_SUCCESS;
+}
+
+int free_coverage_track(struct coverage_track *track) {
+  if (track == NULL) {
+    return E_SUCCESS;
+  }
+  for (size_t i = 0; i < track->chunk_n; i++) {
+    free(track->chunks[i]);
+    free(track->prefix_chunks[i]);
+  }
+  free(track->chunks);
+  free(track->prefix_chunks);
+  free(track->chunk_offsets);
+  free(track);
   return E_SUCCESS;
 }
 int extend_all_candidates(struct extended_candidate_list **ecand_list,
@@ -471,15 +660,12 @@ int free_candidate_subsequence(struct candidate_subsequence *cs) {
   return E_SUCCESS;
 }
 
-int free_coverage_table(struct chrom_coverage **table) {
-  struct chrom_coverage *cov = NULL;
-  struct chrom_coverage *tmp = NULL;
-
-  HASH_ITER(hh, *table, cov, tmp) {
-    HASH_DEL(*table, cov);
-    free(cov->coverage_plus);
-    free(cov->coverage_minus);
-    free(cov);
+int free_coverage_table(struct coverage_table *table) {
+  for (size_t i = 0; i < table->n; i++) {
+    free_coverage_track(table->coverages[i].coverage_plus);
+    free_coverage_track(table->coverages[i].coverage_minus);
   }
+  free(table->coverages);
+  free(table);
   return E_SUCCESS;
 }
@@ -10,12 +10,34 @@
 #include "util.h"
 #include "reads.h"
 
+/* forward declaration of struct in reads.h */
+struct read_index;
+
+#define COVERAGE_CHUNK_SIZE 4096
+
+/* Per base coverage of one strand. The chromosome is split into chunks of
+ * COVERAGE_CHUNK_SIZE bases, a chunk is only allocated once a read covers it
+ * (NULL chunks have zero coverage). Prefix sums over the coverage answer
+ * range queries with two lookups. */
+struct coverage_track {
+  u64 length;
+  size_t chunk_n;
+  u32 **chunks;
+  u64 **prefix_chunks;
+  u64 *chunk_offsets;
+};
+
 struct chrom_coverage {
-  char name[1024];
+  const char *name;
   long length;
-  u32 *coverage_plus;
-  u32 *coverage_minus;
-  UT_hash_handle hh;
+  struct coverage_track *coverage_plus;
+  struct coverage_track *coverage_minus;
+};
+
+/* Coverage of every chromosome, indexed by chromosome id. */
+struct coverage_table {
+  size_t n;
+  struct chrom_coverage *coverages;
 };
 enum strand_arm { FIVE_PRIME = 5, THREE_PRIME = 3 };
 
@@ -57,15 +79,26 @@ int coverage(int argc, char **argv);
 int coverage_main(struct configuration_params *config, char *executable_file,
                   char *mira_file, char *sam_file, char *output_path,
                   char *selected_crom);
-int create_coverage_table(struct chrom_coverage **table, struct sam_file *sam);
+int coverage_sam_main(struct configuration_params *config,
+                      char *executable_file, char *mira_file,
+                      struct sam_file *sam, char *output_path);
+int create_coverage_table(struct coverage_table **table, struct sam_file *sam,
+                          struct read_index *index);
 int coverage_test_candidates(struct extended_candidate_list *ecand_list,
-                             struct chrom_coverage **coverage_table,
-                             struct sam_file *sam,
+                             struct coverage_table *coverage_table,
+                             struct sam_file *sam, struct read_index *index,
                              struct configuration_params *config);
 int find_mature_micro_rnas(struct extended_candidate *ecand,
                            struct chrom_coverage *chrom_cov,
                            struct configuration_params *config);
-int get_coverage_in_range(u64 *result, u32 *cov_list, u64 start, u64 end);
+int create_coverage_track(struct coverage_track **track, u64 length);
+int add_coverage_event(struct coverage_track *track, u64 start, u64 end);
+int finish_coverage_track(struct coverage_track *track);
+int get_coverage_in_range(u64 *result, struct coverage_track *track, u64 start,
+                          u64 end);
+int get_coverage_window(u32 *window, struct coverage_track *track, u64 start,
+                        u64 end);
+int free_coverage_track(struct coverage_track *track);
 int extend_all_candidates(struct extended_candidate_list **ecand_list,
                           struct candidate_list *cand_list);
 
@@ -84,5 +117,5 @@ int free_extended_candidate_list(struct extended_candidate_list *ecand_list);
 int free_extended_candidate(struct extended_candidate *ecand);
 
 int free_candidate_subsequence(struct candidate_subsequence *cs);
-int free_coverage_table(struct chrom_coverage **table);
+int free_coverage_table(struct coverage_table *table);
 #endif
\ No newline at end of file
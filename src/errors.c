@@ -24,6 +24,10 @@ struct _errordesc errordesc[] = {
     {E_MALLOC_FAIL, "malloc failed, check available memory"},
     {E_REALLOC_FAIL, "realloc failed, check available memory"},
     {E_NO_CLUSTERS_LEFT, "No clusters left to work with."},
+    {E_NULL_MODEL_NOT_FOUND, "No cached null model for the sequence"},
+    {E_FOLD_NOT_CACHED, "No cached fold for the sequence"},
+    {E_OUTSIDE_OF_MODEL_RANGE,
+     "The sequence is outside of the range of the regression model"},
     {E_UNKNOWN, "An unknown error occured"}};
 
 int print_error(int err) {
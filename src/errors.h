@@ -37,6 +37,9 @@ enum _error {
   E_STRUCTURE_MFE_TO_HIGH = -53,
   E_STRUCTURE_PVALUE_TO_HIGH = -54,
   E_NO_CLUSTERS_LEFT = -55,
+  E_OUTSIDE_OF_MODEL_RANGE = -56,
+  E_NULL_MODEL_NOT_FOUND = -57,
+  E_FOLD_NOT_CACHED = -58,
 
   E_MALLOC_FAIL = -30,
   E_REALLOC_FAIL = -31,
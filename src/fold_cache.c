@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "fold_cache.h"
+#include "errors.h"
+
+/* Changes whenever the way a cached fold is computed changes. */
+#define FOLD_CACHE_VERSION 2
+
+int create_fold_cache(struct fold_cache **cache) {
+  struct fold_cache *tmp =
+      (struct fold_cache *)malloc(sizeof(struct fold_cache));
+  if (tmp == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  tmp->folds = NULL;
+  tmp->n = 0;
+  tmp->is_modified = 0;
+  tmp->invalid_lines = 0;
+  *cache = tmp;
+  return E_SUCCESS;
+}
+
+/* A missing file is not an error, the cache is filled by the first run. Lines
+ * that are invalid or too long are skipped and counted, the cache only saves
+ * work. */
+int read_fold_cache(struct fold_cache *cache, char *file) {
+  const int MAXLINELENGTH = 16384;
+  char *line = (char *)malloc(MAXLINELENGTH * sizeof(char));
+  if (line == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  FILE *fp = fopen(file, "r");
+  if (fp == NULL) {
+    free(line);
+    return E_SUCCESS;
+  }
+  int err = E_SUCCESS;
+  while (fgets(line, MAXLINELENGTH, fp) != NULL) {
+    size_t length = strlen(line);
+    if (length == (size_t)MAXLINELENGTH - 1 && line[length - 1] != '\n') {
+      int c;
+      do {
+        c = fgetc(fp);
+      } while (c != EOF && c != '\n');
+      cache->invalid_lines++;
+      continue;
+    }
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    struct cached_fold fold;
+    int structure_offset = 0;
+    if (sscanf(line,
+               "%" SCNx64 "\t%" SCNx64 "\t%d\t%lf\t%d\t%lf\t%lf\t%lf\t%d\t%n",
+               &fold.key.sequence_hash, &fold.key.parameter_hash, &fold.start,
+               &fold.mfe, &fold.has_distribution, &fold.mean, &fold.sd,
+               &fold.pvalue, &fold.permutation_count,
+               &structure_offset) != 9 ||
+        structure_offset == 0) {
+      cache->invalid_lines++;
+      continue;
+    }
+    char *structure = line + structure_offset;
+    structure[strcspn(structure, "\r\n")] = 0;
+    fold.structure_string = (strcmp(structure, "*") == 0) ? NULL : structure;
+    err = add_cached_fold(cache, &fold);
+    if (err) {
+      break;
+    }
+  }
+  cache->is_modified = 0;
+  fclose(fp);
+  free(line);
+  return err;
+}
+
+/* The cache is written to a temporary file that replaces the old one when it
+ * is complete, so a failed write keeps the old cache. */
+int write_fold_cache(struct fold_cache *cache, char *file) {
+  size_t n = strlen(file);
+  char *tmp_file = (char *)malloc((n + 5) * sizeof(char));
+  if (tmp_file == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  memcpy(tmp_file, file, n);
+  memcpy(tmp_file + n, ".tmp", 5);
+  FILE *fp = fopen(tmp_file, "w");
+  if (fp == NULL) {
+    free(tmp_file);
+    return E_FILE_WRITING_FAILED;
+  }
+  fprintf(fp, "#sequence_hash\tparameter_hash\tstart\tmfe\thas_distribution"
+              "\tmean\tsd\tpvalue\tpermutation_count\tstructure\n");
+  struct cached_fold *fold = NULL;
+  struct cached_fold *tmp = NULL;
+  HASH_ITER(hh, cache->folds, fold, tmp) {
+    fprintf(fp, "%016" PRIx64 "\t%016" PRIx64 "\t%d\t%.17g\t%d\t%.17g\t%.17g"
+                "\t%.17g\t%d\t%s\n",
+            fold->key.sequence_hash, fold->key.parameter_hash, fold->start,
+            fold->mfe, fold->has_distribution, fold->mean, fold->sd,
+            fold->pvalue, fold->permutation_count,
+            (fold->structure_string == NULL) ? "*" : fold->structure_string);
+  }
+  int failed = ferror(fp);
+  failed |= fclose(fp) != 0;
+  if (failed || rename(tmp_file, file) != 0) {
+    remove(tmp_file);
+    free(tmp_file);
+    return E_FILE_WRITING_FAILED;
+  }
+  free(tmp_file);
+  cache->is_modified = 0;
+  return E_SUCCESS;
+}
+
+void get_fold_cache_key(struct fold_cache_key *key, const char *seq, size_t n,
+                        u64 core_start, u64 core_end,
+                        struct configuration_params *config) {
+  u64 hash = hash_bytes(HASH_OFFSET, seq, n);
+  hash = hash_int(hash, (i64)n);
+  hash = hash_int(hash, (i64)core_start);
+  key->sequence_hash = hash_int(hash, (i64)core_end);
+
+  hash = hash_int(HASH_OFFSET, FOLD_CACHE_VERSION);
+  hash = hash_int(hash, config->max_precursor_length);
+  hash = hash_int(hash, config->permutation_count);
+  hash = hash_int(hash, config->min_permutation_count);
+  hash = hash_double(hash, config->permutation_error);
+  hash = hash_double(hash, config->max_pvalue);
+  hash = hash_int(hash, config->pvalue_method);
+  hash = hash_int(hash, config->random_seed);
+  /* distributions of the null model cache are binned approximations */
+  hash = hash_int(hash, config->null_model_cache[0] != 0);
+  key->parameter_hash = hash_energy_model(hash);
+}
+
+int find_cached_fold(struct fold_cache *cache, struct fold_cache_key *key,
+                     struct cached_fold **fold) {
+  struct cached_fold *tmp = NULL;
+  HASH_FIND(hh, cache->folds, key, sizeof(struct fold_cache_key), tmp);
+  if (tmp == NULL) {
+    return E_FOLD_NOT_CACHED;
+  }
+  *fold = tmp;
+  return E_SUCCESS;
+}
+
+/* Copies the fold into the cache, an existing fold with the same key is
+ * replaced. */
+int add_cached_fold(struct fold_cache *cache, struct cached_fold *fold) {
+  char *structure = NULL;
+  if (fold->structure_string != NULL) {
+    size_t n = strlen(fold->structure_string);
+    structure = (char *)malloc((n + 1) * sizeof(char));
+    if (structure == NULL) {
+      return E_MALLOC_FAIL;
+    }
+    memcpy(structure, fold->structure_string, n + 1);
+  }
+  struct cached_fold *tmp = NULL;
+  HASH_FIND(hh, cache->folds, &fold->key, sizeof(struct fold_cache_key), tmp);
+  if (tmp == NULL) {
+    tmp = (struct cached_fold *)malloc(sizeof(struct cached_fold));
+    if (tmp == NULL) {
+      free(structure);
+      return E_MALLOC_FAIL;
+    }
+    tmp->key = fold->key;
+    tmp->structure_string = NULL;
+    HASH_ADD(hh, cache->folds, key, sizeof(struct fold_cache_key), tmp);
+    cache->n++;
+  }
+  free(tmp->structure_string);
+  tmp->structure_string = structure;
+  tmp->start = fold->start;
+  tmp->mfe = fold->mfe;
+  tmp->has_distribution = fold->has_distribution;
+  tmp->mean = fold->mean;
+  tmp->sd = fold->sd;
+  tmp->pvalue = fold->pvalue;
+  tmp->permutation_count = fold->permutation_count;
+  cache->is_modified = 1;
+  return E_SUCCESS;
+}
+
+int free_fold_cache(struct fold_cache *cache) {
+  struct cached_fold *fold = NULL;
+  struct cached_fold *tmp = NULL;
+  HASH_ITER(hh, cache->folds, fold, tmp) {
+    HASH_DEL(cache->folds, fold);
+    free(fold->structure_string);
+    free(fold);
+  }
+  free(cache);
+  return E_SUCCESS;
+}
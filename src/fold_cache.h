@@ -0,0 +1,52 @@
+
+#ifndef FOLD_CACHE_H
+#define FOLD_CACHE_H
+
+#include <stddef.h>
+#include "defs.h"
+#include "util.h"
+#include "uthash.h"
+
+/* Identifies the folding of a flanked sequence: the hash of the sequence and
+ * the position of the core region, and the hash of everything the folding
+ * depends on (configuration and energy model). */
+struct fold_cache_key {
+  u64 sequence_hash;
+  u64 parameter_hash;
+};
+
+/* The optimal structure and its mfe distribution. A structure_string of NULL
+ * means no structure contains the core region, the distribution is only valid
+ * if has_distribution is set. */
+struct cached_fold {
+  struct fold_cache_key key;
+  char *structure_string;
+  int start;
+  double mfe;
+  int has_distribution;
+  double mean;
+  double sd;
+  double pvalue;
+  int permutation_count;
+  UT_hash_handle hh;
+};
+
+struct fold_cache {
+  struct cached_fold *folds;
+  size_t n;
+  int is_modified;
+  size_t invalid_lines; /* skipped when the file was read */
+};
+
+int create_fold_cache(struct fold_cache **cache);
+int read_fold_cache(struct fold_cache *cache, char *file);
+int write_fold_cache(struct fold_cache *cache, char *file);
+void get_fold_cache_key(struct fold_cache_key *key, const char *seq, size_t n,
+                        u64 core_start, u64 core_end,
+                        struct configuration_params *config);
+int find_cached_fold(struct fold_cache *cache, struct fold_cache_key *key,
+                     struct cached_fold **fold);
+int add_cached_fold(struct fold_cache *cache, struct cached_fold *fold);
+int free_fold_cache(struct fold_cache *cache);
+
+#endif
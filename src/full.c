@@ -57,12 +57,21 @@ int full(int argc, char **argv) {
     return err;
   }
 
+  struct sam_file *sam = NULL;
+  log_basic_timestamp(config->log_level, "Reading SAM file...\n");
+  err = parse_sam(&sam, sam_file, NULL);
+  if (err) {
+    print_error(err);
+    return err;
+  }
+
   char bed_filename[] = "cluster_contigs.bed";
   char *bed_file_path = NULL;
   create_file_path(&bed_file_path, output_path, bed_filename);
-  err = cluster_main(config, sam_file, bed_file_path, NULL);
+  err = cluster_sam_main(config, sam, bed_file_path);
   if (err) {
     free(bed_file_path);
+    free_sam(sam);
     return err;
   }
   char mira_filename[] = "fold_candidates.miRA";
@@ -72,11 +81,12 @@ int full(int argc, char **argv) {
   if (err) {
     free(bed_file_path);
     free(mira_file_path);
+    free_sam(sam);
     return err;
   }
 
-  err = coverage_main(config, argv[-1], mira_file_path, sam_file, output_path,
-                      NULL);
+  err = coverage_sam_main(config, argv[-1], mira_file_path, sam, output_path);
+  free_sam(sam);
   free(bed_file_path);
   free(mira_file_path);
   if (err) {
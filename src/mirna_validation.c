@@ -240,13 +240,13 @@ int find_star_micro_rna(struct candidate_subsequence **result,
     return E_NO_STAR_MI_RNA_FOUND;
   }
 
-  u32 *cov_list = chrom_cov->coverage_plus;
+  struct coverage_track *cov_track = chrom_cov->coverage_plus;
   if (cand->strand == '-') {
-    cov_list = chrom_cov->coverage_minus;
+    cov_track = chrom_cov->coverage_minus;
   }
 
   u64 coverage = 0;
-  get_coverage_in_range(&coverage, cov_list, star_start + cand->start,
+  get_coverage_in_range(&coverage, cov_track, star_start + cand->start,
                         star_end + cand->start);
 
   struct candidate_subsequence *star_micro_rna = NULL;
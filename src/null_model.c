@@ -0,0 +1,244 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <inttypes.h>
+#include "null_model.h"
+#include "errors.h"
+
+/* Changes whenever the way a null model is computed changes. */
+#define NULL_MODEL_VERSION 1
+
+static void get_null_model_key(struct null_model_key *key, const char *seq,
+                               size_t n);
+static int merge_null_model(struct null_model **models,
+                            struct null_model_key *key, int count,
+                            double mean, double sd, int *is_new);
+
+int create_null_model_cache(struct null_model_cache **cache,
+                            struct configuration_params *config) {
+  struct null_model_cache *tmp =
+      (struct null_model_cache *)malloc(sizeof(struct null_model_cache));
+  if (tmp == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  tmp->models = NULL;
+  tmp->added = NULL;
+  tmp->n = 0;
+  tmp->invalid_lines = 0;
+  /* the permutations are folded with the span limit */
+  u64 hash = hash_int(HASH_OFFSET, NULL_MODEL_VERSION);
+  hash = hash_int(hash, config->max_precursor_length);
+  tmp->parameter_hash = hash_energy_model(hash);
+  *cache = tmp;
+  return E_SUCCESS;
+}
+
+/* A missing file is not an error, the cache is filled by the first run. The
+ * models of a file without the parameter hash of the cache are not read.
+ * Lines that are invalid or too long are skipped and counted, the cache only
+ * saves work. */
+int read_null_model_cache(struct null_model_cache *cache, char *file) {
+  const int MAXLINELENGTH = 1024;
+  char line[MAXLINELENGTH];
+  FILE *fp = fopen(file, "r");
+  if (fp == NULL) {
+    return E_SUCCESS;
+  }
+  u64 file_hash = 0;
+  if (fgets(line, sizeof(line), fp) == NULL ||
+      sscanf(line, "#parameter_hash\t%" SCNx64, &file_hash) != 1 ||
+      file_hash != cache->parameter_hash) {
+    fclose(fp);
+    return E_SUCCESS;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    size_t length = strlen(line);
+    if (length == (size_t)MAXLINELENGTH - 1 && line[length - 1] != '\n') {
+      int c;
+      do {
+        c = fgetc(fp);
+      } while (c != EOF && c != '\n');
+      cache->invalid_lines++;
+      continue;
+    }
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    struct null_model_key key;
+    int count;
+    double mean, sd;
+    int is_new;
+    /* the key is hashed as raw memory */
+    memset(&key, 0, sizeof(struct null_model_key));
+    if (sscanf(line, "%d\t%d\t%d\t%d\t%d\t%lf\t%lf", &key.length_bin,
+               &key.gc_bin, &key.a_bin, &key.c_bin, &count, &mean,
+               &sd) != 7) {
+      cache->invalid_lines++;
+      continue;
+    }
+    if (merge_null_model(&cache->models, &key, count, mean, sd, &is_new)) {
+      fclose(fp);
+      return E_MALLOC_FAIL;
+    }
+    cache->n += is_new;
+  }
+  fclose(fp);
+  return E_SUCCESS;
+}
+
+/* The models added during the run are merged into the ones read first. The
+ * cache is written to a temporary file that replaces the old one when it is
+ * complete, so a failed write keeps the old cache. */
+int write_null_model_cache(struct null_model_cache *cache, char *file) {
+  struct null_model *model = NULL;
+  struct null_model *tmp = NULL;
+  HASH_ITER(hh, cache->added, model, tmp) {
+    int is_new;
+    if (merge_null_model(&cache->models, &model->key, model->count,
+                         model->mean, model->sd, &is_new)) {
+      return E_MALLOC_FAIL;
+    }
+    cache->n += is_new;
+    HASH_DEL(cache->added, model);
+    free(model);
+  }
+  size_t n = strlen(file);
+  char *tmp_file = (char *)malloc((n + 5) * sizeof(char));
+  if (tmp_file == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  memcpy(tmp_file, file, n);
+  memcpy(tmp_file + n, ".tmp", 5);
+  FILE *fp = fopen(tmp_file, "w");
+  if (fp == NULL) {
+    free(tmp_file);
+    return E_FILE_WRITING_FAILED;
+  }
+  fprintf(fp, "#parameter_hash\t%016" PRIx64 "\n", cache->parameter_hash);
+  fprintf(fp, "#length_bin\tgc_bin\ta_bin\tc_bin\tcount\tmean\tsd\n");
+  HASH_ITER(hh, cache->models, model, tmp) {
+    fprintf(fp, "%d\t%d\t%d\t%d\t%d\t%.17g\t%.17g\n", model->key.length_bin,
+            model->key.gc_bin, model->key.a_bin, model->key.c_bin,
+            model->count, model->mean, model->sd);
+  }
+  int failed = ferror(fp);
+  failed |= fclose(fp) != 0;
+  if (failed || rename(tmp_file, file) != 0) {
+    remove(tmp_file);
+    free(tmp_file);
+    return E_FILE_WRITING_FAILED;
+  }
+  free(tmp_file);
+  return E_SUCCESS;
+}
+
+/* Looks up the null model of a sequence among the models read from the file,
+ * models built from less than min_count permutations are not used. */
+int find_null_model(struct null_model_cache *cache, const char *seq, size_t n,
+                    int min_count, double *mean, double *sd) {
+  struct null_model_key key;
+  get_null_model_key(&key, seq, n);
+  struct null_model *model = NULL;
+  HASH_FIND(hh, cache->models, &key, sizeof(struct null_model_key), model);
+  if (model == NULL || model->count < min_count) {
+    return E_NULL_MODEL_NOT_FOUND;
+  }
+  *mean = model->mean;
+  *sd = model->sd;
+  return E_SUCCESS;
+}
+
+/* Stores the null model of a sequence until the cache is written, it is not
+ * looked up before. */
+int add_null_model(struct null_model_cache *cache, const char *seq, size_t n,
+                   int count, double mean, double sd) {
+  struct null_model_key key;
+  int is_new;
+  get_null_model_key(&key, seq, n);
+  return merge_null_model(&cache->added, &key, count, mean, sd, &is_new);
+}
+
+int free_null_model_cache(struct null_model_cache *cache) {
+  struct null_model *model = NULL;
+  struct null_model *tmp = NULL;
+  HASH_ITER(hh, cache->models, model, tmp) {
+    HASH_DEL(cache->models, model);
+    free(model);
+  }
+  HASH_ITER(hh, cache->added, model, tmp) {
+    HASH_DEL(cache->added, model);
+    free(model);
+  }
+  free(cache);
+  return E_SUCCESS;
+}
+
+static void get_null_model_key(struct null_model_key *key, const char *seq,
+                               size_t n) {
+  size_t counts[4] = {0, 0, 0, 0}; /* A, C, G, U */
+  for (size_t i = 0; i < n; i++) {
+    switch (toupper(seq[i])) {
+    case 'A':
+      counts[0]++;
+      break;
+    case 'C':
+      counts[1]++;
+      break;
+    case 'G':
+      counts[2]++;
+      break;
+    case 'T':
+    case 'U':
+      counts[3]++;
+      break;
+    }
+  }
+  size_t at = counts[0] + counts[3];
+  size_t gc = counts[1] + counts[2];
+  /* the key is hashed as raw memory */
+  memset(key, 0, sizeof(struct null_model_key));
+  key->length_bin = (i32)floor(log((double)n) / log1p(NULL_MODEL_LENGTH_BIN));
+  key->gc_bin = (at + gc == 0)
+                    ? -1
+                    : (i32)floor((double)gc / (at + gc) / NULL_MODEL_GC_BIN);
+  key->a_bin = (at == 0) ? -1
+                         : (i32)floor((double)counts[0] / at /
+                                      NULL_MODEL_RATIO_BIN);
+  key->c_bin = (gc == 0) ? -1
+                         : (i32)floor((double)counts[1] / gc /
+                                      NULL_MODEL_RATIO_BIN);
+}
+
+/* An existing model is only replaced by one built from more permutations.
+ * Models of as many permutations are ordered by their values, so the result
+ * does not depend on the order they are merged in. */
+static int merge_null_model(struct null_model **models,
+                            struct null_model_key *key, int count,
+                            double mean, double sd, int *is_new) {
+  struct null_model *model = NULL;
+  *is_new = 0;
+  HASH_FIND(hh, *models, key, sizeof(struct null_model_key), model);
+  if (model == NULL) {
+    model = (struct null_model *)malloc(sizeof(struct null_model));
+    if (model == NULL) {
+      return E_MALLOC_FAIL;
+    }
+    model->key = *key;
+    model->count = count;
+    model->mean = mean;
+    model->sd = sd;
+    HASH_ADD(hh, *models, key, sizeof(struct null_model_key), model);
+    *is_new = 1;
+    return E_SUCCESS;
+  }
+  if (count > model->count ||
+      (count == model->count &&
+       (mean < model->mean || (mean == model->mean && sd < model->sd)))) {
+    model->count = count;
+    model->mean = mean;
+    model->sd = sd;
+  }
+  return E_SUCCESS;
+}
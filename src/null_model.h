@@ -0,0 +1,56 @@
+
+#ifndef NULL_MODEL_H
+#define NULL_MODEL_H
+
+#include <stddef.h>
+#include "defs.h"
+#include "util.h"
+#include "uthash.h"
+
+/* Width of the bins the null models are stored in. Sequences of similar
+ * length and nucleotide composition share the mfe distribution of their
+ * permutations. */
+#define NULL_MODEL_LENGTH_BIN 0.05 /* relative */
+#define NULL_MODEL_GC_BIN 0.02
+#define NULL_MODEL_RATIO_BIN 0.05
+
+struct null_model_key {
+  i32 length_bin;
+  i32 gc_bin;
+  i32 a_bin; /* A / (A + U) */
+  i32 c_bin; /* C / (C + G) */
+};
+
+/* Mean and standard deviation of the mfe per nt of count permutations */
+struct null_model {
+  struct null_model_key key;
+  int count;
+  double mean;
+  double sd;
+  UT_hash_handle hh;
+};
+
+/* The models only hold for the parameters they were folded with, a file
+ * written with other parameters (parameter_hash) is ignored. Only the models
+ * read from the file are looked up, the ones added during a run are merged
+ * into them when the cache is written. So whether a sequence gets a cached
+ * model does not depend on the order the sequences are folded in. */
+struct null_model_cache {
+  struct null_model *models;
+  struct null_model *added;
+  size_t n;
+  u64 parameter_hash;
+  size_t invalid_lines;
+};
+
+int create_null_model_cache(struct null_model_cache **cache,
+                            struct configuration_params *config);
+int read_null_model_cache(struct null_model_cache *cache, char *file);
+int write_null_model_cache(struct null_model_cache *cache, char *file);
+int find_null_model(struct null_model_cache *cache, const char *seq, size_t n,
+                    int min_count, double *mean, double *sd);
+int add_null_model(struct null_model_cache *cache, const char *seq, size_t n,
+                   int count, double mean, double sd);
+int free_null_model_cache(struct null_model_cache *cache);
+
+#endif
@@ -2,318 +2,529 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "parse_sam.h"
 #include "errors.h"
+static int parse_sam_integer(const struct sam_field *field, long *value);
+static char *sam_field_dup(const struct sam_field *field);
+static int create_sam_file(struct sam_file **sam, size_t capacity);
+static int add_sam_header(struct sam_file *data, struct sq_header *header);
+static int read_sam_to_end(struct sam_reader *r, int fd);
+static int append_sam_read(struct sam_file *data, u32 chrom_id,
+                           struct sam_view *view);
 
 int parse_sam(struct sam_file **sam, char *file, char *selected_crom) {
-  static const int MAXLINELENGHT = 2048;
   static const int STARTINGSIZE = 1024;
-  struct sam_file *data = (struct sam_file *)malloc(sizeof(struct sam_file));
-  if (data == NULL) {
-    return E_MALLOC_FAIL;
+  struct sam_file *data = NULL;
+  int err = create_sam_file(&data, STARTINGSIZE);
+  if (err != E_SUCCESS) {
+    return err;
   }
-  data->capacity = STARTINGSIZE;
-  data->entries =
-      (struct sam_entry **)malloc(data->capacity * sizeof(struct sam_entry *));
-  if (data->entries == NULL) {
-    free(data);
-    return E_MALLOC_FAIL;
-  }
-  data->n = 0;
 
-  data->header_cap = STARTINGSIZE;
-  data->headers = (struct sq_header **)malloc(data->header_cap *
-                                              sizeof(struct sq_header *));
-  if (data->headers == NULL) {
-    free(data->entries);
-    free(data);
-    return E_MALLOC_FAIL;
+  struct sam_reader *reader = NULL;
+  err = open_sam_reader(&reader, file);
+  if (err != E_SUCCESS) {
+    free_sam(data);
+    return err;
   }
-  data->header_n = 0;
-
-  FILE *fp = fopen(file, "r");
-  if (fp == NULL) {
-    free(data->entries);
-    free(data->headers);
-    free(data);
-    return E_FILE_NOT_FOUND;
-  }
-  struct sam_entry *tmp_entry = NULL;
-  char line[MAXLINELENGHT];
-  while (fgets(line, sizeof(line), fp) != NULL) {
-    int result = parse_line(&tmp_entry, line);
+  struct sam_field line;
+  struct sam_view view;
+  struct sq_header *tmp_header = NULL;
+  int headers_done = 0;
+  u32 chrom_id = 0;
+  struct sam_field last_rname = {NULL, 0};
+  while (next_sam_line(reader, &line)) {
+    int result = parse_sam_view(&view, line.data, line.n);
     if (result == E_SAM_HEADER_LINE) {
-      int err = parse_header(data->headers + data->header_n, line);
-      if (err != E_SUCCESS)
+      if (parse_sq_header(&tmp_header, line.data, line.n) != E_SUCCESS)
         continue;
-      data->header_n++;
-      if (data->header_n == data->header_cap) {
-        data->header_cap *= 2;
-        struct sq_header **tmph = (struct sq_header **)realloc(
-            data->headers, data->header_cap * sizeof(struct sq_header *));
-        if (tmph == NULL) {
-          free_sam(data);
-          fclose(fp);
-          return E_REALLOC_FAIL;
-        }
-        data->headers = tmph;
+      err = add_sam_header(data, tmp_header);
+      free_sam_header(tmp_header);
+      if (err != E_SUCCESS) {
+        goto error;
       }
       continue;
     }
     if (result != E_SUCCESS)
       continue;
+    if (!headers_done) {
+      err = sort_chromosome_dict(data->chromosomes);
+      if (err != E_SUCCESS) {
+        goto error;
+      }
+      headers_done = 1;
+    }
+    struct sam_field *rname = &view.fields[SAM_RNAME];
     if (selected_crom != NULL) {
-      if (strcmp(tmp_entry->rname, selected_crom) != 0) {
-        free_sam_entry(tmp_entry);
+      if (!sam_field_equals(rname, selected_crom)) {
         continue;
       }
     }
-    *(data->entries + data->n) = tmp_entry;
-
-    data->n++;
-    if (data->n == data->capacity) {
-      data->capacity *= 2;
-      struct sam_entry **tmp = (struct sam_entry **)realloc(
-          data->entries, data->capacity * sizeof(struct sam_entry *));
-      if (tmp == NULL) {
-        free_sam(data);
-        fclose(fp);
-        return E_REALLOC_FAIL;
+    /* reads are usually grouped by chromosome, only look up on changes */
+    if (last_rname.data == NULL || rname->n != last_rname.n ||
+        memcmp(rname->data, last_rname.data, rname->n) != 0) {
+      err = find_chromosome_id(data->chromosomes, rname->data, rname->n,
+                               &chrom_id);
+      if (err != E_SUCCESS) {
+        goto error;
       }
-      data->entries = tmp;
+      last_rname = *rname;
+    }
+    err = append_sam_read(data, chrom_id, &view);
+    if (err != E_SUCCESS) {
+      goto error;
     }
   }
-  fclose(fp);
+  if (!headers_done) {
+    sort_chromosome_dict(data->chromosomes);
+  }
+  close_sam_reader(reader);
   *sam = data;
 
   return E_SUCCESS;
+
+error:
+  close_sam_reader(reader);
+  free_sam(data);
+  return err;
 }
+
 int parse_sam_headers(struct sam_file **sam, char *file) {
-  static const int MAXLINELENGHT = 2048;
-  static const int STARTINGSIZE = 1024;
   const char header_line_marker = '@';
-  struct sam_file *data = (struct sam_file *)malloc(sizeof(struct sam_file));
+  struct sam_file *data = NULL;
+  int err = create_sam_file(&data, 0);
+  if (err != E_SUCCESS) {
+    return err;
+  }
+
+  struct sam_reader *reader = NULL;
+  err = open_sam_reader(&reader, file);
+  if (err != E_SUCCESS) {
+    free_sam(data);
+    return err;
+  }
+
+  struct sam_field line;
+  struct sq_header *tmp_header = NULL;
+  while (next_sam_line(reader, &line)) {
+    if (line.n == 0 || line.data[0] != header_line_marker) {
+      continue;
+    }
+    if (parse_sq_header(&tmp_header, line.data, line.n) != E_SUCCESS)
+      continue;
+    err = add_sam_header(data, tmp_header);
+    free_sam_header(tmp_header);
+    if (err != E_SUCCESS) {
+      close_sam_reader(reader);
+      free_sam(data);
+      return err;
+    }
+  }
+  close_sam_reader(reader);
+  *sam = data;
+
+  return E_SUCCESS;
+}
+
+static int create_sam_file(struct sam_file **sam, size_t capacity) {
+  static const int SEQ_STARTINGSIZE = 32;
+  struct sam_file *data = (struct sam_file *)calloc(1, sizeof(struct sam_file));
   if (data == NULL) {
     return E_MALLOC_FAIL;
   }
-  data->capacity = 0;
-  data->entries = NULL;
-  data->n = 0;
+  if (capacity > 0) {
+    data->capacity = capacity;
+    data->chrom_ids = (u32 *)malloc(capacity * sizeof(u32));
+    data->starts = (u32 *)malloc(capacity * sizeof(u32));
+    data->lengths = (u32 *)malloc(capacity * sizeof(u32));
+    data->is_reverse = (u8 *)malloc(capacity * sizeof(u8));
+    data->seq_offsets = (u64 *)malloc(capacity * sizeof(u64));
+    data->seq_capacity = capacity * SEQ_STARTINGSIZE;
+    data->seq_buffer = (char *)malloc(data->seq_capacity * sizeof(char));
+    if (data->chrom_ids == NULL || data->starts == NULL ||
+        data->lengths == NULL || data->is_reverse == NULL ||
+        data->seq_offsets == NULL || data->seq_buffer == NULL) {
+      free_sam(data);
+      return E_MALLOC_FAIL;
+    }
+  }
+
+  int err = create_chromosome_dict(&data->chromosomes);
+  if (err != E_SUCCESS) {
+    free_sam(data);
+    return err;
+  }
+  *sam = data;
+  return E_SUCCESS;
+}
+
+static int append_sam_read(struct sam_file *data, u32 chrom_id,
+                           struct sam_view *view) {
+  if (data->n == data->capacity) {
+    size_t capacity = data->capacity > 0 ? data->capacity * 2 : 1024;
+    u32 *chrom_ids = (u32 *)realloc(data->chrom_ids, capacity * sizeof(u32));
+    if (chrom_ids == NULL) {
+      return E_REALLOC_FAIL;
+    }
+    data->chrom_ids = chrom_ids;
+    u32 *starts = (u32 *)realloc(data->starts, capacity * sizeof(u32));
+    if (starts == NULL) {
+      return E_REALLOC_FAIL;
+    }
+    data->starts = starts;
+    u32 *lengths = (u32 *)realloc(data->lengths, capacity * sizeof(u32));
+    if (lengths == NULL) {
+      return E_REALLOC_FAIL;
+    }
+    data->lengths = lengths;
+    u8 *is_reverse = (u8 *)realloc(data->is_reverse, capacity * sizeof(u8));
+    if (is_reverse == NULL) {
+      return E_REALLOC_FAIL;
+    }
+    data->is_reverse = is_reverse;
+    u64 *seq_offsets =
+        (u64 *)realloc(data->seq_offsets, capacity * sizeof(u64));
+    if (seq_offsets == NULL) {
+      return E_REALLOC_FAIL;
+    }
+    data->seq_offsets = seq_offsets;
+    data->capacity = capacity;
+  }
+  struct sam_field *seq = &view->fields[SAM_SEQ];
+  if (data->seq_n + seq->n + 1 > data->seq_capacity) {
+    size_t capacity = data->seq_capacity > 0 ? data->seq_capacity : 1024;
+    while (data->seq_n + seq->n + 1 > capacity) {
+      capacity *= 2;
+    }
+    char *seq_buffer = (char *)realloc(data->seq_buffer, capacity);
+    if (seq_buffer == NULL) {
+      return E_REALLOC_FAIL;
+    }
+    data->seq_buffer = seq_buffer;
+    data->seq_capacity = capacity;
+  }
+  size_t i = data->n;
+  data->chrom_ids[i] = chrom_id;
+  data->starts[i] = view->pos - 1;
+  data->lengths[i] = seq->n;
+  data->is_reverse[i] = (view->flag & REV_COMPLM) ? 1 : 0;
+  data->seq_offsets[i] = data->seq_n;
+  memcpy(data->seq_buffer + data->seq_n, seq->data, seq->n);
+  data->seq_buffer[data->seq_n + seq->n] = 0;
+  data->seq_n += seq->n + 1;
+  data->n++;
+  return E_SUCCESS;
+}
+
+static int add_sam_header(struct sam_file *data, struct sq_header *header) {
+  u32 id;
+  return add_chromosome_to_dict(data->chromosomes, header->sn,
+                                strlen(header->sn), header->ln, &id);
+}
 
-  data->header_cap = STARTINGSIZE;
-  data->headers = (struct sq_header **)malloc(data->header_cap *
-                                              sizeof(struct sq_header *));
-  if (data->headers == NULL) {
-    free(data->entries);
-    free(data);
+/* Reads the file until its end into a buffer that grows, for files whose
+ * size is not known in advance (pipes, FIFOs) or that cannot be mapped. */
+static int read_sam_to_end(struct sam_reader *r, int fd) {
+  size_t capacity = (r->size > 0) ? r->size : 1 << 16;
+  r->data = (char *)malloc(capacity);
+  if (r->data == NULL) {
     return E_MALLOC_FAIL;
   }
-  data->header_n = 0;
+  r->size = 0;
+  while (1) {
+    if (r->size == capacity) {
+      char *tmp = (char *)realloc(r->data, 2 * capacity);
+      if (tmp == NULL) {
+        return E_MALLOC_FAIL;
+      }
+      r->data = tmp;
+      capacity *= 2;
+    }
+    ssize_t k = read(fd, r->data + r->size, capacity - r->size);
+    if (k == 0) {
+      return E_SUCCESS;
+    }
+    if (k < 0) {
+      return E_UNKNOWN_FILE_IO_ERROR;
+    }
+    r->size += (size_t)k;
+  }
+}
 
-  FILE *fp = fopen(file, "r");
-  if (fp == NULL) {
-    free(data->headers);
-    free(data);
+int open_sam_reader(struct sam_reader **reader, char *file) {
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) {
     return E_FILE_NOT_FOUND;
   }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return E_UNKNOWN_FILE_IO_ERROR;
+  }
+  struct sam_reader *r =
+      (struct sam_reader *)malloc(sizeof(struct sam_reader));
+  if (r == NULL) {
+    close(fd);
+    return E_MALLOC_FAIL;
+  }
+  r->data = NULL;
+  r->size = S_ISREG(st.st_mode) ? (size_t)st.st_size : 0;
+  r->offset = 0;
+  r->line_num = 0;
+  r->is_mapped = 0;
+  if (S_ISREG(st.st_mode) && r->size == 0) {
+    close(fd);
+    *reader = r;
+    return E_SUCCESS;
+  }
 
-  char line[MAXLINELENGHT];
-  while (fgets(line, sizeof(line), fp) != NULL) {
-    if (line[0] == header_line_marker) {
-      int err = parse_header(data->headers + data->header_n, line);
-      if (err != E_SUCCESS)
-        continue;
-      data->header_n++;
-      if (data->header_n == data->header_cap) {
-        data->header_cap *= 2;
-        struct sq_header **tmph = (struct sq_header **)realloc(
-            data->headers, data->header_cap * sizeof(struct sq_header *));
-        if (tmph == NULL) {
-          free_sam(data);
-          fclose(fp);
-          return E_REALLOC_FAIL;
-        }
-        data->headers = tmph;
-      }
-      continue;
+  if (S_ISREG(st.st_mode)) {
+    void *map = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+      madvise(map, r->size, MADV_SEQUENTIAL);
+#endif
+      r->data = (char *)map;
+      r->is_mapped = 1;
+      close(fd);
+      *reader = r;
+      return E_SUCCESS;
     }
   }
-  fclose(fp);
-  *sam = data;
 
+  /* A pipe, a FIFO or a file that cannot be mapped. */
+  int err = read_sam_to_end(r, fd);
+  close(fd);
+  if (err) {
+    free(r->data);
+    free(r);
+    return err;
+  }
+  *reader = r;
   return E_SUCCESS;
 }
 
-int parse_line(struct sam_entry **entry, char *line) {
+/* Returns the next line (without the line break) or 0 at the end of the file.
+ */
+int next_sam_line(struct sam_reader *reader, struct sam_field *line) {
+  if (reader->offset >= reader->size) {
+    return 0;
+  }
+  const char *start = reader->data + reader->offset;
+  size_t remaining = reader->size - reader->offset;
+  const char *end = (const char *)memchr(start, '\n', remaining);
+  if (end == NULL) {
+    line->data = start;
+    line->n = remaining;
+    reader->offset = reader->size;
+  } else {
+    line->data = start;
+    line->n = end - start;
+    reader->offset += line->n + 1;
+  }
+  reader->line_num++;
+  return 1;
+}
+
+int close_sam_reader(struct sam_reader *reader) {
+  if (reader->data != NULL) {
+    if (reader->is_mapped) {
+      munmap(reader->data, reader->size);
+    } else {
+      free(reader->data);
+    }
+  }
+  free(reader);
+  return E_SUCCESS;
+}
+
+int parse_sam_view(struct sam_view *view, const char *line, size_t n) {
   const char seperator = '\t';
-  const int num_entries = 11;
   const char header_line_marker = '@';
 
-  char *start = line;
-  char *end = NULL;
-  if (line[0] == header_line_marker)
+  if (n > 0 && line[0] == header_line_marker)
     return E_SAM_HEADER_LINE;
-  char **tokens = (char **)malloc(num_entries * sizeof(char *));
-  if (tokens == NULL) {
-    return E_MALLOC_FAIL;
-  }
-  int line_done = 0;
-  int current_token = 0;
 
-  while (!line_done) {
-    if (current_token >= num_entries) {
-      break;
-    }
-    end = strchr(start, seperator);
+  const char *start = line;
+  const char *line_end = line + n;
+  int current_token = 0;
+  while (current_token < SAM_COLUMN_COUNT && start < line_end) {
+    const char *end =
+        (const char *)memchr(start, seperator, line_end - start);
     if (end == NULL) {
-      end = strchr(start, '\n');
-      if (end == NULL)
-        end = strchr(start, '\0');
-      line_done = 1;
+      end = line_end;
     }
-    long l = end - start;
-    if (l == 0) {
+    if (end == start) {
       start += 1;
       continue;
     }
-    tokens[current_token] = (char *)malloc((l + 1) * sizeof(char));
-    memcpy(tokens[current_token], start, l);
-    tokens[current_token][l] = 0;
+    view->fields[current_token].data = start;
+    view->fields[current_token].n = end - start;
     current_token++;
     start = end + 1;
   }
-  int line_valid = 1;
+  if (current_token < SAM_COLUMN_COUNT) {
+    return E_INVALID_SAM_LINE;
+  }
 
-  if (current_token < num_entries) {
-    for (int i = 0; i < current_token; i++) {
-      free(tokens[i]);
-    }
-    free(tokens);
+  long flag, mapq;
+  if (parse_sam_integer(&view->fields[SAM_FLAG], &flag) != E_SUCCESS ||
+      parse_sam_integer(&view->fields[SAM_POS], &view->pos) != E_SUCCESS ||
+      parse_sam_integer(&view->fields[SAM_MAPQ], &mapq) != E_SUCCESS ||
+      parse_sam_integer(&view->fields[SAM_PNEXT], &view->pnext) != E_SUCCESS ||
+      parse_sam_integer(&view->fields[SAM_TLEN], &view->tlen) != E_SUCCESS) {
     return E_INVALID_SAM_LINE;
   }
+  view->flag = (int)flag;
+  view->mapq = (int)mapq;
+  return E_SUCCESS;
+}
+
+static int parse_sam_integer(const struct sam_field *field, long *value) {
+  const char *c = field->data;
+  const char *end = field->data + field->n;
+  int negative = 0;
+  if (c < end && (*c == '-' || *c == '+')) {
+    negative = (*c == '-');
+    c++;
+  }
+  if (c == end) {
+    return E_INVALID_SAM_LINE;
+  }
+  long v = 0;
+  for (; c < end; c++) {
+    if (*c < '0' || *c > '9') {
+      return E_INVALID_SAM_LINE;
+    }
+    v = v * 10 + (*c - '0');
+  }
+  *value = negative ? -v : v;
+  return E_SUCCESS;
+}
+
+int sam_field_equals(const struct sam_field *field, const char *str) {
+  size_t l = strlen(str);
+  return l == field->n && memcmp(field->data, str, l) == 0;
+}
 
+static char *sam_field_dup(const struct sam_field *field) {
+  char *s = (char *)malloc((field->n + 1) * sizeof(char));
+  if (s == NULL) {
+    return NULL;
+  }
+  memcpy(s, field->data, field->n);
+  s[field->n] = 0;
+  return s;
+}
+
+int create_sam_entry(struct sam_entry **entry, struct sam_view *view) {
   struct sam_entry *e = (struct sam_entry *)malloc(sizeof(struct sam_entry));
+  if (e == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  e->qname = sam_field_dup(&view->fields[SAM_QNAME]);
+  e->rname = sam_field_dup(&view->fields[SAM_RNAME]);
+  e->cigar = sam_field_dup(&view->fields[SAM_CIGAR]);
+  e->rnext = sam_field_dup(&view->fields[SAM_RNEXT]);
+  e->seq = sam_field_dup(&view->fields[SAM_SEQ]);
+  e->qual = sam_field_dup(&view->fields[SAM_QUAL]);
+  if (e->qname == NULL || e->rname == NULL || e->cigar == NULL ||
+      e->rnext == NULL || e->seq == NULL || e->qual == NULL) {
+    free_sam_entry(e);
+    return E_MALLOC_FAIL;
+  }
+  e->flag = view->flag;
+  e->pos = view->pos;
+  e->mapq = view->mapq;
+  e->pnext = view->pnext;
+  e->tlen = view->tlen;
+  *entry = e;
+  return E_SUCCESS;
+}
 
-  char *check = NULL;
-
-  e->qname = tokens[0];
-  e->rname = tokens[2];
-  e->cigar = tokens[5];
-  e->rnext = tokens[6];
-  e->seq = tokens[9];
-  e->qual = tokens[10];
-
-  long flag = strtol(tokens[1], &check, 10);
-  if (check == tokens[1] || *check != 0) {
-    line_valid = 0;
-  }
-  e->flag = (int)flag;
-  long pos = strtol(tokens[3], &check, 10);
-  if (check == tokens[3] || *check != 0) {
-    line_valid = 0;
-  }
-  e->pos = pos;
-  long mapq = strtol(tokens[4], &check, 10);
-  if (check == tokens[4] || *check != 0) {
-    line_valid = 0;
-  }
-  e->mapq = (int)mapq;
-  long pnext = strtol(tokens[7], &check, 10);
-  if (check == tokens[7] || *check != 0) {
-    line_valid = 0;
-  }
-  e->pnext = pnext;
-  long tlen = strtol(tokens[8], &check, 10);
-  if (check == tokens[8] || *check != 0) {
-    line_valid = 0;
-  }
-  e->tlen = tlen;
-
-  if (line_valid) {
-    free(tokens[1]);
-    free(tokens[3]);
-    free(tokens[4]);
-    free(tokens[7]);
-    free(tokens[8]);
-    free(tokens);
-    *entry = e;
-    return E_SUCCESS;
-  } else {
-    for (int i = 0; i < num_entries; i++) {
-      free(tokens[i]);
-    }
-    free(tokens);
-    free(e);
-    return E_INVALID_SAM_LINE;
+int parse_line(struct sam_entry **entry, char *line) {
+  struct sam_view view;
+  int err = parse_sam_view(&view, line, strcspn(line, "\n"));
+  if (err != E_SUCCESS) {
+    return err;
   }
+  return create_sam_entry(entry, &view);
 }
 
 int parse_header(struct sq_header **header, char *line) {
+  return parse_sq_header(header, line, strcspn(line, "\n"));
+}
+
+int parse_sq_header(struct sq_header **header, const char *line, size_t n) {
   const char *sq_header_marker = "@SQ";
   const char *sq_sn_marker = "SN:";
   const char *sq_ln_marker = "LN:";
-  const int marker_length = 3;
+  const size_t marker_length = 3;
   const char seperator = '\t';
+  const char *line_end = line + n;
 
-  if (strncmp(line, sq_header_marker, marker_length) != 0) {
+  if (n < marker_length ||
+      strncmp(line, sq_header_marker, marker_length) != 0) {
     return E_SAM_NON_SQ_HEADER;
   }
-  char *start = strchr(line, seperator) + 1;
-  if (strncmp(start, sq_sn_marker, marker_length) != 0) {
+  const char *start = (const char *)memchr(line, seperator, n);
+  if (start == NULL) {
+    return E_INVALID_SAM_LINE;
+  }
+  start++;
+  if ((size_t)(line_end - start) < marker_length ||
+      strncmp(start, sq_sn_marker, marker_length) != 0) {
     return E_INVALID_SAM_LINE;
   }
   start += marker_length;
-  char *end = strchr(start, seperator);
-
-  int l = end - start;
-  char *sn = (char *)malloc((l + 1) * sizeof(char));
-  if (sn == NULL) {
-    return E_MALLOC_FAIL;
+  const char *end = (const char *)memchr(start, seperator, line_end - start);
+  if (end == NULL) {
+    return E_INVALID_SAM_LINE;
   }
-  memcpy(sn, start, l);
-  sn[l] = 0;
+  struct sam_field sn_field = {start, (size_t)(end - start)};
 
   start = end + 1;
-  if (strncmp(start, sq_ln_marker, marker_length) != 0) {
-    free(sn);
+  if ((size_t)(line_end - start) < marker_length ||
+      strncmp(start, sq_ln_marker, marker_length) != 0) {
     return E_INVALID_SAM_LINE;
   }
   start += marker_length;
-  end = strchr(start, seperator);
+  end = (const char *)memchr(start, seperator, line_end - start);
   if (end == NULL) {
-    end = strchr(start, '\n');
-    if (end == NULL) {
-      free(sn);
-      return E_INVALID_SAM_LINE;
-    }
+    end = line_end;
   }
-  char *check = NULL;
-  long ln = strtol(start, &check, 10);
-  if (check != end) {
-    free(sn);
+  struct sam_field ln_field = {start, (size_t)(end - start)};
+  long ln;
+  if (parse_sam_integer(&ln_field, &ln) != E_SUCCESS) {
     return E_INVALID_SAM_LINE;
   }
   struct sq_header *h = (struct sq_header *)malloc(sizeof(struct sq_header));
-
-  h->sn = sn;
+  if (h == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  h->sn = sam_field_dup(&sn_field);
+  if (h->sn == NULL) {
+    free(h);
+    return E_MALLOC_FAIL;
+  }
   h->ln = ln;
   *header = h;
   return E_SUCCESS;
 }
 
 int free_sam(struct sam_file *sam) {
-  for (size_t i = 0; i < sam->n; i++) {
-    free_sam_entry(sam->entries[i]);
-  }
-  for (size_t i = 0; i < sam->header_n; i++) {
-    free_sam_header(sam->headers[i]);
-  }
-  if (sam->entries != NULL) {
-    free(sam->entries);
-  }
-  if (sam->headers != NULL) {
-    free(sam->headers);
+  if (sam->chromosomes != NULL) {
+    free_chromosome_dict(sam->chromosomes);
   }
+  free(sam->chrom_ids);
+  free(sam->starts);
+  free(sam->lengths);
+  free(sam->is_reverse);
+  free(sam->seq_offsets);
+  free(sam->seq_buffer);
   free(sam);
   return E_SUCCESS;
 }
@@ -5,6 +5,7 @@
 
 #include <stddef.h>
 #include "defs.h"
+#include "chromosomes.h"
 
 struct sq_header {
   char *sn;
@@ -25,13 +26,22 @@ struct sam_entry {
   char *qual;
 };
 
+/* Column store of the alignments. Read i is located at starts[i] (0-based) on
+ * the chromosome chrom_ids[i], its sequence is stored null terminated at
+ * seq_buffer + seq_offsets[i]. The chromosomes are taken from the @SQ headers.
+ */
 struct sam_file {
   size_t n;
   size_t capacity;
-  struct sam_entry **entries;
-  size_t header_n;
-  size_t header_cap;
-  struct sq_header **headers;
+  u32 *chrom_ids;
+  u32 *starts;
+  u32 *lengths;
+  u8 *is_reverse;
+  u64 *seq_offsets;
+  char *seq_buffer;
+  size_t seq_n;
+  size_t seq_capacity;
+  struct chromosome_dict *chromosomes;
 };
 
 enum sam_flag {
@@ -49,12 +59,64 @@ enum sam_flag {
   SUPPLEMENTARY = 0x800
 };
 
+enum sam_column {
+  SAM_QNAME = 0,
+  SAM_FLAG,
+  SAM_RNAME,
+  SAM_POS,
+  SAM_MAPQ,
+  SAM_CIGAR,
+  SAM_RNEXT,
+  SAM_PNEXT,
+  SAM_TLEN,
+  SAM_SEQ,
+  SAM_QUAL,
+  SAM_COLUMN_COUNT
+};
+
+/* A field of a SAM line. Points directly into the input and is not null
+ * terminated. */
+struct sam_field {
+  const char *data;
+  size_t n;
+};
+
+/* A tokenized alignment line, the fields are only valid as long as the
+ * underlying line (e.g. the sam_reader) is alive. */
+struct sam_view {
+  struct sam_field fields[SAM_COLUMN_COUNT];
+  int flag;
+  long pos;
+  int mapq;
+  long pnext;
+  long tlen;
+};
+
+/* Memory mapped SAM file, falls back to reading the whole file into memory if
+ * mapping is not possible. */
+struct sam_reader {
+  char *data;
+  size_t size;
+  size_t offset;
+  size_t line_num;
+  int is_mapped;
+};
+
 int parse_sam(struct sam_file **sam, char *file, char *selected_crom);
 int parse_sam_headers(struct sam_file **sam, char *file);
 int parse_line(struct sam_entry **entry, char *line);
 int parse_header(struct sq_header **header, char *line);
+
+int open_sam_reader(struct sam_reader **reader, char *file);
+int next_sam_line(struct sam_reader *reader, struct sam_field *line);
+int close_sam_reader(struct sam_reader *reader);
+int parse_sam_view(struct sam_view *view, const char *line, size_t n);
+int parse_sq_header(struct sq_header **header, const char *line, size_t n);
+int sam_field_equals(const struct sam_field *field, const char *str);
+int create_sam_entry(struct sam_entry **entry, struct sam_view *view);
+
 int free_sam(struct sam_file *sam);
 int free_sam_entry(struct sam_entry *e);
 int free_sam_header(struct sq_header *h);
 
-#endif
\ No newline at end of file
+#endif
@@ -4,14 +4,114 @@
 #include "coverage.h"
 #include "parse_sam.h"
 
-int count_unique_reads(struct extended_candidate *ecand, struct sam_file *sam) {
+static const int READCOUNT_FLANK = 30;
+
+static int reverse_complement_read(char **buffer, size_t *capacity,
+                                   struct sam_file *sam, size_t read);
+static int compare_indexed_reads(const void *a, const void *b);
+static size_t find_first_read(struct read_index *index, size_t bucket,
+                              long start);
+static int pack_sequence(u64 *packed, const char *seq, size_t l);
+static u64 hash_read(u64 start, const u64 *packed, const char *seq, size_t l);
+static int unique_read_equals(struct unique_read *read, u64 start,
+                              const u64 *packed, const char *seq, size_t l);
+static int grow_unique_read_slots(struct unique_read_list *ur_list);
+
+int create_read_index(struct read_index **index, struct sam_file *sam) {
+  struct read_index *tmp =
+      (struct read_index *)malloc(sizeof(struct read_index));
+  if (tmp == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  tmp->n = sam->n;
+  tmp->bucket_n = 2 * sam->chromosomes->n;
+  tmp->bucket_offsets =
+      (size_t *)calloc(tmp->bucket_n + 1, sizeof(size_t));
+  tmp->entries = (struct indexed_read *)malloc(
+      (sam->n > 0 ? sam->n : 1) * sizeof(struct indexed_read));
+  if (tmp->bucket_offsets == NULL || tmp->entries == NULL) {
+    free_read_index(tmp);
+    return E_MALLOC_FAIL;
+  }
+  /* counting sort into the buckets, then sort every bucket by start */
+  for (size_t i = 0; i < sam->n; i++) {
+    tmp->bucket_offsets[2 * sam->chrom_ids[i] + sam->is_reverse[i] + 1]++;
+  }
+  for (size_t b = 0; b < tmp->bucket_n; b++) {
+    tmp->bucket_offsets[b + 1] += tmp->bucket_offsets[b];
+  }
+  size_t *fill = (size_t *)malloc((tmp->bucket_n + 1) * sizeof(size_t));
+  if (fill == NULL) {
+    free_read_index(tmp);
+    return E_MALLOC_FAIL;
+  }
+  memcpy(fill, tmp->bucket_offsets, (tmp->bucket_n + 1) * sizeof(size_t));
+  for (size_t i = 0; i < sam->n; i++) {
+    size_t bucket = 2 * sam->chrom_ids[i] + sam->is_reverse[i];
+    struct indexed_read *entry = tmp->entries + fill[bucket];
+    entry->start = sam->starts[i];
+    entry->read = i;
+    fill[bucket]++;
+  }
+  free(fill);
+  for (size_t b = 0; b < tmp->bucket_n; b++) {
+    size_t offset = tmp->bucket_offsets[b];
+    qsort(tmp->entries + offset, tmp->bucket_offsets[b + 1] - offset,
+          sizeof(struct indexed_read), compare_indexed_reads);
+  }
+  *index = tmp;
+  return E_SUCCESS;
+}
+
+int free_read_index(struct read_index *index) {
+  free(index->bucket_offsets);
+  free(index->entries);
+  free(index);
+  return E_SUCCESS;
+}
+
+/* Returns the position of the first read in the bucket starting at or after
+ * start. */
+static size_t find_first_read(struct read_index *index, size_t bucket,
+                              long start) {
+  size_t low = index->bucket_offsets[bucket];
+  size_t high = index->bucket_offsets[bucket + 1];
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if ((long)index->entries[mid].start < start) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+static int compare_indexed_reads(const void *a, const void *b) {
+  const struct indexed_read *r1 = (const struct indexed_read *)a;
+  const struct indexed_read *r2 = (const struct indexed_read *)b;
+  if (r1->start != r2->start) {
+    return r1->start < r2->start ? -1 : 1;
+  }
+  if (r1->read != r2->read) {
+    return r1->read < r2->read ? -1 : 1;
+  }
+  return 0;
+}
+
+int count_unique_reads(struct extended_candidate *ecand, struct sam_file *sam,
+                       struct read_index *index) {
 
   struct micro_rna_candidate *cand = ecand->cand;
   struct candidate_subsequence_list *css_list = ecand->possible_micro_rnas;
 
   struct candidate_subsequence *mature_mirna = NULL;
   struct candidate_subsequence *star_mirna = NULL;
-  struct sam_entry *entry = NULL;
+  /* the read store is shared between threads, reverse complements of minus
+   * strand reads go to this buffer */
+  char *rc_buffer = NULL;
+  size_t rc_capacity = 0;
+  int err;
 
   ecand->total_reads = 0;
 
@@ -22,40 +122,53 @@ int count_unique_reads(struct extended_candidate *ecand, struct sam_file *sam) {
     create_unique_read_list(&star_mirna->reads);
   }
 
-  for (size_t i = 0; i < sam->n; i++) {
-    entry = sam->entries[i];
-    long entry_start = entry->pos - 1;
-    char strand = (entry->flag & REV_COMPLM) ? '-' : '+';
+  /* only reads within the flanked candidate can match a subsequence */
+  size_t bucket = 2 * cand->chrom_id + (cand->strand == '-');
+  long window_start = (long)cand->start - READCOUNT_FLANK;
+  long window_end = (long)cand->end + READCOUNT_FLANK;
+  size_t bucket_end = index->bucket_offsets[bucket + 1];
+  for (size_t k = find_first_read(index, bucket, window_start);
+       k < bucket_end && (long)index->entries[k].start <= window_end; k++) {
+    size_t i = index->entries[k].read;
+    long entry_start = sam->starts[i];
+    const char *seq = sam->seq_buffer + sam->seq_offsets[i];
+    char strand = sam->is_reverse[i] ? '-' : '+';
     for (size_t j = 0; j < css_list->n; j++) {
       mature_mirna = css_list->mature_sequences[j];
       star_mirna = mature_mirna->matching_sequence;
-      if (check_subsequence_match(entry, cand, mature_mirna)) {
+      if (check_subsequence_match(sam, i, cand, mature_mirna)) {
         if (strand == '-') {
-          char *reversed = NULL;
-          reverse_complement_sequence_string(&reversed, entry->seq,
-                                             strlen(entry->seq) + 1);
-          free(entry->seq);
-          entry->seq = reversed;
+          err = reverse_complement_read(&rc_buffer, &rc_capacity, sam, i);
+          if (err != E_SUCCESS) {
+            free(rc_buffer);
+            return err;
+          }
+          seq = rc_buffer;
           strand = '+';
         }
-        add_read_to_unique_read_list(mature_mirna->reads, entry_start,
-                                     entry->seq);
+        add_read_to_unique_read_list(mature_mirna->reads, entry_start, seq);
       }
-      if (check_subsequence_match(entry, cand, star_mirna)) {
+      if (check_subsequence_match(sam, i, cand, star_mirna)) {
         if (strand == '-') {
-          char *reversed = NULL;
-          reverse_complement_sequence_string(&reversed, entry->seq,
-                                             strlen(entry->seq) + 1);
-          free(entry->seq);
-          entry->seq = reversed;
+          err = reverse_complement_read(&rc_buffer, &rc_capacity, sam, i);
+          if (err != E_SUCCESS) {
+            free(rc_buffer);
+            return err;
+          }
+          seq = rc_buffer;
           strand = '+';
         }
-        add_read_to_unique_read_list(star_mirna->reads, entry_start,
-                                     entry->seq);
+        add_read_to_unique_read_list(star_mirna->reads, entry_start, seq);
       }
     }
-    if (entry_start >= cand->start) {
-      u64 end = entry_start + strlen(entry->seq);
+  }
+  free(rc_buffer);
+  /* reads of both strands lying completely within the candidate */
+  for (size_t b = 2 * cand->chrom_id; b < 2 * cand->chrom_id + 2; b++) {
+    bucket_end = index->bucket_offsets[b + 1];
+    for (size_t k = find_first_read(index, b, cand->start);
+         k < bucket_end && index->entries[k].start <= cand->end; k++) {
+      u64 end = index->entries[k].start + sam->lengths[index->entries[k].read];
       if (end <= cand->end) {
         ecand->total_reads++;
       }
@@ -65,22 +178,37 @@ int count_unique_reads(struct extended_candidate *ecand, struct sam_file *sam) {
   return E_SUCCESS;
 }
 
-int check_subsequence_match(struct sam_entry *entry,
+/* Writes the reverse complement of a read to buffer, growing it if needed. */
+static int reverse_complement_read(char **buffer, size_t *capacity,
+                                   struct sam_file *sam, size_t read) {
+  size_t l = sam->lengths[read];
+  if (l + 1 > *capacity) {
+    char *tmp = (char *)realloc(*buffer, (l + 1) * sizeof(char));
+    if (tmp == NULL) {
+      return E_REALLOC_FAIL;
+    }
+    *buffer = tmp;
+    *capacity = l + 1;
+  }
+  return reverse_complement_sequence(
+      *buffer, sam->seq_buffer + sam->seq_offsets[read], l);
+}
+
+int check_subsequence_match(struct sam_file *sam, size_t read,
                             struct micro_rna_candidate *cand,
                             struct candidate_subsequence *sseq) {
-  const int READCOUNT_FLANK = 30;
-  size_t start = cand->start + sseq->start - READCOUNT_FLANK;
-  size_t end = cand->start + sseq->end + READCOUNT_FLANK;
-  long entry_start = entry->pos - 1;
-  char strand = (entry->flag & REV_COMPLM) ? '-' : '+';
+  long start = (long)(cand->start + sseq->start) - READCOUNT_FLANK;
+  long end = (long)(cand->start + sseq->end) + READCOUNT_FLANK;
+  long entry_start = sam->starts[read];
+  char strand = sam->is_reverse[read] ? '-' : '+';
   if (strand != cand->strand) {
     return 0;
   }
-  if (strcmp(entry->rname, cand->chrom) != 0) {
+  if (sam->chrom_ids[read] != cand->chrom_id) {
     return 0;
   }
   if (entry_start >= start) {
-    u64 entry_end = entry_start + strlen(entry->seq);
+    long entry_end = entry_start + sam->lengths[read];
     if (entry_end <= end) {
       return 1;
     }
@@ -88,6 +216,9 @@ int check_subsequence_match(struct sam_entry *entry,
   return 0;
 }
 
+/* Number of u64 words holding a packed sequence of length l. */
+#define PACKED_WORDS(l) (((l) + 31) / 32)
+
 int create_unique_read(struct unique_read **read, u64 start, const char *seq) {
   struct unique_read *read_tmp =
       (struct unique_read *)malloc(sizeof(struct unique_read));
@@ -97,12 +228,20 @@ int create_unique_read(struct unique_read **read, u64 start, const char *seq) {
   read_tmp->start = start;
   size_t l = strlen(seq);
   read_tmp->seq = (char *)malloc((l + 1) * sizeof(char));
-  if (read_tmp->seq == NULL) {
+  read_tmp->packed = (u64 *)malloc((PACKED_WORDS(l) + 1) * sizeof(u64));
+  if (read_tmp->seq == NULL || read_tmp->packed == NULL) {
+    free(read_tmp->seq);
+    free(read_tmp->packed);
     free(read_tmp);
     return E_MALLOC_FAIL;
   }
   memcpy(read_tmp->seq, seq, l);
   read_tmp->seq[l] = 0;
+  if (!pack_sequence(read_tmp->packed, seq, l)) {
+    free(read_tmp->packed);
+    read_tmp->packed = NULL;
+  }
+  read_tmp->hash = hash_read(start, read_tmp->packed, seq, l);
   read_tmp->end = start + l;
   read_tmp->count = 1;
   *read = read_tmp;
@@ -118,7 +257,12 @@ int create_unique_read_list(struct unique_read_list **ur_list) {
   ur_list_tmp->capacity = INITIAL_CAPACITY;
   ur_list_tmp->reads = (struct unique_read **)malloc(
       ur_list_tmp->capacity * sizeof(struct unique_read *));
-  if (ur_list_tmp->reads == NULL) {
+  ur_list_tmp->slot_capacity = 2 * INITIAL_CAPACITY;
+  ur_list_tmp->slots =
+      (u32 *)calloc(ur_list_tmp->slot_capacity, sizeof(u32));
+  if (ur_list_tmp->reads == NULL || ur_list_tmp->slots == NULL) {
+    free(ur_list_tmp->reads);
+    free(ur_list_tmp->slots);
     free(ur_list_tmp);
     return E_MALLOC_FAIL;
   }
@@ -137,20 +281,54 @@ int append_unique_read_list(struct unique_read_list *ur_list,
     }
     ur_list->reads = tmp;
   }
+  /* keep the load factor of the slots at most 1/2 */
+  if (2 * (ur_list->n + 1) > ur_list->slot_capacity) {
+    int err = grow_unique_read_slots(ur_list);
+    if (err != E_SUCCESS) {
+      return err;
+    }
+  }
+  size_t mask = ur_list->slot_capacity - 1;
+  size_t slot = read->hash & mask;
+  while (ur_list->slots[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+  ur_list->slots[slot] = ur_list->n + 1;
   ur_list->reads[ur_list->n] = read;
   ur_list->n++;
   return E_SUCCESS;
 }
 int add_read_to_unique_read_list(struct unique_read_list *ur_list, u64 start,
                                  const char *seq) {
+  /* enough for usual read lengths, longer reads are packed on the heap */
+  u64 packed_stack[16];
+  u64 *packed = packed_stack;
+  size_t l = strlen(seq);
+  if (PACKED_WORDS(l) > 16) {
+    packed = (u64 *)malloc(PACKED_WORDS(l) * sizeof(u64));
+    if (packed == NULL) {
+      return E_MALLOC_FAIL;
+    }
+  }
+  const u64 *key = pack_sequence(packed, seq, l) ? packed : NULL;
+  u64 hash = hash_read(start, key, seq, l);
+
   struct unique_read *read = NULL;
-  for (size_t i = 0; i < ur_list->n; i++) {
-    read = ur_list->reads[i];
-    if (start == read->start && strcmp(seq, read->seq) == 0) {
+  size_t mask = ur_list->slot_capacity - 1;
+  for (size_t slot = hash & mask; ur_list->slots[slot] != 0;
+       slot = (slot + 1) & mask) {
+    read = ur_list->reads[ur_list->slots[slot] - 1];
+    if (read->hash == hash && unique_read_equals(read, start, key, seq, l)) {
       read->count++;
+      if (packed != packed_stack) {
+        free(packed);
+      }
       return E_SUCCESS;
     }
   }
+  if (packed != packed_stack) {
+    free(packed);
+  }
   int err;
   err = create_unique_read(&read, start, seq);
   if (err != E_SUCCESS) {
@@ -158,11 +336,102 @@ int add_read_to_unique_read_list(struct unique_read_list *ur_list, u64 start,
   }
   err = append_unique_read_list(ur_list, read);
   if (err != E_SUCCESS) {
+    free_unique_read(read);
     return err;
   }
   return E_SUCCESS;
 }
 
+/* Packs seq with 2 bits per base, returns 0 if it contains anything else than
+ * ACGT. Unused bits of the last word are zero. */
+static int pack_sequence(u64 *packed, const char *seq, size_t l) {
+  u64 word = 0;
+  u64 code;
+  size_t i;
+  for (i = 0; i < l; i++) {
+    switch (seq[i]) {
+    case 'A':
+      code = 0;
+      break;
+    case 'C':
+      code = 1;
+      break;
+    case 'G':
+      code = 2;
+      break;
+    case 'T':
+      code = 3;
+      break;
+    default:
+      return 0;
+    }
+    word |= code << (2 * (i % 32));
+    if (i % 32 == 31) {
+      packed[i / 32] = word;
+      word = 0;
+    }
+  }
+  if (i % 32 != 0) {
+    packed[i / 32] = word;
+  }
+  return 1;
+}
+
+static u64 hash_read(u64 start, const u64 *packed, const char *seq, size_t l) {
+  u64 hash = start * 0x9E3779B97F4A7C15ULL ^ l;
+  if (packed != NULL) {
+    for (size_t i = 0; i < PACKED_WORDS(l); i++) {
+      hash = (hash ^ packed[i]) * 0x100000001B3ULL;
+      hash ^= hash >> 29;
+    }
+  } else {
+    for (size_t i = 0; i < l; i++) {
+      hash = (hash ^ (u8)seq[i]) * 0x100000001B3ULL;
+    }
+  }
+  hash ^= hash >> 32;
+  return hash;
+}
+
+static int unique_read_equals(struct unique_read *read, u64 start,
+                              const u64 *packed, const char *seq, size_t l) {
+  if (read->start != start || read->end - read->start != l) {
+    return 0;
+  }
+  if ((read->packed == NULL) != (packed == NULL)) {
+    return 0;
+  }
+  if (packed == NULL) {
+    return strcmp(read->seq, seq) == 0;
+  }
+  for (size_t i = 0; i < PACKED_WORDS(l); i++) {
+    if (read->packed[i] != packed[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int grow_unique_read_slots(struct unique_read_list *ur_list) {
+  size_t capacity = 2 * ur_list->slot_capacity;
+  u32 *slots = (u32 *)calloc(capacity, sizeof(u32));
+  if (slots == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  size_t mask = capacity - 1;
+  for (size_t i = 0; i < ur_list->n; i++) {
+    size_t slot = ur_list->reads[i]->hash & mask;
+    while (slots[slot] != 0) {
+      slot = (slot + 1) & mask;
+    }
+    slots[slot] = i + 1;
+  }
+  free(ur_list->slots);
+  ur_list->slots = slots;
+  ur_list->slot_capacity = capacity;
+  return E_SUCCESS;
+}
+
 int free_unique_read_list(struct unique_read_list *ur_list) {
   if (ur_list == NULL) {
     return E_SUCCESS;
@@ -171,11 +440,13 @@ int free_unique_read_list(struct unique_read_list *ur_list) {
     free_unique_read(ur_list->reads[i]);
   }
   free(ur_list->reads);
+  free(ur_list->slots);
   free(ur_list);
   return E_SUCCESS;
 }
 int free_unique_read(struct unique_read *read) {
   free(read->seq);
+  free(read->packed);
   free(read);
   return E_SUCCESS;
 }
\ No newline at end of file
@@ -13,20 +13,45 @@
 struct extended_candidate;
 struct candidate_subsequence;
 
+/* packed holds the sequence with 2 bits per base, it is NULL if the sequence
+ * contains other characters than ACGT. */
 struct unique_read {
   u64 start;
   u64 end;
   char *seq;
   u32 count;
+  u64 hash;
+  u64 *packed;
 };
+/* The reads in order of their first occurrence. slots is an open addressing
+ * table over them keyed on (start, seq), holding index + 1 (0 is empty). */
 struct unique_read_list {
   struct unique_read **reads;
   size_t n;
   size_t capacity;
+  u32 *slots;
+  size_t slot_capacity;
 };
 
-int count_unique_reads(struct extended_candidate *ecand, struct sam_file *sam);
-int check_subsequence_match(struct sam_entry *entry,
+/* Alignments sorted by (chromosome, strand, start). The reads of bucket
+ * 2 * chrom_id + is_reverse are entries[bucket_offsets[bucket]] up to
+ * entries[bucket_offsets[bucket + 1]]. */
+struct indexed_read {
+  u32 start;
+  u32 read;
+};
+struct read_index {
+  size_t n;
+  size_t bucket_n;
+  size_t *bucket_offsets;
+  struct indexed_read *entries;
+};
+
+int create_read_index(struct read_index **index, struct sam_file *sam);
+int free_read_index(struct read_index *index);
+int count_unique_reads(struct extended_candidate *ecand, struct sam_file *sam,
+                       struct read_index *index);
+int check_subsequence_match(struct sam_file *sam, size_t read,
                             struct micro_rna_candidate *cand,
                             struct candidate_subsequence *sseq);
 int create_unique_read(struct unique_read **read, u64 start, const char *seq);
@@ -11,7 +11,7 @@
 #include <errno.h>
 
 int report_valid_candiates(struct extended_candidate_list *ec_list,
-                           struct chrom_coverage **coverage_table,
+                           struct coverage_table *coverage_table,
                            const char *executable_path, const char *output_path,
                            struct configuration_params *config) {
 
@@ -58,19 +58,19 @@ int report_valid_candiates(struct extended_candidate_list *ec_list,
     if (ecand->is_valid != 1) {
       continue;
     }
-    HASH_FIND_STR(*coverage_table, ecand->cand->chrom, chrom_cov);
-    if (chrom_cov == NULL) {
+    if (ecand->cand->chrom_id >= coverage_table->n) {
       free(cov_plot_path);
       free(structure_path);
       free(coverage_path);
       free(report_path);
       return E_CHROMOSOME_NOT_FOUND;
     }
+    chrom_cov = coverage_table->coverages + ecand->cand->chrom_id;
     create_candidate_report(ecand, chrom_cov, executable_path, cov_plot_path,
                             structure_path, coverage_path, report_path, config);
-    write_bed_lines(bed_fp, ecand);
-    write_gtf_line(gtf_fp, ecand);
-    write_html_table_row(html_fp, ecand);
+    write_bed_lines(bed_fp, ecand, chrom_cov->name);
+    write_gtf_line(gtf_fp, ecand, chrom_cov->name);
+    write_html_table_row(html_fp, ecand, chrom_cov->name);
   }
   if (bed_fp != NULL) {
     fclose(bed_fp);
@@ -243,11 +243,19 @@ int create_coverage_plot(char **result_file, struct extended_candidate *ecand,
   u64 box2_start = star_mirna->start + cand->start + 1;
   u64 box2_end = star_mirna->end + cand->start;
 
-  u32 *plus_cov = chrom_cov->coverage_plus + cand->start;
-  u32 *minus_cov = chrom_cov->coverage_minus + cand->start;
+  u32 *plus_cov = (u32 *)malloc(2 * l * sizeof(u32));
+  if (plus_cov == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  u32 *minus_cov = plus_cov + l;
+  get_coverage_window(plus_cov, chrom_cov->coverage_plus, cand->start,
+                      cand->end);
+  get_coverage_window(minus_cov, chrom_cov->coverage_minus, cand->start,
+                      cand->end);
 
   FILE *fp = fopen(data_file_path, "w");
   if (fp == NULL) {
+    free(plus_cov);
     return E_FILE_WRITING_FAILED;
   }
   for (size_t i = 0; i < l; i++) {
@@ -266,6 +274,7 @@ int create_coverage_plot(char **result_file, struct extended_candidate *ecand,
       y_max = minus_cov[i];
     }
   }
+  free(plus_cov);
   y_max = (u32)(y_max * 1.5 * 1.5);
 
   char gnuplot_system_call[4096];
@@ -385,24 +394,31 @@ int create_coverage_image(char **result_file, struct extended_candidate *ecand,
   char *seq = cand->sequence;
   char *structure = cand->structure;
 
-  u32 *cov_list = chrom_cov->coverage_plus;
+  struct coverage_track *cov_track = chrom_cov->coverage_plus;
   if (cand->strand == '-') {
-    cov_list = chrom_cov->coverage_minus;
+    cov_track = chrom_cov->coverage_minus;
   }
 
   size_t segment_n = 50;
   size_t cand_n = cand->end - cand->start;
   u32 color_index = 0;
 
+  u32 *cov_list = (u32 *)malloc(cand_n * sizeof(u32));
+  if (cov_list == NULL) {
+    free(varna_path);
+    return E_MALLOC_FAIL;
+  }
+  get_coverage_window(cov_list, cov_track, cand->start, cand->end);
+
   char *highlight_string = (char *)malloc(segment_n * cand_n * sizeof(char));
   char *write_point = highlight_string;
   for (size_t i = 0; i < cand_n; i++) {
-    size_t global_index = cand->start + i;
-    map_coverage_to_color_index(&color_index, cov_list[global_index]);
+    map_coverage_to_color_index(&color_index, cov_list[i]);
     write_point +=
         sprintf(write_point, "%ld-%ld:fill=%s,outline=%s;", i + 1, i + 1,
                 coverage_colors[color_index], hex_color_white);
   }
+  free(cov_list);
   char file_name[265];
   sprintf(file_name, "Cluster_%lld_coverage_image.eps", cand->id);
   char *file_path = NULL;
@@ -474,7 +490,7 @@ int create_latex_template(char **tex_file, struct extended_candidate *ecand,
               "Best star miRNA : start = \\verb$%lld$ (\\verb$%d$), stop = "
               "\\verb$%lld$ (\\verb$%d$), length = \\verb$%d$\\\\\n"
               "{[}Note: Positions are 1-based and inclusive{]}\\\\\n \\\\\n",
-          cand->id, cand->chrom, cand->start, cand->end,
+          cand->id, chrom_cov->name, cand->start, cand->end,
           cand->start - cand->end, cand->start + mature_mirna->start,
           mature_mirna->start, cand->start + mature_mirna->end,
           mature_mirna->end, mature_mirna->end - mature_mirna->start,
@@ -539,13 +555,13 @@ int create_latex_template(char **tex_file, struct extended_candidate *ecand,
   }
   fprintf(fp, "\\end{tabular}\\\\\n");
 
-  u32 *cov_list = chrom_cov->coverage_plus;
+  struct coverage_track *cov_track = chrom_cov->coverage_plus;
   if (cand->strand == '-') {
-    cov_list = chrom_cov->coverage_minus;
+    cov_track = chrom_cov->coverage_minus;
   }
 
   u64 total_coverage = 0;
-  get_coverage_in_range(&total_coverage, cov_list, cand->start, cand->end);
+  get_coverage_in_range(&total_coverage, cov_track, cand->start, cand->end);
 
   fprintf(fp,
           "\\section*{Coverage}\n"
@@ -679,7 +695,8 @@ int map_coverage_to_color_index(u32 *result, u32 coverage) {
   return E_SUCCESS;
 }
 
-int write_bed_lines(FILE *fp, struct extended_candidate *ecand) {
+int write_bed_lines(FILE *fp, struct extended_candidate *ecand,
+                    const char *chrom) {
   if (fp == NULL) {
     return E_FILE_WRITING_FAILED;
   }
@@ -688,7 +705,7 @@ int write_bed_lines(FILE *fp, struct extended_candidate *ecand) {
   struct candidate_subsequence *mature_mirna = NULL;
   struct candidate_subsequence *star_mirna = NULL;
   fprintf(fp, "%s\t%llu\t%llu\tprecursor_%lld\t%d\t%c\t%llu\t%llu\t%d\t%d\n",
-          cand->chrom, cand->start, cand->end, cand->id, 0, cand->strand,
+          chrom, cand->start, cand->end, cand->id, 0, cand->strand,
           cand->start, cand->end, 0, 0);
   for (size_t i = 0; i < css_list->n; i++) {
     mature_mirna = css_list->mature_sequences[i];
@@ -697,19 +714,20 @@ int write_bed_lines(FILE *fp, struct extended_candidate *ecand) {
 
     fprintf(fp,
             "%s\t%llu\t%llu\tprecursor_%lld_mir_%ld_%s\t%d\t%c\t%llu\t%llu\n",
-            cand->chrom, cand->start, cand->end, cand->id, i,
+            chrom, cand->start, cand->end, cand->id, i,
             (mature_mirna->arm == 5) ? "5p" : "3p", score, cand->strand,
             cand->start + mature_mirna->start, cand->start + mature_mirna->end);
     fprintf(fp,
             "%s\t%llu\t%llu\tprecursor_%lld_mir_%ld_%s\t%d\t%c\t%llu\t%llu\n",
-            cand->chrom, cand->start, cand->end, cand->id, i,
+            chrom, cand->start, cand->end, cand->id, i,
             (mature_mirna->arm == 5) ? "3p" : "5p", score, cand->strand,
             cand->start + star_mirna->start, cand->start + star_mirna->end);
   }
 
   return E_SUCCESS;
 }
-int write_gtf_line(FILE *fp, struct extended_candidate *ecand) {
+int write_gtf_line(FILE *fp, struct extended_candidate *ecand,
+                   const char *chrom) {
   if (fp == NULL) {
     return E_FILE_WRITING_FAILED;
   }
@@ -729,13 +747,14 @@ int write_gtf_line(FILE *fp, struct extended_candidate *ecand) {
   fprintf(
       fp,
       "%s\tmiRA\texon\t%lld\t%lld\t0\t%c\t.\tgene_id \"precursor_%lld_%s\"\n",
-      cand->chrom, cand->start + 1, cand->end, cand->strand, cand->id,
+      chrom, cand->start + 1, cand->end, cand->strand, cand->id,
       (cand->strand == '+') ? "plus" : "minus");
 
   return E_SUCCESS;
 }
 
-int write_json_entry(FILE *fp, struct extended_candidate *ecand) {
+int write_json_entry(FILE *fp, struct extended_candidate *ecand,
+                     const char *chrom) {
   if (fp == NULL) {
     return E_FILE_WRITING_FAILED;
   }
@@ -745,7 +764,7 @@ int write_json_entry(FILE *fp, struct extended_candidate *ecand) {
 
   fprintf(fp, "\"Cluster_%lld_%s\":{\n", cand->id,
           (cand->strand == '-') ? "minus" : "plus");
-  fprintf(fp, "\t\"chromosome\":\"%s\",\n", cand->chrom);
+  fprintf(fp, "\t\"chromosome\":\"%s\",\n", chrom);
   fprintf(fp, "\t\"candidate_start\":%lld,\n", cand->start);
   fprintf(fp, "\t\"candidate_end\":%lld,\n", cand->end);
   fprintf(fp, "\t\"candidate_length\":%lld,\n", cand->end - cand->start);
@@ -824,7 +843,8 @@ int inititalize_html_report(FILE *fp) {
       "aria-hidden='true'></span></span></th></tr></thead><tbody>");
   return E_SUCCESS;
 }
-int write_html_table_row(FILE *fp, struct extended_candidate *ecand) {
+int write_html_table_row(FILE *fp, struct extended_candidate *ecand,
+                         const char *chrom) {
   if (fp == NULL) {
     return E_FILE_WRITING_FAILED;
   }
@@ -844,7 +864,7 @@ int write_html_table_row(FILE *fp, struct extended_candidate *ecand) {
             "td><td>%lld</td><td>%7.5lf "
             "</td><td>%7.5le</td><td>%7.5lf</td><td>",
             cand->id, cand->id, i, (cand->strand == '-') ? "minus" : "plus",
-            cand->chrom, (cand->strand == '-') ? "minus" : "plus", cand->start,
+            chrom, (cand->strand == '-') ? "minus" : "plus", cand->start,
             cand->end, cand->mfe, cand->pvalue, cand->paired_fraction);
     for (u32 i = mature_mirna->start; i < mature_mirna->end; i++) {
       fprintf(fp, "%c", cand->sequence[i]);
@@ -6,7 +6,7 @@
 #include "coverage.h"
 
 int report_valid_candiates(struct extended_candidate_list *ec_list,
-                           struct chrom_coverage **coverage_table,
+                           struct coverage_table *coverage_table,
                            const char *executable_path, const char *output_path,
                            struct configuration_params *config);
 int create_output_directory_structure(char **cov_plot_ouput_path,
@@ -40,11 +40,15 @@ int write_unique_reads_to_tex(FILE *fp, struct micro_rna_candidate *cand,
                               struct unique_read_list *reads);
 int compile_tex_file(const char *tex_file_path, const char *output_path);
 int map_coverage_to_color_index(u32 *result, u32 coverage);
-int write_bed_lines(FILE *fp, struct extended_candidate *ecand);
-int write_gtf_line(FILE *fp, struct extended_candidate *ecand);
-int write_json_entry(FILE *fp, struct extended_candidate *ecand);
+int write_bed_lines(FILE *fp, struct extended_candidate *ecand,
+                    const char *chrom);
+int write_gtf_line(FILE *fp, struct extended_candidate *ecand,
+                   const char *chrom);
+int write_json_entry(FILE *fp, struct extended_candidate *ecand,
+                     const char *chrom);
 int inititalize_html_report(FILE *fp);
-int write_html_table_row(FILE *fp, struct extended_candidate *ecand);
+int write_html_table_row(FILE *fp, struct extended_candidate *ecand,
+                         const char *chrom);
 int finalize_html_report(FILE *fp);
 int cleanup_auxiliary_files(char *cov_plot_file, char *structure_file,
                             char *coverage_file, char *tex_file,
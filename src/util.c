@@ -8,7 +8,9 @@
 #include <math.h>
 #include <stddef.h>
 #include <time.h>
+#include <ctype.h>
 #include <string.h>
+#include "Lfold/fold_vars.h"
 
 int create_text_buffer(struct text_buffer **buffer) {
   const size_t INITIAL_SIZE = 4096;
@@ -84,6 +86,13 @@ static void set_default_config(struct configuration_params *config) {
   config->max_hairpin_count = 4;
   config->min_double_strand_length = 20;
   config->permutation_count = 100;
+  config->min_permutation_count = 20;
+  config->permutation_error = 0.0;
+  config->pvalue_method = PVALUE_PERMUTATION;
+  config->random_seed = 0;
+  config->null_model_cache[0] = 0;
+  config->fold_cache[0] = 0;
+  config->sparse_folding = 1;
   config->max_pvalue = 0.01;
 
   config->min_dicer_offset = 0;
@@ -116,6 +125,13 @@ static void set_algae_config(struct configuration_params *config) {
   config->max_hairpin_count = 4;
   config->min_double_strand_length = 18;
   config->permutation_count = 100;
+  config->min_permutation_count = 20;
+  config->permutation_error = 0.0;
+  config->pvalue_method = PVALUE_PERMUTATION;
+  config->random_seed = 0;
+  config->null_model_cache[0] = 0;
+  config->fold_cache[0] = 0;
+  config->sparse_folding = 1;
   config->max_pvalue = 0.01;
 
   config->min_coverage = 0.01;
@@ -140,6 +156,13 @@ static void set_plant_config(struct configuration_params *config) {
   config->max_hairpin_count = 4;
   config->min_double_strand_length = 18;
   config->permutation_count = 100;
+  config->min_permutation_count = 20;
+  config->permutation_error = 0.0;
+  config->pvalue_method = PVALUE_PERMUTATION;
+  config->random_seed = 0;
+  config->null_model_cache[0] = 0;
+  config->fold_cache[0] = 0;
+  config->sparse_folding = 1;
   config->max_pvalue = 0.01;
 
   config->min_coverage = 0.01;
@@ -164,6 +187,13 @@ static void set_animal_config(struct configuration_params *config) {
   config->max_hairpin_count = 2;
   config->min_double_strand_length = 17;
   config->permutation_count = 100;
+  config->min_permutation_count = 20;
+  config->permutation_error = 0.0;
+  config->pvalue_method = PVALUE_PERMUTATION;
+  config->random_seed = 0;
+  config->null_model_cache[0] = 0;
+  config->fold_cache[0] = 0;
+  config->sparse_folding = 1;
   config->max_pvalue = 0.01;
 
   config->min_coverage = 0.01;
@@ -174,6 +204,21 @@ static void set_animal_config(struct configuration_params *config) {
   config->allow_two_terminal_mismatches = 0;
 }
 
+/* Finds the token as a whole word, so a token that is part of a longer one
+ * (e.g. permutation_count in min_permutation_count) is not matched. */
+static char *find_config_token(char *line, const char *token) {
+  size_t n = strlen(token);
+  for (char *match = strstr(line, token); match != NULL;
+       match = strstr(match + 1, token)) {
+    int starts_word = match == line || isspace((unsigned char)match[-1]);
+    int ends_word = match[n] == '=' || isspace((unsigned char)match[n]);
+    if (starts_word && ends_word) {
+      return match;
+    }
+  }
+  return NULL;
+}
+
 static int parse_config_file(struct configuration_params *config,
                              char *config_file) {
   const int MAXLINELENGTH = 1024;
@@ -181,11 +226,12 @@ static int parse_config_file(struct configuration_params *config,
       "log_level", "openmp_thread_count", "cluster_gap_size",
       "cluster_min_reads", "cluster_flank_size", "cluster_max_length",
       "max_precursor_length", "min_precursor_length", "max_hairpin_count",
-      "min_double_strand_length", "permutation_count", "min_duplex_length",
-      "max_duplex_length", "allow_three_mismatches",
-      "allow_two_terminal_mismatches", "min_dicer_offset", "max_dicer_offset",
-      "create_coverage_plots", "create_structure_plots",
-      "create_structure_coverage_plots", "cleanup_auxiliary_files"};
+      "min_double_strand_length", "permutation_count", "min_permutation_count",
+      "pvalue_method", "random_seed", "min_duplex_length", "max_duplex_length",
+      "allow_three_mismatches", "allow_two_terminal_mismatches",
+      "min_dicer_offset", "max_dicer_offset", "create_coverage_plots",
+      "create_structure_plots", "create_structure_coverage_plots",
+      "cleanup_auxiliary_files", "sparse_folding"};
   int integer_token_offsets[] = {
       (int)offsetof(struct configuration_params, log_level),
       (int)offsetof(struct configuration_params, openmp_thread_count),
@@ -198,6 +244,9 @@ static int parse_config_file(struct configuration_params *config,
       (int)offsetof(struct configuration_params, max_hairpin_count),
       (int)offsetof(struct configuration_params, min_double_strand_length),
       (int)offsetof(struct configuration_params, permutation_count),
+      (int)offsetof(struct configuration_params, min_permutation_count),
+      (int)offsetof(struct configuration_params, pvalue_method),
+      (int)offsetof(struct configuration_params, random_seed),
       (int)offsetof(struct configuration_params, min_duplex_length),
       (int)offsetof(struct configuration_params, max_duplex_length),
       (int)offsetof(struct configuration_params, allow_three_mismatches),
@@ -208,16 +257,24 @@ static int parse_config_file(struct configuration_params *config,
       (int)offsetof(struct configuration_params, create_structure_plots),
       (int)offsetof(struct configuration_params,
                     create_structure_coverage_plots),
-      (int)offsetof(struct configuration_params, cleanup_auxiliary_files)};
-  const int integer_token_count = 21;
-  const char *double_tokens[] = {"max_mfe_per_nt", "max_pvalue", "min_coverage",
+      (int)offsetof(struct configuration_params, cleanup_auxiliary_files),
+      (int)offsetof(struct configuration_params, sparse_folding)};
+  const int integer_token_count = 25;
+  const char *double_tokens[] = {"max_mfe_per_nt", "max_pvalue",
+                                 "permutation_error", "min_coverage",
                                  "min_paired_fraction"};
   int double_token_offsets[] = {
       (int)offsetof(struct configuration_params, max_mfe_per_nt),
       (int)offsetof(struct configuration_params, max_pvalue),
+      (int)offsetof(struct configuration_params, permutation_error),
       (int)offsetof(struct configuration_params, min_coverage),
       (int)offsetof(struct configuration_params, min_paired_fraction)};
-  const int double_token_count = 4;
+  const int double_token_count = 5;
+  const char *string_tokens[] = {"null_model_cache", "fold_cache"};
+  int string_token_offsets[] = {
+      (int)offsetof(struct configuration_params, null_model_cache),
+      (int)offsetof(struct configuration_params, fold_cache)};
+  const int string_token_count = 2;
 
   const char COMMENT_CHAR = '#';
   FILE *fp = fopen(config_file, "r");
@@ -238,7 +295,7 @@ static int parse_config_file(struct configuration_params *config,
       /* ignore everthing after comment */
       *end = 0;
       for (int i = 0; i < integer_token_count; i++) {
-        char *match = strstr(line, integer_tokens[i]);
+        char *match = find_config_token(line, integer_tokens[i]);
         if (match == NULL) {
           continue;
         }
@@ -257,7 +314,7 @@ static int parse_config_file(struct configuration_params *config,
         break;
       }
       for (int i = 0; i < double_token_count; i++) {
-        char *match = strstr(line, double_tokens[i]);
+        char *match = find_config_token(line, double_tokens[i]);
         if (match == NULL) {
           continue;
         }
@@ -274,6 +331,28 @@ static int parse_config_file(struct configuration_params *config,
         *target = (double)value;
         break;
       }
+      for (int i = 0; i < string_token_count; i++) {
+        char *match = find_config_token(line, string_tokens[i]);
+        if (match == NULL) {
+          continue;
+        }
+        char *eq = strchr(match, '=');
+        if (eq == NULL) {
+          break;
+        }
+        char *value = eq + 1;
+        while (isspace((unsigned char)*value)) {
+          value++;
+        }
+        size_t length = 0;
+        while (value[length] != 0 && !isspace((unsigned char)value[length])) {
+          length++;
+        }
+        char *target = (char *)((long)config + string_token_offsets[i]);
+        memcpy(target, value, length);
+        target[length] = 0;
+        break;
+      }
     }
   }
   fclose(fp);
@@ -311,31 +390,40 @@ int initialize_configuration(struct configuration_params **config,
   return E_SUCCESS;
 }
 
+/* n counts the terminating null character of seq. */
 int reverse_complement_sequence_string(char **result, char *seq, size_t n) {
-  const char *pairs[] = {"AT", "GC", "UA", "YR", "SS",
-                         "WW", "KM", "BV", "DH", "NN"};
-  const int pairs_n = 10;
   char *tmp = (char *)malloc(n * sizeof(char));
   if (tmp == NULL) {
     return E_MALLOC_FAIL;
   }
-  size_t k = n - 1;
-  tmp[k--] = 0;
+  reverse_complement_sequence(tmp, seq, n - 1);
+  *result = tmp;
+  return E_SUCCESS;
+};
+
+/* Writes the reverse complement of the n bases of seq null terminated to
+ * result, which has to hold n + 1 characters. Unknown bases are kept. */
+int reverse_complement_sequence(char *result, const char *seq, size_t n) {
+  const char *pairs[] = {"AT", "GC", "UA", "YR", "SS",
+                         "WW", "KM", "BV", "DH", "NN"};
+  const int pairs_n = 10;
   for (size_t i = 0; i < n; i++) {
+    char c = seq[i];
     for (int j = 0; j < pairs_n; j++) {
-      if (seq[i] == pairs[j][0]) {
-        tmp[k--] = pairs[j][1];
+      if (c == pairs[j][0]) {
+        c = pairs[j][1];
         break;
       }
-      if (seq[i] == pairs[j][1]) {
-        tmp[k--] = pairs[j][0];
+      if (c == pairs[j][1]) {
+        c = pairs[j][0];
         break;
       }
     }
+    result[n - 1 - i] = c;
   }
-  *result = tmp;
+  result[n] = 0;
   return E_SUCCESS;
-};
+}
 
 int create_file_path(char **file_path, const char *path, const char *filename) {
   size_t path_n = strnlen(path, 1024);
@@ -382,6 +470,17 @@ void log_configuration(struct configuration_params *config) {
             config->min_double_strand_length);
   log_basic(config->log_level, "    permutation_count %d\n",
             config->permutation_count);
+  log_basic(config->log_level, "    min_permutation_count %d\n",
+            config->min_permutation_count);
+  log_basic(config->log_level, "    permutation_error %lf\n",
+            config->permutation_error);
+  log_basic(config->log_level, "    pvalue_method %d\n", config->pvalue_method);
+  log_basic(config->log_level, "    random_seed %d\n", config->random_seed);
+  log_basic(config->log_level, "    null_model_cache %s\n",
+            config->null_model_cache);
+  log_basic(config->log_level, "    fold_cache %s\n", config->fold_cache);
+  log_basic(config->log_level, "    sparse_folding %d\n",
+            config->sparse_folding);
   log_basic(config->log_level, "    max_pvalue %lf\n", config->max_pvalue);
   log_basic(config->log_level, "    min_coverage %lf\n", config->min_coverage);
   log_basic(config->log_level, "    min_paired_fraction %lf\n",
@@ -497,4 +596,81 @@ double sd(double *list, int n, double mean) {
 
 double pvalue(double mean, double sd, double value) {
   return erfc(fabs(value - mean) / (sqrt(2) * sd)) / 2.0;
-}
\ No newline at end of file
+}
+
+/* Returns z such that a standard normal variable exceeds z with probability
+ * p, found by bisection on the upper tail. */
+double normal_quantile(double p) {
+  double low = -40.0;
+  double high = 40.0;
+  for (int i = 0; i < 100; i++) {
+    double z = (low + high) / 2.0;
+    if (erfc(z / sqrt(2)) / 2.0 > p) {
+      low = z;
+    } else {
+      high = z;
+    }
+  }
+  return (low + high) / 2.0;
+}
+
+static u64 splitmix64(u64 *x) {
+  u64 z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static u64 rotl(u64 x, int k) { return (x << k) | (x >> (64 - k)); }
+
+/* Seeds an independent stream of the generator, the same seed and stream
+ * always give the same random numbers. */
+void seed_random(struct random_state *state, u64 seed, u64 stream) {
+  u64 x = stream;
+  x = seed ^ splitmix64(&x);
+  for (int i = 0; i < 4; i++) {
+    state->s[i] = splitmix64(&x);
+  }
+}
+
+u64 next_random(struct random_state *state) {
+  u64 *s = state->s;
+  u64 result = rotl(s[1] * 5, 7) * 9;
+  u64 t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+u64 hash_bytes(u64 hash, const void *data, size_t n) {
+  const u64 FNV_PRIME = 0x100000001b3ULL;
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < n; i++) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+u64 hash_int(u64 hash, i64 value) {
+  return hash_bytes(hash, &value, sizeof(value));
+}
+
+u64 hash_double(u64 hash, double value) {
+  return hash_bytes(hash, &value, sizeof(value));
+}
+
+/* The settings of the energy model folding depends on. */
+u64 hash_energy_model(u64 hash) {
+  hash = hash_double(hash, temperature);
+  hash = hash_int(hash, dangles);
+  hash = hash_int(hash, noLonelyPairs);
+  hash = hash_int(hash, noGU);
+  hash = hash_int(hash, no_closingGU);
+  hash = hash_int(hash, tetra_loop);
+  return hash_int(hash, energy_set);
+}
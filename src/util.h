@@ -3,6 +3,7 @@
 #ifndef UTIL_H
 #define UTIL_H
 #include <stdlib.h>
+#include "defs.h"
 
 enum log_level {
   LOG_LEVEL_QUIET = 0,
@@ -10,6 +11,14 @@ enum log_level {
   LOG_LEVEL_VERBOSE = 2,
 };
 
+#define CONFIG_STRING_LENGTH 1024
+
+enum pvalue_method {
+  PVALUE_PERMUTATION = 0,
+  PVALUE_REGRESSION = 1,
+  PVALUE_REGRESSION_CONFIRMED = 2,
+};
+
 struct configuration_params {
   int log_level;
   int openmp_thread_count;
@@ -24,6 +33,13 @@ struct configuration_params {
   int max_hairpin_count;
   int min_double_strand_length;
   int permutation_count;
+  int min_permutation_count;
+  double permutation_error;
+  int pvalue_method;
+  int random_seed;
+  char null_model_cache[CONFIG_STRING_LENGTH];
+  char fold_cache[CONFIG_STRING_LENGTH];
+  int sparse_folding;
   double max_pvalue;
   double min_coverage;
   double min_paired_fraction;
@@ -41,6 +57,11 @@ struct configuration_params {
   int cleanup_auxiliary_files;
 };
 
+/* State of a xoshiro256** generator */
+struct random_state {
+  u64 s[4];
+};
+
 struct text_buffer {
   char *data;
   char *start;
@@ -56,6 +77,7 @@ int initialize_configuration(struct configuration_params **config,
                              char *config_file);
 
 int reverse_complement_sequence_string(char **result, char *seq, size_t n);
+int reverse_complement_sequence(char *result, const char *seq, size_t n);
 int create_file_path(char **file_path, const char *path, const char *filename);
 
 void log_configuration(struct configuration_params *config);
@@ -67,5 +89,17 @@ void log_verbose_timestamp(int loglevel, const char *msg, ...);
 double mean(double *list, int n);
 double sd(double *list, int n, double mean);
 double pvalue(double mean, double sd, double value);
+double normal_quantile(double p);
+
+void seed_random(struct random_state *state, u64 seed, u64 stream);
+u64 next_random(struct random_state *state);
+
+/* FNV-1a hashes of the parameters the caches depend on, start with
+ * HASH_OFFSET */
+#define HASH_OFFSET 0xcbf29ce484222325ULL
+u64 hash_bytes(u64 hash, const void *data, size_t n);
+u64 hash_int(u64 hash, i64 value);
+u64 hash_double(u64 hash, double value);
+u64 hash_energy_model(u64 hash);
 
 #endif
\ No newline at end of file
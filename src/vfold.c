@@ -2,7 +2,6 @@
 #include <getopt.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <time.h>
 #include <math.h>
 #include "float.h"
 #include "vfold.h"
@@ -22,9 +21,22 @@
 #endif
 
 static int print_help();
+static int restore_cached_fold(struct fold_cache *cache,
+                               struct fold_cache_key *key,
+                               struct foldable_sequence *fs,
+                               int *has_distribution);
+static int store_cached_fold(struct fold_cache *cache,
+                             struct fold_cache_key *key,
+                             struct foldable_sequence *fs);
+static int compare_fold_jobs(const void *a, const void *b);
+static struct fold_context *thread_context(struct fold_context **contexts);
+
+struct fold_job {
+  double cost;
+  size_t index;
+};
 
 int vfold(int argc, char *argv[]) {
-  srand(time(NULL));
   int c;
   int log_level = LOG_LEVEL_BASIC;
   char default_output_file[] = "output";
@@ -76,6 +88,7 @@ int vfold_main(struct configuration_params *config, char *bed_file,
   omp_set_num_threads(config->openmp_thread_count);
 #endif
 
+  struct chromosome_dict *chromosomes = NULL;
   struct cluster_list *c_list = NULL;
   struct genome_sequence *seq_table = NULL;
   struct sequence_list *seq_list = NULL;
@@ -83,8 +96,13 @@ int vfold_main(struct configuration_params *config, char *bed_file,
   char *json_output_file = NULL;
   char *mira_output_file = NULL;
   int err;
+  err = create_chromosome_dict(&chromosomes);
+  if (err) {
+    print_error(err);
+    return err;
+  }
   log_verbose_timestamp(config->log_level, "\tReading BED file...\n");
-  err = read_bed_file(&c_list, bed_file);
+  err = read_bed_file(&c_list, bed_file, chromosomes);
   if (err) {
     goto bed_read_err;
   }
@@ -131,6 +149,7 @@ int vfold_main(struct configuration_params *config, char *bed_file,
 
   free_sequence_list(seq_list);
   free_candidate_list(cand_list);
+  free_chromosome_dict(chromosomes);
 
   return E_SUCCESS;
 convert_error:
@@ -139,15 +158,18 @@ write_error:
   free(mira_output_file);
 fold_error:
   free_sequence_list(seq_list);
+  free_chromosome_dict(chromosomes);
   print_error(err);
   return err;
 map_error:
   free_sequence_table(seq_table);
+  free_chromosome_dict(chromosomes);
   print_error(err);
   return err;
 fasta_read_err:
   free_clusters(c_list);
 bed_read_err:
+  free_chromosome_dict(chromosomes);
   print_error(err);
   return err;
 }
@@ -182,17 +204,31 @@ int map_clusters(struct sequence_list **seq_list, struct cluster_list *c_list,
     free(tmp_seq_list);
     return E_MALLOC_FAIL;
   }
+  tmp_seq_list->chromosomes = c_list->chromosomes;
+  /* look up the genome sequence of every chromosome only once */
+  size_t chrom_n = c_list->chromosomes->n;
+  struct genome_sequence **chrom_seqs = (struct genome_sequence **)malloc(
+      (chrom_n > 0 ? chrom_n : 1) * sizeof(struct genome_sequence *));
+  if (chrom_seqs == NULL) {
+    free_sequence_list(tmp_seq_list);
+    return E_MALLOC_FAIL;
+  }
+  for (size_t i = 0; i < chrom_n; i++) {
+    HASH_FIND_STR(seq_table, c_list->chromosomes->names[i], chrom_seqs[i]);
+  }
   struct foldable_sequence *fs = NULL;
   struct cluster *c = NULL;
   struct genome_sequence *gs = NULL;
   for (size_t i = 0; i < n; i++) {
     c = c_list->clusters[i];
-    HASH_FIND_STR(seq_table, c->chrom, gs);
+    gs = chrom_seqs[c->chrom_id];
     if (gs == NULL) {
+      free(chrom_seqs);
       free_sequence_list(tmp_seq_list);
       return E_NEEDED_SEQUENCE_NOT_FOUND;
     }
     if (c->flank_end > gs->n + 1) {
+      free(chrom_seqs);
       free_sequence_list(tmp_seq_list);
       return E_INVALID_FASTA_SEQUENCE_LENGTH;
     }
@@ -202,6 +238,7 @@ int map_clusters(struct sequence_list **seq_list, struct cluster_list *c_list,
     size_t l = c->flank_end - c->flank_start - 1;
     fs->seq = (char *)malloc((l + 1) * sizeof(char));
     if (fs->seq == NULL) {
+      free(chrom_seqs);
       free_sequence_list(tmp_seq_list);
       return E_MALLOC_FAIL;
     }
@@ -214,6 +251,7 @@ int map_clusters(struct sequence_list **seq_list, struct cluster_list *c_list,
     if (c->strand == '-') {
       int err = reverse_complement(fs);
       if (err) {
+        free(chrom_seqs);
         free_sequence_list(tmp_seq_list);
         return err;
       }
@@ -222,6 +260,7 @@ int map_clusters(struct sequence_list **seq_list, struct cluster_list *c_list,
     tmp_seq_list->sequences[i] = fs;
   }
 
+  free(chrom_seqs);
   free(c_list->clusters);
   free(c_list);
   *seq_list = tmp_seq_list;
@@ -243,12 +282,89 @@ int fold_sequences(struct sequence_list *seq_list,
   // }
 
   size_t progress_count = 0;
+  size_t fallback_count = 0;
+  int err = E_SUCCESS;
+  struct mfe_models *models = NULL;
+  struct null_model_cache *cache = NULL;
+  struct fold_cache *fold_cache = NULL;
+  size_t *order = NULL;
+  struct fold_context **contexts = NULL;
+  int thread_count = 1;
+  if (config->pvalue_method != PVALUE_PERMUTATION &&
+      create_mfe_models(&models) != 0) {
+    return E_MALLOC_FAIL;
+  }
+  if (config->null_model_cache[0] != 0) {
+    err = create_null_model_cache(&cache, config);
+    if (err) {
+      goto cleanup;
+    }
+    err = read_null_model_cache(cache, config->null_model_cache);
+    if (err) {
+      goto cleanup;
+    }
+    log_verbose(config->log_level, "Read %ld null models from %s\n", cache->n,
+                config->null_model_cache);
+    if (cache->invalid_lines > 0) {
+      log_basic(config->log_level,
+                "Skipped %ld invalid lines of the null model cache %s\n",
+                cache->invalid_lines, config->null_model_cache);
+    }
+  }
+  if (config->fold_cache[0] != 0) {
+    err = create_fold_cache(&fold_cache);
+    if (err) {
+      goto cleanup;
+    }
+    err = read_fold_cache(fold_cache, config->fold_cache);
+    if (err) {
+      goto cleanup;
+    }
+    log_verbose(config->log_level, "Read %ld folds from %s\n", fold_cache->n,
+                config->fold_cache);
+    if (fold_cache->invalid_lines > 0) {
+      log_basic(config->log_level,
+                "Skipped %ld invalid lines of the fold cache %s\n",
+                fold_cache->invalid_lines, config->fold_cache);
+    }
+  }
+
+  /* the most expensive sequences first, so no long fold starts when the
+   * other threads are already done */
+  err = get_fold_order(seq_list, config, &order);
+  if (err) {
+    goto cleanup;
+  }
+
+  /* every thread folds with its own context, so the arrays are reused. The
+   * permutations run as tasks on any thread of the team, so the contexts
+   * are looked up by thread. */
+#ifdef _OPENMP
+  thread_count = omp_get_max_threads();
+#endif
+  contexts = (struct fold_context **)calloc(thread_count,
+                                            sizeof(struct fold_context *));
+  if (contexts == NULL) {
+    err = E_MALLOC_FAIL;
+    goto cleanup;
+  }
+  for (int t = 0; t < thread_count; t++) {
+    if (create_fold_context(&contexts[t]) != 0) {
+      err = E_MALLOC_FAIL;
+      goto cleanup;
+    }
+    contexts[t]->sparse_ml = config->sparse_folding;
+  }
 
   log_basic_timestamp(config->log_level, "Initializing folding...\n");
 // #pragma omp parallel for private(fs, s_list,                                   \
 //                                  buf) shared(buffers) schedule(dynamic)
-#pragma omp parallel for private(fs, s_list, buf) schedule(dynamic)
-  for (size_t i = 0; i < seq_list->n; i++) {
+#pragma omp parallel private(fs, s_list, buf)
+  {
+    struct fold_context *ctx = thread_context(contexts);
+#pragma omp for schedule(dynamic)
+    for (size_t k = 0; k < seq_list->n; k++) {
+      size_t i = order[k];
 // #ifdef _OPENMP
 //     int tid = omp_get_thread_num();
 //     buf = buffers[tid];
@@ -257,84 +373,125 @@ int fold_sequences(struct sequence_list *seq_list,
 // #endif
 
 #pragma omp critical
-    {
-      progress_count++;
-      log_basic_timestamp(config->log_level,
-                          "Folding sequence %5ld \\%5ld ... \n", progress_count,
-                          seq_list->n);
-    }
-    fs = seq_list->sequences[i];
-    int max_length = fs->n;
-    if (config->max_precursor_length > 0 &&
-        config->max_precursor_length < max_length) {
-      max_length = config->max_precursor_length;
-    }
-    Lfold(&s_list, fs->seq, max_length);
-    find_optimal_structure(s_list, fs, config);
-    free_structure_list(s_list);
-
-    if (fs->structure == NULL) {
-      print_to_text_buffer(
-          buf,
-          "Cluster %lld \x1b[31m[INVALID]\x1b[0m \n\t No structure found \n",
-          fs->c->id);
-      continue;
-    }
-    evaluate_structure(fs->structure);
+      {
+        progress_count++;
+        log_basic_timestamp(config->log_level,
+                            "Folding sequence %5ld \\%5ld ... \n",
+                            progress_count, seq_list->n);
+      }
+      fs = seq_list->sequences[i];
+      /* a cached fold replaces both, folding and permutations */
+      struct fold_cache_key key;
+      int is_cached = 0;
+      int has_distribution = 0;
+      if (fold_cache != NULL) {
+        get_fold_cache_key(&key, fs->seq, fs->n - 1,
+                           fs->c->start - fs->c->flank_start,
+                           fs->c->end - fs->c->flank_start, config);
+#pragma omp critical(fold_cache)
+        is_cached = restore_cached_fold(fold_cache, &key, fs,
+                                        &has_distribution) == E_SUCCESS;
+      }
+      if (!is_cached) {
+        int max_length = fs->n;
+        if (config->max_precursor_length > 0 &&
+            config->max_precursor_length < max_length) {
+          max_length = config->max_precursor_length;
+        }
+        /* only the structures that contain the core are of interest */
+        Lfold_core(ctx, &s_list, fs->seq, max_length, 0, 0.0,
+                   fs->c->start - fs->c->flank_start + 1,
+                   fs->c->end - fs->c->flank_start);
+        find_optimal_structure(ctx, s_list, fs, config);
+        free_structure_list(s_list);
+        if (fold_cache != NULL) {
+#pragma omp critical(fold_cache)
+          store_cached_fold(fold_cache, &key, fs);
+        }
+      }
 
-    int err = check_folding_constraints(fs, config);
-    if (fs->structure->is_valid == 0) {
-      switch (err) {
-      case E_STRUCTURE_TOO_SHORT:
-        print_to_text_buffer(
-            buf, "Cluster %lld \x1b[31m[INVALID]\x1b[0m "
-                 "\n\t The structure is to short (length: %ld, min: %d) \n",
-            fs->c->id, fs->structure->n, config->min_precursor_length);
-        break;
-      case E_STRUCTURE_HAS_TO_MANY_HAIRPINS:
-        print_to_text_buffer(
-            buf, "Cluster %lld \x1b[31m[INVALID]\x1b[0m \n\t The structure "
-                 "has to many hairpins (has: %d max: %d)\n",
-            fs->c->id, fs->structure->external_loop_count,
-            config->max_hairpin_count);
-        break;
-      case E_STRUCTURE_HAT_TO_SHORT_STEM:
+      if (fs->structure == NULL) {
         print_to_text_buffer(
             buf,
-            "Cluster %lld \x1b[31m[INVALID]\x1b[0m \n\t The structure stem "
-            "section is too short (length: %d min: %d)\n",
-            fs->c->id, abs(fs->structure->stem_end_with_mismatch -
-                           fs->structure->stem_start_with_mismatch) +
-                           1,
-            config->min_double_strand_length);
-        break;
-      case E_STRUCTURE_MFE_TO_HIGH:
+            "Cluster %lld \x1b[31m[INVALID]\x1b[0m \n\t No structure found \n",
+            fs->c->id);
+        continue;
+      }
+      evaluate_structure(fs->structure);
+
+      int err = check_folding_constraints(fs, config);
+      if (fs->structure->is_valid == 0) {
+        switch (err) {
+        case E_STRUCTURE_TOO_SHORT:
+          print_to_text_buffer(
+              buf, "Cluster %lld \x1b[31m[INVALID]\x1b[0m "
+                   "\n\t The structure is to short (length: %ld, min: %d) \n",
+              fs->c->id, fs->structure->n, config->min_precursor_length);
+          break;
+        case E_STRUCTURE_HAS_TO_MANY_HAIRPINS:
+          print_to_text_buffer(
+              buf, "Cluster %lld \x1b[31m[INVALID]\x1b[0m \n\t The structure "
+                   "has to many hairpins (has: %d max: %d)\n",
+              fs->c->id, fs->structure->external_loop_count,
+              config->max_hairpin_count);
+          break;
+        case E_STRUCTURE_HAT_TO_SHORT_STEM:
+          print_to_text_buffer(
+              buf,
+              "Cluster %lld \x1b[31m[INVALID]\x1b[0m \n\t The structure stem "
+              "section is too short (length: %d min: %d)\n",
+              fs->c->id, abs(fs->structure->stem_end_with_mismatch -
+                             fs->structure->stem_start_with_mismatch) +
+                             1,
+              config->min_double_strand_length);
+          break;
+        case E_STRUCTURE_MFE_TO_HIGH:
+          print_to_text_buffer(
+              buf, "Cluster %lld \x1b[31m[INVALID]\x1b[0m \n\t The structure "
+                   "mfe is to high (mfe: %7.5e max: "
+                   "%7.5e)\n",
+              fs->c->id, fs->structure->mfe, config->max_mfe_per_nt);
+          break;
+        default:
+          print_to_text_buffer(buf, "Cluster %lld \x1b[31m[INVALID]\x1b[0m "
+                                    "\n\t Something unknown went wrong.  "
+                                    "\n",
+                               fs->c->id);
+          break;
+        }
+        continue;
+      }
+      if (!has_distribution) {
+        if (models == NULL ||
+            estimate_mfe_distribution(fs, models) != E_SUCCESS) {
+          if (models != NULL) {
+#pragma omp atomic
+            fallback_count++;
+          }
+          calculate_mfe_distribution(fs, config, contexts, cache);
+        } else if (config->pvalue_method == PVALUE_REGRESSION_CONFIRMED &&
+                   check_pvalue(fs, config) == E_SUCCESS) {
+          /* only structures passing the estimate are confirmed by folding
+           * permutations */
+          calculate_mfe_distribution(fs, config, contexts, cache);
+        }
+        fs->structure->has_distribution = 1;
+        if (fold_cache != NULL) {
+#pragma omp critical(fold_cache)
+          store_cached_fold(fold_cache, &key, fs);
+        }
+      }
+      check_pvalue(fs, config);
+      if (fs->structure->is_valid == 0) {
         print_to_text_buffer(
             buf, "Cluster %lld \x1b[31m[INVALID]\x1b[0m \n\t The structure "
-                 "mfe is to high (mfe: %7.5e max: "
-                 "%7.5e)\n",
-            fs->c->id, fs->structure->mfe, config->max_mfe_per_nt);
-        break;
-      default:
-        print_to_text_buffer(buf, "Cluster %lld \x1b[31m[INVALID]\x1b[0m "
-                                  "\n\t Something unknown went wrong.  "
-                                  "\n",
-                             fs->c->id);
-        break;
+                 "pvalue is to high (p: %7.5e max: %7.5e\n",
+            fs->c->id, fs->structure->pvalue, config->max_pvalue);
+        continue;
       }
-      continue;
-    }
-    calculate_mfe_distribution(fs, config->permutation_count);
-    check_pvalue(fs, config);
-    if (fs->structure->is_valid == 0) {
-      print_to_text_buffer(
-          buf, "Cluster %lld \x1b[31m[INVALID]\x1b[0m \n\t The structure "
-               "pvalue is to high (p: %7.5e max: %7.5e\n",
-          fs->c->id, fs->structure->pvalue, config->max_pvalue);
-      continue;
+      print_to_text_buffer(buf, "Cluster %lld \x1b[32m[VALID]\x1b[0m \n",
+                           fs->c->id);
     }
-    print_to_text_buffer(buf, "Cluster %lld \x1b[32m[VALID]\x1b[0m \n",
-                         fs->c->id);
   }
   // for (int i = 0; i < config->openmp_thread_count; i++) {
   //   log_verbose(config->log_level, "Thread %d:\n", i);
@@ -344,10 +501,164 @@ int fold_sequences(struct sequence_list *seq_list,
   //   log_verbose(config->log_level, "%s", buffers[i]->start);
   //   free_text_buffer(buffers[i]);
   // }
+  if (fallback_count > 0) {
+    log_basic(config->log_level,
+              "%ld structures outside of the range of the regression model, "
+              "their permutations were folded\n",
+              fallback_count);
+  }
+  if (cache != NULL) {
+    err = write_null_model_cache(cache, config->null_model_cache);
+  }
+  if (err == E_SUCCESS && fold_cache != NULL && fold_cache->is_modified) {
+    err = write_fold_cache(fold_cache, config->fold_cache);
+  }
+
+cleanup:
+  if (contexts != NULL) {
+    for (int t = 0; t < thread_count; t++) {
+      free_fold_context(contexts[t]);
+    }
+    free(contexts);
+  }
+  free(order);
+  free_mfe_models(models);
+  if (cache != NULL) {
+    free_null_model_cache(cache);
+  }
+  if (fold_cache != NULL) {
+    free_fold_cache(fold_cache);
+  }
+  if (err != E_SUCCESS) {
+    return err;
+  }
   log_basic_timestamp(config->log_level, "Folding completed successfully.\n");
   return E_SUCCESS;
 };
 
+/* Tasks run on any thread of the team, each thread folds with its own
+ * context. */
+static struct fold_context *thread_context(struct fold_context **contexts) {
+#ifdef _OPENMP
+  return contexts[omp_get_thread_num()];
+#else
+  return contexts[0];
+#endif
+}
+
+/* The order to fold the sequences in, by decreasing cost. Lfold fills
+ * length x span cells, each with a loop over up to span splits, and the
+ * permutations of a sequence cost about the same per fold. */
+int get_fold_order(struct sequence_list *seq_list,
+                   struct configuration_params *config, size_t **order) {
+  struct fold_job *jobs =
+      (struct fold_job *)malloc(seq_list->n * sizeof(struct fold_job));
+  size_t *tmp = (size_t *)malloc(seq_list->n * sizeof(size_t));
+  if (jobs == NULL || tmp == NULL) {
+    free(jobs);
+    free(tmp);
+    return E_MALLOC_FAIL;
+  }
+  for (size_t i = 0; i < seq_list->n; i++) {
+    double n = (double)seq_list->sequences[i]->n;
+    double span = n;
+    if (config->max_precursor_length > 0 &&
+        config->max_precursor_length < span) {
+      span = config->max_precursor_length;
+    }
+    jobs[i].cost = n * span * span;
+    jobs[i].index = i;
+  }
+  qsort(jobs, seq_list->n, sizeof(struct fold_job), compare_fold_jobs);
+  for (size_t i = 0; i < seq_list->n; i++) {
+    tmp[i] = jobs[i].index;
+  }
+  free(jobs);
+  *order = tmp;
+  return E_SUCCESS;
+}
+
+/* Decreasing cost, sequences of the same cost stay in their order. */
+static int compare_fold_jobs(const void *a, const void *b) {
+  const struct fold_job *j1 = (const struct fold_job *)a;
+  const struct fold_job *j2 = (const struct fold_job *)b;
+  if (j1->cost != j2->cost) {
+    return j1->cost > j2->cost ? -1 : 1;
+  }
+  if (j1->index != j2->index) {
+    return j1->index < j2->index ? -1 : 1;
+  }
+  return 0;
+}
+
+/* Sets the structure of the sequence, and its mfe distribution if it was
+ * computed before, from the cache. */
+static int restore_cached_fold(struct fold_cache *cache,
+                               struct fold_cache_key *key,
+                               struct foldable_sequence *fs,
+                               int *has_distribution) {
+  struct cached_fold *fold = NULL;
+  int err = find_cached_fold(cache, key, &fold);
+  if (err) {
+    return err;
+  }
+  *has_distribution = 0;
+  fs->structure = NULL;
+  if (fold->structure_string == NULL) {
+    return E_SUCCESS;
+  }
+  struct structure_info *si =
+      (struct structure_info *)malloc(sizeof(struct structure_info));
+  if (si == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  size_t n = strlen(fold->structure_string);
+  si->structure_string = (char *)malloc((n + 1) * sizeof(char));
+  if (si->structure_string == NULL) {
+    free(si);
+    return E_MALLOC_FAIL;
+  }
+  memcpy(si->structure_string, fold->structure_string, n + 1);
+  si->n = n;
+  si->start = fold->start;
+  si->mfe = fold->mfe;
+  si->has_distribution = fold->has_distribution;
+  si->mean = fold->mean;
+  si->sd = fold->sd;
+  si->pvalue = fold->pvalue;
+  si->permutation_count = fold->permutation_count;
+  fs->structure = si;
+  *has_distribution = fold->has_distribution;
+  return E_SUCCESS;
+}
+
+static int store_cached_fold(struct fold_cache *cache,
+                             struct fold_cache_key *key,
+                             struct foldable_sequence *fs) {
+  struct cached_fold fold;
+  struct structure_info *si = fs->structure;
+  fold.key = *key;
+  fold.structure_string = NULL;
+  fold.start = 0;
+  fold.mfe = 0.0;
+  fold.has_distribution = 0;
+  fold.mean = 0.0;
+  fold.sd = 0.0;
+  fold.pvalue = 0.0;
+  fold.permutation_count = 0;
+  if (si != NULL) {
+    fold.structure_string = si->structure_string;
+    fold.start = si->start;
+    fold.mfe = si->mfe;
+    fold.has_distribution = si->has_distribution;
+    fold.mean = si->mean;
+    fold.sd = si->sd;
+    fold.pvalue = si->pvalue;
+    fold.permutation_count = si->permutation_count;
+  }
+  return add_cached_fold(cache, &fold);
+}
+
 int write_json_result(struct sequence_list *seq_list, char *filename) {
   FILE *fp = fopen(filename, "w");
   if (fp == NULL) {
@@ -361,20 +672,83 @@ int write_json_result(struct sequence_list *seq_list, char *filename) {
     if (seq_list->sequences[i]->structure->is_valid == 0) {
       continue;
     }
-    write_foldable_sequence(fp, seq_list->sequences[i]);
+    write_foldable_sequence(fp, seq_list->sequences[i],
+                            seq_list->chromosomes);
     fprintf(fp, ",\n");
   }
-  write_foldable_sequence(fp, seq_list->sequences[seq_list->n - 1]);
+  write_foldable_sequence(fp, seq_list->sequences[seq_list->n - 1],
+                          seq_list->chromosomes);
   fprintf(fp, "}");
   fclose(fp);
   return E_SUCCESS;
 }
 
+/* Decides whether the p-value estimated from the first n permutations is
+ * below or above max_pvalue with an error probability of at most error for
+ * this one look. The uncertainty of the z-value is taken from the standard
+ * errors of the mean and standard deviation of the permuted energies. */
+static int is_pvalue_decided(double *mfe_list, int n, double mfe,
+                             double max_pvalue, double error) {
+  double mfe_mean = mean(mfe_list, n);
+  double mfe_sd = sd(mfe_list, n, mfe_mean);
+  if (mfe_sd <= 0.0) {
+    return 0;
+  }
+  double z = fabs(mfe - mfe_mean) / mfe_sd;
+  double z_se = sqrt(1.0 / n + z * z / (2.0 * (n - 1)));
+  double z_error = normal_quantile(error / 2.0) * z_se;
+  double upper = erfc(fmax(z - z_error, 0.0) / sqrt(2)) / 2.0;
+  double lower = erfc((z + z_error) / sqrt(2)) / 2.0;
+  return upper < max_pvalue || lower >= max_pvalue;
+}
+
+/* Folds permutations of the sequence to estimate the null distribution of the
+ * mfe. With a permutation_error the permutation test stops as soon as the
+ * p-value is known to be on one side of max_pvalue. If a cache is given, the
+ * distribution of a sequence of similar length and composition read from it
+ * is reused.
+ * The batches of permutations are folded as tasks, so the threads of the team
+ * that have nothing else to do help, with the context of the thread that
+ * runs the task. */
 int calculate_mfe_distribution(struct foldable_sequence *fs,
-                               int permutation_count) {
+                               struct configuration_params *config,
+                               struct fold_context **contexts,
+                               struct null_model_cache *cache) {
+  int permutation_count = config->permutation_count;
+  int min_count =
+      config->min_permutation_count > 2 ? config->min_permutation_count : 2;
+  /* Without the stopping rule all permutations are folded in one round.
+   * With it the first round holds min_count permutations and every further
+   * one a single batch, so at most a batch is folded after the decision,
+   * whatever the size of the team. */
+  int is_sequential = config->permutation_error > 0.0;
+  int first_round = is_sequential ? min_count : permutation_count;
+  int round_count = FOLD_BATCH_LANES;
+  if (first_round > round_count) {
+    round_count = first_round;
+  }
+  if (round_count > permutation_count && permutation_count > 0) {
+    round_count = permutation_count;
+  }
   if (fs->structure == NULL) {
     return E_NO_STRUCTURE;
   }
+  struct structure_info *si = fs->structure;
+  if (cache != NULL) {
+    double cached_mean;
+    double cached_sd;
+    int err;
+#pragma omp critical(null_model_cache)
+    err = find_null_model(cache, fs->seq, fs->n - 1, permutation_count,
+                          &cached_mean, &cached_sd);
+    if (err == E_SUCCESS) {
+      si->mean = cached_mean;
+      si->sd = cached_sd;
+      si->pvalue = pvalue(cached_mean, cached_sd, si->mfe);
+      si->permutation_count = 0;
+      return E_SUCCESS;
+    }
+  }
   char *seq_copy = (char *)malloc((fs->n) * sizeof(char));
   if (seq_copy == NULL) {
     return E_MALLOC_FAIL;
@@ -384,36 +758,127 @@ int calculate_mfe_distribution(struct foldable_sequence *fs,
     free(seq_copy);
     return E_MALLOC_FAIL;
   }
-  char *tmp = (char *)malloc((fs->n) * sizeof(char));
-  if (tmp == NULL) {
+  /* the shuffles are folded together, one per lane of fold_batch */
+  char *shuffles = (char *)malloc(round_count * (fs->n) * sizeof(char));
+  const char **batch = (const char **)malloc(round_count * sizeof(char *));
+  float *energies = (float *)malloc(round_count * sizeof(float));
+  if (shuffles == NULL || batch == NULL || energies == NULL) {
     free(seq_copy);
     free(mfe_list);
+    free(shuffles);
+    free(batch);
+    free(energies);
     return E_MALLOC_FAIL;
   }
 
   memcpy(seq_copy, fs->seq, fs->n);
   seq_copy[fs->n - 1] = 0;
 
-  for (int i = 0; i < permutation_count; i++) {
-    fisher_yates_shuffle(seq_copy, fs->n - 1);
-    mfe_list[i] = fold(seq_copy, tmp) / fs->n;
+  /* the shuffles are folded with the span limit of the candidate's fold */
+  int max_length = fs->n;
+  if (config->max_precursor_length > 0 &&
+      config->max_precursor_length < max_length) {
+    max_length = config->max_precursor_length;
   }
 
-  struct structure_info *si = fs->structure;
-  double mfe_mean = mean(mfe_list, permutation_count);
-  double mfe_sd = sd(mfe_list, permutation_count, mfe_mean);
+  /* every cluster has its own random stream, so the permutations do not
+   * depend on the order or the thread the clusters are folded in */
+  struct random_state rng;
+  seed_random(&rng, (u64)config->random_seed,
+              2 * fs->c->id + (fs->c->strand == '-'));
+
+  /* the rule looks after every permutation from min_count on, the error is
+   * split over the looks (Bonferroni) so that it bounds the whole test */
+  double look_error = config->permutation_error;
+  if (permutation_count >= min_count) {
+    look_error /= permutation_count - min_count + 1;
+  }
+  int n = 0;
+  int is_decided = 0;
+  while (n < permutation_count && !is_decided) {
+    int shuffle_count = permutation_count - n;
+    int round = (n == 0) ? first_round : FOLD_BATCH_LANES;
+    if (shuffle_count > round) {
+      shuffle_count = round;
+    }
+    for (int i = 0; i < shuffle_count; i++) {
+      fisher_yates_shuffle(&rng, seq_copy, fs->n - 1);
+      memcpy(shuffles + i * fs->n, seq_copy, fs->n);
+      batch[i] = shuffles + i * fs->n;
+    }
+    for (int i = 0; i < shuffle_count; i += FOLD_BATCH_LANES) {
+      int batch_size = shuffle_count - i;
+      if (batch_size > FOLD_BATCH_LANES) {
+        batch_size = FOLD_BATCH_LANES;
+      }
+#pragma omp task firstprivate(i, batch_size)
+      fold_batch(thread_context(contexts), batch + i, batch_size, max_length,
+                 energies + i);
+    }
+#pragma omp taskwait
+    /* the stopping rule sees the energies in the order of the shuffles, the
+     * ones after the decision are dropped */
+    for (int i = 0; i < shuffle_count && !is_decided; i++) {
+      mfe_list[n] = energies[i] / fs->n;
+      n++;
+      is_decided = is_sequential && n >= min_count &&
+                   n < permutation_count &&
+                   is_pvalue_decided(mfe_list, n, si->mfe, config->max_pvalue,
+                                     look_error);
+    }
+  }
+
+  double mfe_mean = mean(mfe_list, n);
+  double mfe_sd = sd(mfe_list, n, mfe_mean);
   double mfe_pvalue = pvalue(mfe_mean, mfe_sd, si->mfe);
   si->mean = mfe_mean;
   si->sd = mfe_sd;
   si->pvalue = mfe_pvalue;
+  si->permutation_count = n;
+  /* only complete distributions are cached */
+  if (cache != NULL && n == permutation_count) {
+#pragma omp critical(null_model_cache)
+    add_null_model(cache, fs->seq, fs->n - 1, n, mfe_mean, mfe_sd);
+  }
   free(mfe_list);
-  free(tmp);
+  free(shuffles);
+  free(batch);
+  free(energies);
   free(seq_copy);
 
   return E_SUCCESS;
 }
 
-int find_optimal_structure(struct structure_list *s_list,
+/* Estimates the null distribution of the mfe from the length and nucleotide
+ * composition of the structure's window instead of folding permutations, as
+ * RNALfold -z does. This null differs from the one of the permutations,
+ * which shuffle the whole flanked sequence: the flanks alone are longer than
+ * the range of the models, the window is at most max_precursor_length. */
+int estimate_mfe_distribution(struct foldable_sequence *fs,
+                              struct mfe_models *models) {
+  struct structure_info *si = fs->structure;
+  if (si == NULL) {
+    return E_NO_STRUCTURE;
+  }
+  double mfe_mean;
+  double mfe_sd;
+  if (predict_mfe_distribution(models, fs->seq + si->start - 1, si->n,
+                               &mfe_mean, &mfe_sd) != 0 ||
+      mfe_sd <= 0.0) {
+    return E_OUTSIDE_OF_MODEL_RANGE;
+  }
+  si->mean = mfe_mean / si->n;
+  si->sd = mfe_sd / si->n;
+  si->pvalue = pvalue(si->mean, si->sd, si->mfe);
+  si->permutation_count = 0;
+  return E_SUCCESS;
+}
+
+/* Only the structure that is picked is backtracked. Lfold() drops structures
+ * that are part of the next one, which needs their strings, so it is only
+ * checked for the best ones. */
+int find_optimal_structure(struct fold_context *ctx,
+                           struct structure_list *s_list,
                            struct foldable_sequence *fs,
                            struct configuration_params *config) {
   struct secondary_structure *ss = NULL;
@@ -423,28 +888,48 @@ int find_optimal_structure(struct structure_list *s_list,
   u64 local_core_start = c->start - c->flank_start;
   /* offset due to bed file format */
   u64 local_core_end = c->end - c->flank_start - 1;
-  for (size_t i = 0; i < s_list->n; i++) {
-    ss = s_list->structures[i];
-    /*the string should always be null terminated, if not the library would have
-     * failed already */
-    size_t l = strlen(ss->structure_string);
-    if (ss->start > local_core_start + 1) {
-      continue;
-    }
-    if (ss->start + l - 1 < local_core_end + 1) {
-      continue;
+  char *is_skipped = (char *)calloc(s_list->n + 1, sizeof(char));
+  if (is_skipped == NULL) {
+    return E_MALLOC_FAIL;
+  }
+  for (;;) {
+    size_t best = 0;
+    best_ss = NULL;
+    min_mfe = DBL_MAX;
+    for (size_t i = 0; i < s_list->n; i++) {
+      ss = &s_list->structures[i];
+      size_t l = ss->n;
+      if (is_skipped[i]) {
+        continue;
+      }
+      if (ss->start > local_core_start + 1) {
+        continue;
+      }
+      if (ss->start + l - 1 < local_core_end + 1) {
+        continue;
+      }
+      double mfe_per_bp = ss->mfe / (double)l;
+      if (mfe_per_bp < min_mfe) {
+        best = i;
+        best_ss = ss;
+        min_mfe = mfe_per_bp;
+      }
     }
-    double mfe_per_bp = ss->mfe / (double)l;
-    if (mfe_per_bp < min_mfe) {
-      best_ss = ss;
-      min_mfe = mfe_per_bp;
+    if (best_ss == NULL || !is_contained_structure(ctx, best_ss)) {
+      break;
     }
+    is_skipped[best] = 1;
   }
+  free(is_skipped);
   if (best_ss == NULL) {
     fs->structure = NULL;
     return E_NO_OPTIMAL_STRUCTURE_FOUND;
   }
-  size_t n = strlen(best_ss->structure_string);
+  if (backtrack_secondary_structure(ctx, best_ss)) {
+    fs->structure = NULL;
+    return E_MALLOC_FAIL;
+  }
+  size_t n = best_ss->n;
   fs->structure =
       (struct structure_info *)malloc(sizeof(struct structure_info));
   if (fs->structure == NULL) {
@@ -463,6 +948,8 @@ int find_optimal_structure(struct structure_list *s_list,
   fs->structure->n = n;
   fs->structure->start = best_ss->start;
   fs->structure->mfe = min_mfe;
+  fs->structure->has_distribution = 0;
+  fs->structure->permutation_count = 0;
 
   return E_SUCCESS;
 }
@@ -504,7 +991,8 @@ int check_pvalue(struct foldable_sequence *fs,
   return E_SUCCESS;
 }
 
-int write_foldable_sequence(FILE *fp, struct foldable_sequence *fs) {
+int write_foldable_sequence(FILE *fp, struct foldable_sequence *fs,
+                            struct chromosome_dict *chromosomes) {
   if (fp == NULL) {
     fp = stdout;
   }
@@ -534,7 +1022,8 @@ int write_foldable_sequence(FILE *fp, struct foldable_sequence *fs) {
 
   fprintf(fp, "\"Cluster_%lld_%s\":{\n", c->id,
           (c->strand == '-') ? "minus" : "plus");
-  fprintf(fp, "\t\"chromosome\":\"%s\",\n", c->chrom);
+  fprintf(fp, "\t\"chromosome\":\"%s\",\n",
+          chromosomes->names[c->chrom_id]);
   fprintf(fp, "\t\"structure_start\":%ld,\n", structure_start);
   fprintf(fp, "\t\"structure_end\":%ld,\n", structure_end);
   fprintf(fp, "\t\"structure_length\":%ld,\n", si->n);
@@ -554,6 +1043,7 @@ int write_foldable_sequence(FILE *fp, struct foldable_sequence *fs) {
   fprintf(fp, "\t\"mfe_precise\":%8lf,\n", si->mfe);
   fprintf(fp, "\t\"z_value\":%7.5lf,\n", (si->mfe - si->mean) / si->sd);
   fprintf(fp, "\t\"p_value\":%7.5le,\n", si->pvalue);
+  fprintf(fp, "\t\"permutations\":%d,\n", si->permutation_count);
   fprintf(fp, "}");
   return E_SUCCESS;
 }
@@ -570,22 +1060,22 @@ int reverse_complement(struct foldable_sequence *s) {
 }
 
 /* Generates a uniformly distributed random integer in the range [0,max) */
-int get_rand_int(int max) {
+int get_rand_int(struct random_state *state, int max) {
   /* make sure the random the possible amount of random numbers is a mutiple of
    * max to get a uniform distribution */
-  int limit = RAND_MAX - RAND_MAX % max;
-  int random_number;
+  u64 limit = UINT64_MAX - UINT64_MAX % (u64)max;
+  u64 random_number;
   do {
-    random_number = rand();
+    random_number = next_random(state);
   } while (random_number >= limit);
-  return random_number % max;
+  return (int)(random_number % (u64)max);
 }
 
-int fisher_yates_shuffle(char *seq, int n) {
+int fisher_yates_shuffle(struct random_state *state, char *seq, int n) {
   int j;
   char tmp;
   for (int i = n - 1; i > 0; i--) {
-    j = get_rand_int(i + 1);
+    j = get_rand_int(state, i + 1);
     tmp = seq[j];
     seq[j] = seq[i];
     seq[i] = tmp;
@@ -5,6 +5,10 @@
 #include <stdio.h>
 #include "cluster.h"
 #include "Lfold/Lfold.h"
+#include "Lfold/fold_batch.h"
+#include "Lfold/svm_regression.h"
+#include "null_model.h"
+#include "fold_cache.h"
 #include "fasta.h"
 #include "util.h"
 
@@ -16,6 +20,8 @@ struct structure_info {
   double pvalue;
   double mean;
   double sd;
+  int has_distribution;
+  int permutation_count;
   int external_loop_count;
   double paired_fraction;
   int stem_start;
@@ -35,6 +41,7 @@ struct foldable_sequence {
 struct sequence_list {
   struct foldable_sequence **sequences;
   size_t n;
+  struct chromosome_dict *chromosomes;
 };
 
 int vfold(int argc, char **argv);
@@ -44,20 +51,28 @@ int map_clusters(struct sequence_list **seq_list, struct cluster_list *c_list,
                  struct genome_sequence *seq_table);
 int fold_sequences(struct sequence_list *seq_list,
                    struct configuration_params *config);
+int get_fold_order(struct sequence_list *seq_list,
+                   struct configuration_params *config, size_t **order);
 int write_json_result(struct sequence_list *seq_list, char *filename);
 int calculate_mfe_distribution(struct foldable_sequence *fs,
-                               int permutation_count);
-int find_optimal_structure(struct structure_list *s_list,
+                               struct configuration_params *config,
+                               struct fold_context **contexts,
+                               struct null_model_cache *cache);
+int estimate_mfe_distribution(struct foldable_sequence *fs,
+                              struct mfe_models *models);
+int find_optimal_structure(struct fold_context *ctx,
+                           struct structure_list *s_list,
                            struct foldable_sequence *fs,
                            struct configuration_params *config);
 int check_folding_constraints(struct foldable_sequence *fs,
                               struct configuration_params *config);
 int check_pvalue(struct foldable_sequence *fs,
                  struct configuration_params *config);
-int write_foldable_sequence(FILE *fp, struct foldable_sequence *fs);
+int write_foldable_sequence(FILE *fp, struct foldable_sequence *fs,
+                            struct chromosome_dict *chromosomes);
 int reverse_complement(struct foldable_sequence *s);
-int get_rand_int(int max);
-int fisher_yates_shuffle(char *seq, int n);
+int get_rand_int(struct random_state *state, int max);
+int fisher_yates_shuffle(struct random_state *state, char *seq, int n);
 int free_structure_info(struct structure_info *info);
 int free_sequence_list(struct sequence_list *seq_list);
 int free_foldable_sequence(struct foldable_sequence *s);
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../src/Lfold/Lfold.h"
+#include "../src/Lfold/fold_context.h"
+#include "../src/Lfold/fold_vars.h"
+
+/* Times Lfold() with the dense and the sparse multiloop decomposition on
+ * random sequences, with the span of the default and the animal
+ * configuration, and Lfold() for every energy model it has a kernel
+ * instance for. Run with make bench. */
+
+static void random_sequence(char *seq, int n) {
+  for (int i = 0; i < n; i++) {
+    seq[i] = "ACGU"[rand() % 4];
+  }
+  seq[n] = 0;
+}
+
+/* milliseconds of the fastest Lfold() call, the slower ones are disturbed
+ * by the rest of the machine */
+static double time_lfold(struct fold_context *ctx, const char *seq,
+                         int maxdist, int repetitions, float *energy) {
+  double fastest = 0;
+  for (int r = 0; r < repetitions; r++) {
+    struct structure_list *s_list = NULL;
+    clock_t start = clock();
+    *energy = Lfold(ctx, &s_list, seq, maxdist);
+    double ms = 1000.0 * (double)(clock() - start) / CLOCKS_PER_SEC;
+    free_structure_list(s_list);
+    if (r == 0 || ms < fastest) {
+      fastest = ms;
+    }
+  }
+  return fastest;
+}
+
+int main(void) {
+  const int lengths[] = {250, 500, 1000, 2000};
+  const int spans[] = {0, 200}; /* 0: the whole sequence */
+  const int length_count = sizeof(lengths) / sizeof(lengths[0]);
+  const int span_count = sizeof(spans) / sizeof(spans[0]);
+  struct fold_context *dense = NULL;
+  struct fold_context *sparse = NULL;
+  if (create_fold_context(&dense) != 0 || create_fold_context(&sparse) != 0) {
+    return 1;
+  }
+  sparse->sparse_ml = 1;
+  srand(1);
+
+  printf("%8s %8s %12s %12s %8s\n", "length", "maxdist", "dense ms",
+         "sparse ms", "speedup");
+  for (int l = 0; l < length_count; l++) {
+    int n = lengths[l];
+    char *seq = (char *)malloc((n + 1) * sizeof(char));
+    if (seq == NULL) {
+      return 1;
+    }
+    random_sequence(seq, n);
+    for (int s = 0; s < span_count; s++) {
+      int maxdist = (spans[s] > 0 && spans[s] < n) ? spans[s] : n;
+      int repetitions = (maxdist <= 500) ? 5 : 1;
+      float dense_energy = 0;
+      float sparse_energy = 0;
+      double dense_ms =
+          time_lfold(dense, seq, maxdist, repetitions, &dense_energy);
+      double sparse_ms =
+          time_lfold(sparse, seq, maxdist, repetitions, &sparse_energy);
+      printf("%8d %8d %12.1f %12.1f %7.2fx%s\n", n, maxdist, dense_ms,
+             sparse_ms, dense_ms / sparse_ms,
+             (dense_energy == sparse_energy) ? "" : "  energies differ");
+    }
+    free(seq);
+  }
+  free_fold_context(dense);
+  free_fold_context(sparse);
+
+  /* the energy model is fixed when a context gets its parameters */
+  const int n = 500;
+  char *seq = (char *)malloc((n + 1) * sizeof(char));
+  if (seq == NULL) {
+    return 1;
+  }
+  random_sequence(seq, n);
+  printf("\n%8s %8s %8s %12s %12s\n", "length", "dangles", "gquad",
+         "maxdist 200", "maxdist 500");
+  for (int d = 0; d <= 3; d++) {
+    for (int g = 0; g <= 1; g++) {
+      struct fold_context *ctx = NULL;
+      if (create_fold_context(&ctx) != 0) {
+        return 1;
+      }
+      ctx->sparse_ml = 1;
+      dangles = d;
+      gquad = g;
+      float energy = 0;
+      double window_ms = time_lfold(ctx, seq, 200, 10, &energy);
+      double whole_ms = time_lfold(ctx, seq, n, 10, &energy);
+      printf("%8d %8d %8d %12.1f %12.1f\n", n, d, g, window_ms, whole_ms);
+      free_fold_context(ctx);
+    }
+  }
+  free(seq);
+  return 0;
+}
@@ -6,6 +6,10 @@
 #include "test_fasta.h"
 #include "test_util.h"
 #include "test_vfold.h"
+#include "test_reads.h"
+#include "test_coverage.h"
+#include "test_null_model.h"
+#include "test_fold_cache.h"
 
 int main(int argc, char const *argv[]) {
   struct test_suite *s = NULL;
@@ -14,6 +18,9 @@ int main(int argc, char const *argv[]) {
   suite_add_test(s, test_header_line);
   suite_add_test(s, test_invalid_line);
   suite_add_test(s, test_multiple_consecutive_tabs);
+  suite_add_test(s, test_sam_view_long_line);
+  suite_add_test(s, test_chromosome_dict_sort);
+  suite_add_test(s, test_sam_reader_pipe);
   suite_add_test(s, test_sort_clusters);
   suite_add_test(s, test_merge_clusters);
   suite_add_test(s, test_filter_clusters);
@@ -21,13 +28,28 @@ int main(int argc, char const *argv[]) {
   suite_add_test(s, test_valid_bed_line);
   suite_add_test(s, test_invalid_start_bed_line);
   suite_add_test(s, test_invalid_id_bed_line);
+  suite_add_test(s, test_old_candidate_line);
   suite_add_test(s, test_strip_newlines);
   suite_add_test(s, test_read_fasta_file);
   suite_add_test(s, test_reverse_complement);
+  suite_add_test(s, test_mfe_regression);
+  suite_add_test(s, test_fold_batch);
+  suite_add_test(s, test_banded_fold_batch);
+  suite_add_test(s, test_sparse_fold);
+  suite_add_test(s, test_lazy_backtrack);
+  suite_add_test(s, test_core_constrained_fold);
+  suite_add_test(s, test_regression_fold);
+  suite_add_test(s, test_fold_order);
   suite_add_test(s, test_mean);
   suite_add_test(s, test_sd);
   suite_add_test(s, test_pvalue);
+  suite_add_test(s, test_normal_quantile);
+  suite_add_test(s, test_random_streams);
   suite_add_test(s, test_config_parsing);
+  suite_add_test(s, test_unique_read_list);
+  suite_add_test(s, test_coverage_track);
+  suite_add_test(s, test_null_model_cache);
+  suite_add_test(s, test_fold_cache);
   // suite_add_test(s, test_folding);
   suite_run_all_tests(s);
   free_suite(s);
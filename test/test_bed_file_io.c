@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <string.h>
 #include "../src/bed.h"
+#include "../src/candidates.h"
+#include "../src/chromosomes.h"
 #include "../src/cluster.h"
 #include "../src/errors.h"
 
@@ -12,15 +14,21 @@ void test_valid_bed_line(struct test *t) {
       "scaffold_1\t186203\t186647\tCluster_0\t0\t+\t186403\t186447\t0\t"
       "90\n";
   struct cluster *c = NULL;
-  int result = parse_bed_line(&c, sample_line);
+  struct chromosome_dict *chromosomes = NULL;
+  create_chromosome_dict(&chromosomes);
+  int result = parse_bed_line(&c, sample_line, chromosomes);
   t_assert_msg(t, result == E_SUCCESS, "parsing failed");
-  if (result != E_SUCCESS)
+  if (result != E_SUCCESS) {
+    free_chromosome_dict(chromosomes);
     return;
-  t_assert_msg(t, strcmp(c->chrom, "scaffold_1") == 0, "Chromsome read wrong");
+  }
+  t_assert_msg(t, strcmp(chromosomes->names[c->chrom_id], "scaffold_1") == 0,
+               "Chromsome read wrong");
   t_assert_msg(t, c->end == 186447, "Cluster end wrong");
   t_assert_msg(t, c->id == 0, "Cluster Id wrong");
   t_assert_msg(t, c->strand == '+', "Strand wrong");
   free_cluster(c);
+  free_chromosome_dict(chromosomes);
 }
 
 void test_invalid_start_bed_line(struct test *t) {
@@ -29,8 +37,11 @@ void test_invalid_start_bed_line(struct test *t) {
       "scaffold_1\t186v203\t186647\tCluster_0\t0\t+\t186403\t186447\t0\t"
       "90\n";
   struct cluster *c = NULL;
-  int result = parse_bed_line(&c, sample_line);
+  struct chromosome_dict *chromosomes = NULL;
+  create_chromosome_dict(&chromosomes);
+  int result = parse_bed_line(&c, sample_line, chromosomes);
   t_assert_msg(t, result == E_INVALID_BED_LINE, "Invalid line got parsed");
+  free_chromosome_dict(chromosomes);
 }
 
 void test_invalid_id_bed_line(struct test *t) {
@@ -39,6 +50,41 @@ void test_invalid_id_bed_line(struct test *t) {
       "scaffold_1\t186203\t186647\tClusterino_0\t0\td\t186403\t186447\t0\t"
       "90\n";
   struct cluster *c = NULL;
-  int result = parse_bed_line(&c, sample_line);
+  struct chromosome_dict *chromosomes = NULL;
+  create_chromosome_dict(&chromosomes);
+  int result = parse_bed_line(&c, sample_line, chromosomes);
   t_assert_msg(t, result == E_INVALID_BED_LINE, "Invalid line got parsed");
+  free_chromosome_dict(chromosomes);
+}
+
+void test_old_candidate_line(struct test *t) {
+  t_set_msg(t, "Testing reading a candidate line without permutations...");
+  char sample_line[1000] =
+      "Cluster_7_plus\t7\tscaffold_1\t+\t186203\t186647\tGGCAGAUUCC\t"
+      "((....))..\t-2.30000\t1.2000000e-03\t-1.00000e+00\t5.00000e-01\t"
+      "1\t0.80000\t1\t8\t0\t9\n";
+  char short_line[1000] =
+      "Cluster_7_plus\t7\tscaffold_1\t+\t186203\t186647\tGGCAGAUUCC\t"
+      "((....))..\t-2.30000\t1.2000000e-03\t-1.00000e+00\t5.00000e-01\t"
+      "1\t0.80000\t1\t8\t0\n";
+  struct micro_rna_candidate *cand = NULL;
+  struct chromosome_dict *chromosomes = NULL;
+  u32 id;
+  create_chromosome_dict(&chromosomes);
+  add_chromosome_to_dict(chromosomes, "scaffold_1", 10, 1000000, &id);
+  int result = parse_candidate_line(&cand, sample_line, chromosomes);
+  t_assert_msg(t, result == E_SUCCESS, "parsing failed");
+  if (result != E_SUCCESS) {
+    free_chromosome_dict(chromosomes);
+    return;
+  }
+  t_assert_msg(t, cand->id == 7 && cand->chrom_id == id, "Candidate wrong");
+  t_assert_msg(t, cand->stem_end_with_mismatch == 9, "Last column wrong");
+  t_assert_msg(t, cand->permutation_count == 0,
+               "Permutation count not unknown");
+  free_micro_rna_candidate(cand);
+  result = parse_candidate_line(&cand, short_line, chromosomes);
+  t_assert_msg(t, result == E_INVALID_CANDIDATE_LINE,
+               "Line with a missing column accepted");
+  free_chromosome_dict(chromosomes);
 }
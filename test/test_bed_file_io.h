@@ -6,5 +6,6 @@
 void test_valid_bed_line(struct test *t);
 void test_invalid_start_bed_line(struct test *t);
 void test_invalid_id_bed_line(struct test *t);
+void test_old_candidate_line(struct test *t);
 
 #endif
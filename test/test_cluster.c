@@ -5,7 +5,7 @@
 #include "testerino.h"
 
 int create_test_clusters(struct cluster_list **list, int n, char *strands,
-                         char *chromosomes[], long *starts, long *ends,
+                         u32 *chromosomes, long *starts, long *ends,
                          long *reads, long *flank_starts, long *flank_ends) {
   struct cluster_list *tmp =
       (struct cluster_list *)malloc(sizeof(struct cluster_list));
@@ -16,7 +16,7 @@ int create_test_clusters(struct cluster_list **list, int n, char *strands,
   tmp->clusters = clusters;
 
   char default_strand = '+';
-  const char *default_chromosome = "chrom_1";
+  u32 default_chromosome = 0;
   long default_start = 100;
   long default_end = 120;
   long default_reads = 5;
@@ -27,8 +27,7 @@ int create_test_clusters(struct cluster_list **list, int n, char *strands,
     c = (struct cluster *)malloc(sizeof(struct cluster));
     c->id = i;
     c->strand = default_strand;
-    c->chrom = (char *)malloc(21 * sizeof(char));
-    strncpy(c->chrom, default_chromosome, 20);
+    c->chrom_id = default_chromosome;
     c->start = default_start;
     c->end = default_end;
     c->readcount = default_reads;
@@ -38,7 +37,7 @@ int create_test_clusters(struct cluster_list **list, int n, char *strands,
       c->strand = strands[i];
     }
     if (chromosomes != NULL) {
-      strncpy(c->chrom, chromosomes[i], 20);
+      c->chrom_id = chromosomes[i];
     }
     if (starts != NULL) {
       c->start = starts[i];
@@ -131,7 +130,7 @@ void test_merge_extended_clusters(struct test *t) {
   struct cluster *c = NULL;
   for (size_t i = 0; i < list->n; i++) {
     c = list->clusters[i];
-    t_log(t, "%ld %c %s %ld %ld %ld %ld %ld \n", c->id, c->strand, c->chrom,
+    t_log(t, "%ld %c %u %ld %ld %ld %ld %ld \n", c->id, c->strand, c->chrom_id,
           c->start, c->end, c->readcount, c->flank_start, c->flank_end);
   }
   t_assert_msg(t, list->clusters[0]->start == 410, "Merging incorrect");
@@ -0,0 +1,31 @@
+#include "testerino.h"
+#include "../src/coverage.h"
+#include "../src/errors.h"
+
+void test_coverage_track(struct test *t) {
+  t_set_msg(t, "Testing sparse coverage tracks...");
+  struct coverage_track *track = NULL;
+  u64 length = 3 * COVERAGE_CHUNK_SIZE;
+  create_coverage_track(&track, length);
+  u64 boundary = COVERAGE_CHUNK_SIZE;
+  /* crossing the first chunk boundary and running past the chromosome */
+  add_coverage_event(track, boundary - 5, boundary + 5);
+  add_coverage_event(track, boundary - 2, boundary + 1);
+  add_coverage_event(track, length - 4, length + 10);
+  finish_coverage_track(track);
+  t_assert_msg(t, track->chunks[0] != NULL && track->chunks[1] != NULL,
+               "Covered chunks not allocated");
+  u32 window[12];
+  get_coverage_window(window, track, boundary - 6, boundary + 6);
+  t_assert_msg(t, window[0] == 0 && window[1] == 1 && window[4] == 2 &&
+                      window[6] == 2 && window[7] == 1 && window[11] == 0,
+               "Coverage window wrong");
+  u64 coverage = 0;
+  get_coverage_in_range(&coverage, track, 0, length);
+  t_assert_msg(t, coverage == 10 + 3 + 4, "Coverage in range wrong");
+  get_coverage_in_range(&coverage, track, boundary, length - 4);
+  t_assert_msg(t, coverage == 5 + 1, "Coverage in partial range wrong");
+  get_coverage_in_range(&coverage, track, boundary - 1, boundary + 1);
+  t_assert_msg(t, coverage == 4, "Coverage across chunks wrong");
+  free_coverage_track(track);
+}
@@ -0,0 +1,8 @@
+#include "testerino.h"
+
+#ifndef TEST_COVERAGE_H
+#define TEST_COVERAGE_H
+
+void test_coverage_track(struct test *t);
+
+#endif
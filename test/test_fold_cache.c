@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "testerino.h"
+#include "../src/fold_cache.h"
+#include "../src/errors.h"
+
+void test_fold_cache(struct test *t) {
+  t_set_msg(t, "Testing the fold cache...");
+  const char *file = "test/data/fold_cache.tmp";
+  char seq[] = "GGCAGATTCCCCCTAGACCCGCCCGCACCATGGTCAGGCATGCCCC";
+  char structure[] = "((((....))))";
+  size_t n = sizeof(seq) - 1;
+  struct configuration_params *config = NULL;
+  initialize_configuration(&config, NULL);
+
+  struct fold_cache_key key, other_core, other_config;
+  get_fold_cache_key(&key, seq, n, 10, 20, config);
+  get_fold_cache_key(&other_core, seq, n, 10, 21, config);
+  struct fold_cache_key with_null_models;
+  strcpy(config->null_model_cache, "null_models.tsv");
+  get_fold_cache_key(&with_null_models, seq, n, 10, 20, config);
+  config->null_model_cache[0] = 0;
+  t_assert_msg(t, key.parameter_hash != with_null_models.parameter_hash,
+               "Null model cache not part of the key");
+  config->permutation_count++;
+  get_fold_cache_key(&other_config, seq, n, 10, 20, config);
+  t_assert_msg(t, key.sequence_hash != other_core.sequence_hash,
+               "Core region not part of the key");
+  t_assert_msg(t, key.sequence_hash == other_config.sequence_hash &&
+                      key.parameter_hash != other_config.parameter_hash,
+               "Configuration not part of the key");
+
+  struct fold_cache *cache = NULL;
+  struct cached_fold fold, *found = NULL;
+  create_fold_cache(&cache);
+  fold.key = key;
+  fold.structure_string = structure;
+  fold.start = 3;
+  fold.mfe = -0.25;
+  fold.has_distribution = 1;
+  fold.mean = -0.1;
+  fold.sd = 0.05;
+  fold.pvalue = 0.001;
+  fold.permutation_count = 20;
+  add_cached_fold(cache, &fold);
+  fold.key = other_core;
+  fold.structure_string = NULL;
+  fold.has_distribution = 0;
+  add_cached_fold(cache, &fold);
+  t_assert_msg(t, find_cached_fold(cache, &other_config, &found) ==
+                      E_FOLD_NOT_CACHED,
+               "Fold with different configuration found");
+
+  write_fold_cache(cache, (char *)file);
+  free_fold_cache(cache);
+  /* a broken line is skipped, the rest of the cache is kept */
+  FILE *fp = fopen(file, "a");
+  fprintf(fp, "not a fold\n");
+  for (int i = 0; i < 20000; i++) {
+    fputc('(', fp);
+  }
+  fprintf(fp, "\n");
+  fclose(fp);
+  create_fold_cache(&cache);
+  t_assert_msg(t, read_fold_cache(cache, (char *)file) == E_SUCCESS,
+               "Invalid lines not skipped");
+  remove(file);
+  t_assert_msg(t, cache->invalid_lines == 2, "Invalid lines not counted");
+  t_assert_msg(t, cache->n == 2, "Reading the cache failed");
+  t_assert_msg(t, find_cached_fold(cache, &key, &found) == E_SUCCESS &&
+                      strcmp(found->structure_string, structure) == 0 &&
+                      found->start == 3 && found->mfe == -0.25 &&
+                      found->has_distribution && found->mean == -0.1 &&
+                      found->sd == 0.05 && found->pvalue == 0.001 &&
+                      found->permutation_count == 20,
+               "Fold changed by writing and reading");
+  t_assert_msg(t, find_cached_fold(cache, &other_core, &found) == E_SUCCESS &&
+                      found->structure_string == NULL &&
+                      !found->has_distribution,
+               "Missing structure changed by writing and reading");
+  free_fold_cache(cache);
+  free(config);
+}
@@ -0,0 +1,8 @@
+#include "testerino.h"
+
+#ifndef TEST_FOLD_CACHE_H
+#define TEST_FOLD_CACHE_H
+
+void test_fold_cache(struct test *t);
+
+#endif
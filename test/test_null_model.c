@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include "testerino.h"
+#include "../src/null_model.h"
+#include "../src/util.h"
+#include "../src/errors.h"
+
+void test_null_model_cache(struct test *t) {
+  t_set_msg(t, "Testing the null model cache...");
+  const char *file = "test/data/null_model_cache.tmp";
+  char seq[] = "GGCAGATTCCCCCTAGACCCGCCCGCACCATGGTCAGGCATGCCCC";
+  char shuffled[] = "CCCCGTACGGACTGGTACCACGCCCGCCCAGATCCCCCTTAGACGG";
+  char at_rich[] = "AUAUUAAUAUUAUAAUUAUAAUAUAUUAAAUAUAUUAUAUUGCAUA";
+  size_t n = sizeof(seq) - 1;
+  double mean, sd;
+  struct configuration_params *config = NULL;
+  initialize_configuration(&config, NULL);
+  struct null_model_cache *cache = NULL;
+  create_null_model_cache(&cache, config);
+  add_null_model(cache, seq, n, 100, -0.3, 0.02);
+  t_assert_msg(t, find_null_model(cache, seq, n, 100, &mean, &sd) ==
+                      E_NULL_MODEL_NOT_FOUND,
+               "Model of the same run used");
+
+  write_null_model_cache(cache, (char *)file);
+  free_null_model_cache(cache);
+  create_null_model_cache(&cache, config);
+  read_null_model_cache(cache, (char *)file);
+  t_assert_msg(t, cache->n == 1, "Reading the cache failed");
+  t_assert_msg(t, find_null_model(cache, shuffled, n, 100, &mean, &sd) ==
+                      E_SUCCESS,
+               "Permuted sequence not found");
+  t_assert_msg(t, mean == -0.3 && sd == 0.02,
+               "Null model changed by writing and reading");
+  t_assert_msg(t, find_null_model(cache, shuffled, n, 200, &mean, &sd) ==
+                      E_NULL_MODEL_NOT_FOUND,
+               "Null model with too few permutations used");
+  t_assert_msg(t, find_null_model(cache, at_rich, n, 100, &mean, &sd) ==
+                      E_NULL_MODEL_NOT_FOUND,
+               "Different composition found");
+
+  /* models of as many permutations merge to the same one in any order */
+  add_null_model(cache, seq, n, 200, -0.2, 0.03);
+  add_null_model(cache, seq, n, 200, -0.4, 0.01);
+  add_null_model(cache, shuffled, n, 200, -0.1, 0.01);
+  find_null_model(cache, seq, n, 100, &mean, &sd);
+  t_assert_msg(t, mean == -0.3, "Read model replaced during the run");
+  t_assert_msg(t, write_null_model_cache(cache, "test/data/missing/cache") ==
+                      E_FILE_WRITING_FAILED,
+               "Failed write not reported");
+  write_null_model_cache(cache, (char *)file);
+  free_null_model_cache(cache);
+  /* a broken line is skipped, the rest of the cache is kept */
+  FILE *fp = fopen(file, "a");
+  fprintf(fp, "not a null model\n");
+  for (int i = 0; i < 2000; i++) {
+    fputc('1', fp);
+  }
+  fprintf(fp, "\n");
+  fclose(fp);
+  create_null_model_cache(&cache, config);
+  t_assert_msg(t, read_null_model_cache(cache, (char *)file) == E_SUCCESS,
+               "Invalid lines not skipped");
+  t_assert_msg(t, cache->invalid_lines == 2, "Invalid lines not counted");
+  t_assert_msg(t, cache->n == 1 &&
+                      find_null_model(cache, seq, n, 200, &mean, &sd) ==
+                          E_SUCCESS &&
+                      mean == -0.4 && sd == 0.01,
+               "Added models not merged");
+  free_null_model_cache(cache);
+
+  /* the models were folded with another span limit */
+  config->max_precursor_length++;
+  create_null_model_cache(&cache, config);
+  read_null_model_cache(cache, (char *)file);
+  remove(file);
+  t_assert_msg(t, cache->n == 0, "Models of other parameters read");
+  free_null_model_cache(cache);
+  free(config);
+}
@@ -0,0 +1,8 @@
+#include "testerino.h"
+
+#ifndef TEST_NULL_MODEL_H
+#define TEST_NULL_MODEL_H
+
+void test_null_model_cache(struct test *t);
+
+#endif
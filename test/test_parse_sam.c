@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include "../src/parse_sam.h"
 #include "../src/errors.h"
 
@@ -62,4 +63,79 @@ void test_multiple_consecutive_tabs(struct test *t) {
   t_assert_msg(t, strcmp(test_entry->seq, "GCCACCCATGCCGCATCCACA") == 0,
                "Sequence parsed wrong");
   free_sam_entry(test_entry);
-}
\ No newline at end of file
+}
+
+void test_sam_view_long_line(struct test *t) {
+  t_set_msg(t, "Testing reading a Sam line longer than a line buffer...");
+  const size_t seq_length = 5000;
+  const char *prefix = "Seq1_x1\t0\tscaffold_1\t67\t0\t21M\t*\t0\t0\t";
+  size_t prefix_length = strlen(prefix);
+  size_t n = prefix_length + 2 * seq_length + 1;
+  char *sample_line = (char *)malloc(n + 1);
+  memcpy(sample_line, prefix, prefix_length);
+  memset(sample_line + prefix_length, 'A', seq_length);
+  sample_line[prefix_length + seq_length] = '\t';
+  memset(sample_line + prefix_length + seq_length + 1, 'I', seq_length);
+  /* the view must not read past n */
+  sample_line[n] = 'X';
+  struct sam_view view;
+  int result = parse_sam_view(&view, sample_line, n);
+  t_assert_msg(t, result == E_SUCCESS, "Parsing the line failed");
+  t_assert_msg(t, view.pos == 67, "Position parsed wrong");
+  t_assert_msg(t, view.fields[SAM_SEQ].n == seq_length,
+               "Sequence parsed wrong");
+  t_assert_msg(t, view.fields[SAM_QUAL].n == seq_length,
+               "Quality parsed wrong");
+  t_assert_msg(t, sam_field_equals(&view.fields[SAM_RNAME], "scaffold_1"),
+               "Reference name parsed wrong");
+  free(sample_line);
+}
+
+void test_chromosome_dict_sort(struct test *t) {
+  t_set_msg(t, "Testing interning and sorting chromosome names...");
+  struct chromosome_dict *dict = NULL;
+  u32 id_b = 0;
+  u32 id_a = 0;
+  u32 id = 0;
+  create_chromosome_dict(&dict);
+  add_chromosome_to_dict(dict, "scaffold_2xyz", 10, 200, &id_b);
+  add_chromosome_to_dict(dict, "scaffold_1", 10, 100, &id_a);
+  add_chromosome_to_dict(dict, "scaffold_2", 10, 0, &id);
+  t_assert_msg(t, dict->n == 2, "Chromosome added twice");
+  t_assert_msg(t, id == id_b, "Known chromosome got a new id");
+  sort_chromosome_dict(dict);
+  int result = find_chromosome_id(dict, "scaffold_1", 10, &id_a);
+  t_assert_msg(t, result == E_SUCCESS, "Chromosome not found after sorting");
+  find_chromosome_id(dict, "scaffold_2", 10, &id_b);
+  t_assert_msg(t, id_a < id_b, "Ids not in name order");
+  t_assert_msg(t, dict->lengths[id_b] == 200, "Length not moved with name");
+  result = find_chromosome_id(dict, "scaffold_3", 10, &id);
+  t_assert_msg(t, result == E_CHROMOSOME_NOT_FOUND, "Unknown chromosome found");
+  free_chromosome_dict(dict);
+}
+
+void test_sam_reader_pipe(struct test *t) {
+  t_set_msg(t, "Testing reading a Sam file from a pipe...");
+  const char *content = "@SQ\tSN:scaffold_1\tLN:100\n"
+                        "Seq1_x1\t0\tscaffold_1\t67\t0\t4M\t*\t0\t0\tACGT"
+                        "\tIIII\n";
+  int fds[2];
+  t_assert_msg(t, pipe(fds) == 0, "Creating the pipe failed");
+  /* fits into the pipe buffer, so the writer does not block */
+  ssize_t written = write(fds[1], content, strlen(content));
+  close(fds[1]);
+  t_assert_msg(t, written == (ssize_t)strlen(content), "Writing failed");
+  char file[32];
+  snprintf(file, sizeof(file), "/dev/fd/%d", fds[0]);
+  struct sam_reader *reader = NULL;
+  int result = open_sam_reader(&reader, file);
+  t_assert_msg(t, result == E_SUCCESS, "Opening the pipe failed");
+  struct sam_field line;
+  int lines = 0;
+  while (next_sam_line(reader, &line)) {
+    lines++;
+  }
+  t_assert_msg(t, lines == 2, "Lines of the pipe not read");
+  close_sam_reader(reader);
+  close(fds[0]);
+}
@@ -3,4 +3,7 @@
 void test_valid_line(struct test *t);
 void test_header_line(struct test *t);
 void test_invalid_line(struct test *t);
-void test_multiple_consecutive_tabs(struct test *t);
\ No newline at end of file
+void test_multiple_consecutive_tabs(struct test *t);
+void test_sam_view_long_line(struct test *t);
+void test_chromosome_dict_sort(struct test *t);
+void test_sam_reader_pipe(struct test *t);
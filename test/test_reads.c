@@ -0,0 +1,31 @@
+#include "testerino.h"
+#include <stdio.h>
+#include <string.h>
+#include "../src/reads.h"
+#include "../src/errors.h"
+
+void test_unique_read_list(struct test *t) {
+  t_set_msg(t, "Testing aggregating unique reads...");
+  struct unique_read_list *ur_list = NULL;
+  create_unique_read_list(&ur_list);
+  char seq[50];
+  /* enough distinct reads to grow the table a few times */
+  for (int i = 0; i < 100; i++) {
+    snprintf(seq, sizeof(seq), "ACGT%c%c%cACGTACGTACGTACGTACGTACGTACGTAC",
+             "ACGT"[i % 4], "ACGT"[(i / 4) % 4], "ACGT"[(i / 16) % 4]);
+    add_read_to_unique_read_list(ur_list, i / 64, seq);
+    add_read_to_unique_read_list(ur_list, i / 64, seq);
+  }
+  t_assert_msg(t, ur_list->n == 100, "Duplicate reads not merged");
+  t_assert_msg(t, ur_list->reads[99]->count == 2, "Read count wrong");
+  add_read_to_unique_read_list(ur_list, 7, "ACGTN");
+  add_read_to_unique_read_list(ur_list, 7, "ACGTN");
+  add_read_to_unique_read_list(ur_list, 7, "ACGT");
+  add_read_to_unique_read_list(ur_list, 8, "ACGT");
+  t_assert_msg(t, ur_list->n == 103, "Reads with other start or length merged");
+  t_assert_msg(t, ur_list->reads[100]->count == 2,
+               "Reads with unknown bases not merged");
+  t_assert_msg(t, strcmp(ur_list->reads[101]->seq, "ACGT") == 0,
+               "Read order changed");
+  free_unique_read_list(ur_list);
+}
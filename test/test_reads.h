@@ -0,0 +1,8 @@
+#include "testerino.h"
+
+#ifndef TEST_READS_H
+#define TEST_READS_H
+
+void test_unique_read_list(struct test *t);
+
+#endif
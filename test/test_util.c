@@ -27,6 +27,33 @@ void test_pvalue(struct test *t) {
   t_assert_msg(t, fabs(result - 0.023448) < 10e-4, "pvalue function incorrect");
 }
 
+void test_normal_quantile(struct test *t) {
+  t_set_msg(t, "Testing the normal quantile function...");
+  double result = normal_quantile(0.025);
+  t_log(t, "quantile: %lf", result);
+  t_assert_msg(t, fabs(result - 1.959964) < 10e-4,
+               "normal quantile function incorrect");
+  result = normal_quantile(0.5);
+  t_assert_msg(t, fabs(result) < 10e-4, "normal quantile function incorrect");
+}
+
+void test_random_streams(struct test *t) {
+  t_set_msg(t, "Testing the random number streams...");
+  struct random_state a, b, c;
+  seed_random(&a, 42, 7);
+  seed_random(&b, 42, 7);
+  seed_random(&c, 42, 8);
+  int same = 1;
+  int differs = 0;
+  for (int i = 0; i < 100; i++) {
+    u64 x = next_random(&a);
+    same &= x == next_random(&b);
+    differs |= x != next_random(&c);
+  }
+  t_assert_msg(t, same, "Same seed and stream give different numbers");
+  t_assert_msg(t, differs, "Different streams give the same numbers");
+}
+
 void test_config_parsing(struct test *t) {
   t_set_msg(t, "Testing parsing the config file...");
   const char *file = "test/data/test.config";
@@ -66,6 +93,11 @@ void test_config_parsing(struct test *t) {
   t_assert_msg(t, config->min_double_strand_length == -43,
                "min_double_strand_length wrong");
   t_assert_msg(t, config->permutation_count == -44, "permutation_count wrong");
+  t_assert_msg(t, config->min_permutation_count == -49,
+               "min_permutation_count wrong");
+  t_assert_msg(t, config->permutation_error == -0.45,
+               "permutation_error wrong");
+  t_assert_msg(t, config->sparse_folding == -50, "sparse_folding wrong");
   t_assert_msg(t, config->max_pvalue == -0.42, "max_pvalue wrong");
   t_assert_msg(t, config->min_coverage == -0.43, "min_coverage wrong");
   t_assert_msg(t, config->min_paired_fraction == -0.44,
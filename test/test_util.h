@@ -6,6 +6,8 @@
 void test_mean(struct test *t);
 void test_sd(struct test *t);
 void test_pvalue(struct test *t);
+void test_normal_quantile(struct test *t);
+void test_random_streams(struct test *t);
 void test_config_parsing(struct test *t);
 
 #endif
\ No newline at end of file
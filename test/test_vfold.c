@@ -1,5 +1,41 @@
 #include "testerino.h"
 #include "../src/vfold.h"
+#include "../src/Lfold/fold.h"
+#include "../src/Lfold/fold_batch.h"
+#include "../src/Lfold/fold_vars.h"
+#include <math.h>
+
+/* the tests fold prefixes of this sequence */
+static const char test_sequence[] =
+    "GGCAGATTCCCCCTAGACCCGCCCGCACCATGGTCAGGCATGCCCCTCCTCATCGCTGG"
+    "GCACAGCCCAGAGGGTAUUAGCAUAAGCUAUUACGAUUAGGCAGATTCCCCCTAGAC"
+    "CCGCCCGCACCATGGTCAGGCATGCCCCTCCTCATCGCTGGGCACAGCCCAGAGGG";
+
+/* the energy models the folding algorithms are compared under */
+struct fold_model {
+  int dangles;
+  int no_lonely_pairs;
+};
+
+static const struct fold_model fold_models[] = {{2, 0}, {0, 0}, {2, 1}};
+
+#define FOLD_MODEL_COUNT (sizeof(fold_models) / sizeof(fold_models[0]))
+
+/* returns a copy of the first n nucleotides of the test sequence */
+static char *copy_test_sequence(int n) {
+  char *seq = (char *)malloc((n + 1) * sizeof(char));
+  memcpy(seq, test_sequence, n);
+  seq[n] = 0;
+  return seq;
+}
+
+/* sets the energy model of the folding and returns the previous one */
+static struct fold_model set_fold_model(struct fold_model model) {
+  struct fold_model old = {dangles, noLonelyPairs};
+  dangles = model.dangles;
+  noLonelyPairs = model.no_lonely_pairs;
+  return old;
+}
 
 void test_reverse_complement(struct test *t) {
   t_set_msg(t, "Testing reverse complement function...");
@@ -22,6 +58,335 @@ void test_reverse_complement(struct test *t) {
   free(s.seq);
 }
 
+void test_mfe_regression(struct test *t) {
+  t_set_msg(t, "Testing the mfe regression model...");
+  char *testseq = copy_test_sequence(98);
+  const int permutation_count = 200;
+  int n = strlen(testseq);
+  struct mfe_models *models = NULL;
+  t_assert_msg(t, create_mfe_models(&models) == 0, "Loading the models failed");
+
+  double predicted_mean, predicted_sd;
+  t_assert_msg(t, predict_mfe_distribution(models, testseq, n, &predicted_mean,
+                                           &predicted_sd) == 0,
+               "Sequence rejected by the model");
+  t_assert_msg(t, predict_mfe_distribution(models, testseq, 30, &predicted_mean,
+                                           &predicted_sd) != 0,
+               "Too short sequence accepted by the model");
+  predict_mfe_distribution(models, testseq, n, &predicted_mean, &predicted_sd);
+
+  /* the estimate is the null of the structure's window */
+  struct structure_info window;
+  struct foldable_sequence fs;
+  double window_mean, window_sd;
+  window.start = 11;
+  window.n = 60;
+  window.mfe = -0.3;
+  fs.seq = testseq;
+  fs.n = n + 1;
+  fs.structure = &window;
+  predict_mfe_distribution(models, testseq + 10, 60, &window_mean,
+                           &window_sd);
+  t_assert_msg(t, estimate_mfe_distribution(&fs, models) == 0,
+               "Estimating the distribution failed");
+  t_assert_msg(t, fabs(window.mean - window_mean / 60) < 1e-12 &&
+                      fabs(window.sd - window_sd / 60) < 1e-12,
+               "Estimate not of the structure's window");
+
+  struct fold_context *ctx = NULL;
+  create_fold_context(&ctx);
+  char *seq = (char *)malloc((n + 1) * sizeof(char));
+  char *structure = (char *)malloc((n + 1) * sizeof(char));
+  double mfe_list[permutation_count];
+  struct random_state rng;
+  seed_random(&rng, 0, 0);
+  memcpy(seq, testseq, n + 1);
+  for (int i = 0; i < permutation_count; i++) {
+    fisher_yates_shuffle(&rng, seq, n);
+    mfe_list[i] = fold(ctx, seq, structure);
+  }
+  double mfe_mean = mean(mfe_list, permutation_count);
+  double mfe_sd = sd(mfe_list, permutation_count, mfe_mean);
+  t_log(t, "predicted: %lf (%lf) permutations: %lf (%lf)\n", predicted_mean,
+        predicted_sd, mfe_mean, mfe_sd);
+  t_assert_msg(t, fabs(predicted_mean - mfe_mean) < 0.1 * fabs(mfe_mean),
+               "Predicted mean differs from the permutations");
+  t_assert_msg(t, fabs(predicted_sd - mfe_sd) < 0.25 * mfe_sd,
+               "Predicted standard deviation differs from the permutations");
+  free(seq);
+  free(structure);
+  free(testseq);
+  free_fold_context(ctx);
+  free_mfe_models(models);
+}
+
+void test_fold_batch(struct test *t) {
+  t_set_msg(t, "Testing batch folding...");
+  char *testseq = copy_test_sequence(98);
+  const int count = FOLD_BATCH_LANES + 3;
+  int n = strlen(testseq);
+  char *seqs[count];
+  char *structure = (char *)malloc((n + 1) * sizeof(char));
+  float energies[count];
+  struct random_state rng;
+  seed_random(&rng, 0, 0);
+  for (int i = 0; i < count; i++) {
+    seqs[i] = (char *)malloc((n + 1) * sizeof(char));
+    memcpy(seqs[i], testseq, n + 1);
+    fisher_yates_shuffle(&rng, seqs[i], n);
+  }
+  for (size_t m = 0; m < FOLD_MODEL_COUNT; m++) {
+    struct fold_model old_model = set_fold_model(fold_models[m]);
+    struct fold_context *ctx = NULL;
+    create_fold_context(&ctx);
+    for (int i = 0; i < count; i += FOLD_BATCH_LANES) {
+      int batch = (count - i < FOLD_BATCH_LANES) ? count - i
+                                                  : FOLD_BATCH_LANES;
+      fold_batch(ctx, (const char **)seqs + i, batch, 0, energies + i);
+    }
+    for (int i = 0; i < count; i++) {
+      float energy = fold(ctx, seqs[i], structure);
+      t_assert_msg(t, energy == energies[i],
+                   "Batch energy differs from fold()");
+    }
+    free_fold_context(ctx);
+    set_fold_model(old_model);
+  }
+  for (int i = 0; i < count; i++) {
+    free(seqs[i]);
+  }
+  free(structure);
+  free(testseq);
+}
+
+void test_banded_fold_batch(struct test *t) {
+  t_set_msg(t, "Testing span limited batch folding...");
+  char *testseq = copy_test_sequence(116);
+  const int count = FOLD_BATCH_LANES;
+  const int spans[] = {25, 60, 113};
+  int n = strlen(testseq);
+  char *seqs[count];
+  float energies[count];
+  struct random_state rng;
+  seed_random(&rng, 1, 0);
+  for (int i = 0; i < count; i++) {
+    seqs[i] = (char *)malloc((n + 1) * sizeof(char));
+    memcpy(seqs[i], testseq, n + 1);
+    fisher_yates_shuffle(&rng, seqs[i], n);
+  }
+  for (size_t m = 0; m < FOLD_MODEL_COUNT; m++) {
+    struct fold_model old_model = set_fold_model(fold_models[m]);
+    struct fold_context *ctx = NULL;
+    create_fold_context(&ctx);
+    for (size_t k = 0; k < sizeof(spans) / sizeof(spans[0]); k++) {
+      fold_batch(ctx, (const char **)seqs, count, spans[k], energies);
+      for (int i = 0; i < count; i++) {
+        float energy = Lfold_mfe(ctx, seqs[i], spans[k]);
+        t_assert_msg(t, energy == energies[i],
+                     "Batch energy differs from Lfold_mfe()");
+      }
+    }
+    free_fold_context(ctx);
+    set_fold_model(old_model);
+  }
+  for (int i = 0; i < count; i++) {
+    free(seqs[i]);
+  }
+  free(testseq);
+}
+
+void test_sparse_fold(struct test *t) {
+  t_set_msg(t, "Testing sparse multiloop decomposition...");
+  char *testseq = copy_test_sequence(172);
+  int n = strlen(testseq);
+  char *dense_structure = (char *)malloc((n + 1) * sizeof(char));
+  char *sparse_structure = (char *)malloc((n + 1) * sizeof(char));
+  for (size_t m = 0; m < FOLD_MODEL_COUNT; m++) {
+    struct fold_model old_model = set_fold_model(fold_models[m]);
+    struct fold_context *dense = NULL;
+    struct fold_context *sparse = NULL;
+    struct structure_list *dense_list = NULL;
+    struct structure_list *sparse_list = NULL;
+    create_fold_context(&dense);
+    create_fold_context(&sparse);
+    sparse->sparse_ml = 1;
+    float dense_energy = fold(dense, testseq, dense_structure);
+    float sparse_energy = fold(sparse, testseq, sparse_structure);
+    t_assert_msg(t, dense_energy == sparse_energy,
+                 "Sparse energy differs from fold()");
+    t_assert_msg(t, strcmp(dense_structure, sparse_structure) == 0,
+                 "Sparse structure differs from fold()");
+    Lfold(dense, &dense_list, testseq, 100);
+    Lfold(sparse, &sparse_list, testseq, 100);
+    t_assert_msg(t, dense_list->n == sparse_list->n,
+                 "Sparse Lfold() finds other structures");
+    for (size_t i = 0; i < dense_list->n && i < sparse_list->n; i++) {
+      struct secondary_structure *d = &dense_list->structures[i];
+      struct secondary_structure *s = &sparse_list->structures[i];
+      t_assert_msg(t, d->start == s->start && d->n == s->n && d->mfe == s->mfe,
+                   "Sparse structure differs from Lfold()");
+    }
+    free_structure_list(dense_list);
+    free_structure_list(sparse_list);
+    free_fold_context(dense);
+    free_fold_context(sparse);
+    set_fold_model(old_model);
+  }
+  free(dense_structure);
+  free(sparse_structure);
+  free(testseq);
+}
+
+void test_lazy_backtrack(struct test *t) {
+  t_set_msg(t, "Testing backtracking of local structures...");
+  char *testseq = copy_test_sequence(98);
+  struct fold_context *ctx = NULL;
+  struct structure_list *s_list = NULL;
+  create_fold_context(&ctx);
+  /* a window shorter than the sequence */
+  Lfold(ctx, &s_list, testseq, 40);
+  t_assert_msg(t, s_list->n > 0, "No local structure found");
+  for (size_t i = 0; i < s_list->n; i++) {
+    struct secondary_structure *ss = &s_list->structures[i];
+    t_assert_msg(t, ss->structure_string == NULL,
+                 "Structure backtracked before it was asked for");
+    backtrack_secondary_structure(ctx, ss);
+    t_assert_msg(t, (int)strlen(ss->structure_string) == ss->n,
+                 "Backtracked structure has the wrong length");
+    int depth = 0;
+    for (int k = 0; k < ss->n; k++) {
+      depth += (ss->structure_string[k] == '(') -
+               (ss->structure_string[k] == ')');
+      t_assert_msg(t, depth >= 0, "Backtracked structure is not balanced");
+    }
+    t_assert_msg(t, depth == 0, "Backtracked structure is not balanced");
+  }
+  free_structure_list(s_list);
+  free_fold_context(ctx);
+  free(testseq);
+}
+
+void test_core_constrained_fold(struct test *t) {
+  t_set_msg(t, "Testing core constrained local folding...");
+  char *testseq = copy_test_sequence(172);
+  const int cores[][2] = {{60, 80}, {100, 105}, {20, 40}};
+  struct fold_context *ctx = NULL;
+  struct structure_list *all = NULL;
+  struct structure_list *core = NULL;
+  create_fold_context(&ctx);
+  for (size_t k = 0; k < sizeof(cores) / sizeof(cores[0]); k++) {
+    int core_start = cores[k][0];
+    int core_end = cores[k][1];
+    Lfold(ctx, &all, testseq, 50);
+    Lfold_core(ctx, &core, testseq, 50, 0, 0.0, core_start, core_end);
+    size_t n = 0;
+    for (size_t i = 0; i < all->n; i++) {
+      struct secondary_structure *s = &all->structures[i];
+      if (s->start > core_start || s->start + s->n - 1 < core_end) {
+        continue;
+      }
+      t_assert_msg(t, n < core->n, "Structure containing the core missing");
+      if (n >= core->n) {
+        break;
+      }
+      struct secondary_structure *c = &core->structures[n];
+      t_assert_msg(t, c->start == s->start && c->n == s->n && c->mfe == s->mfe,
+                   "Structure differs from Lfold()");
+      n++;
+    }
+    t_assert_msg(t, n == core->n, "Structure not containing the core found");
+    free_structure_list(all);
+    free_structure_list(core);
+  }
+  free_fold_context(ctx);
+  free(testseq);
+}
+
+void test_regression_fold(struct test *t) {
+  t_set_msg(t, "Testing the regression null of a flanked cluster...");
+  const char *stem = "GGCTAGCCATGGCATCGATCGTTAGCGCATGC";
+  const char *loop = "ATTAGCAT";
+  const int flank = 200;
+  int stem_length = strlen(stem);
+  int core_length = 2 * stem_length + strlen(loop);
+  int n = 2 * flank + core_length;
+  const char nucleotides[] = "ACGT";
+  struct random_state rng;
+  struct configuration_params *config = NULL;
+  struct sequence_list seq_list;
+  struct foldable_sequence *sequences[1];
+  struct foldable_sequence *fs =
+      (struct foldable_sequence *)malloc(sizeof(struct foldable_sequence));
+  fs->c = (struct cluster *)malloc(sizeof(struct cluster));
+  fs->seq = (char *)malloc((n + 1) * sizeof(char));
+  fs->n = n + 1;
+  fs->structure = NULL;
+  /* a hairpin in random flanks of the default cluster_flank_size */
+  seed_random(&rng, 0, 0);
+  for (int i = 0; i < n; i++) {
+    fs->seq[i] = nucleotides[get_rand_int(&rng, 4)];
+  }
+  memcpy(fs->seq + flank, stem, stem_length);
+  memcpy(fs->seq + flank + stem_length, loop, strlen(loop));
+  char *paired = (char *)malloc((stem_length + 1) * sizeof(char));
+  reverse_complement_sequence(paired, stem, stem_length);
+  memcpy(fs->seq + flank + core_length - stem_length, paired, stem_length);
+  free(paired);
+  fs->seq[n] = 0;
+  fs->c->id = 0;
+  fs->c->strand = '+';
+  fs->c->chrom_id = 0;
+  fs->c->flank_start = 0;
+  fs->c->flank_end = n;
+  fs->c->start = flank;
+  fs->c->end = flank + core_length;
+  fs->c->readcount = 1;
+  sequences[0] = fs;
+  seq_list.sequences = sequences;
+  seq_list.n = 1;
+  seq_list.chromosomes = NULL;
+  initialize_configuration(&config, NULL);
+  config->log_level = LOG_LEVEL_QUIET;
+  config->pvalue_method = PVALUE_REGRESSION;
+  t_assert_msg(t, fold_sequences(&seq_list, config) == 0, "Folding failed");
+  struct structure_info *si = fs->structure;
+  t_assert_msg(t, si != NULL && si->has_distribution,
+               "No distribution for the hairpin");
+  if (si != NULL) {
+    t_log(t, "window: %ld of %ld nt, permutations: %d\n", si->n, fs->n - 1,
+          si->permutation_count);
+    t_assert_msg(t, si->permutation_count == 0,
+                 "Permutations folded instead of the regression");
+  }
+  free_foldable_sequence(fs);
+  free(config);
+}
+
+void test_fold_order(struct test *t) {
+  t_set_msg(t, "Testing the order of the folds...");
+  const size_t lengths[] = {100, 400, 250, 400, 50};
+  const size_t expected[] = {1, 3, 2, 0, 4};
+  const size_t count = sizeof(lengths) / sizeof(lengths[0]);
+  struct foldable_sequence fs[5];
+  struct foldable_sequence *sequences[5];
+  struct sequence_list seq_list;
+  struct configuration_params *config = NULL;
+  size_t *order = NULL;
+  initialize_configuration(&config, NULL);
+  for (size_t i = 0; i < count; i++) {
+    fs[i].n = lengths[i];
+    sequences[i] = &fs[i];
+  }
+  seq_list.sequences = sequences;
+  seq_list.n = count;
+  get_fold_order(&seq_list, config, &order);
+  for (size_t i = 0; i < count; i++) {
+    t_assert_msg(t, order[i] == expected[i], "Folds not ordered by cost");
+  }
+  free(order);
+  free(config);
+}
+
 void test_folding(struct test *t) {
   t_set_msg(t, "Testing libRNA folding...");
   char *fake_argv[] = {"fold", "test/data/contigs.bed", "test/data/Chlre3.fa"};
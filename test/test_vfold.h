@@ -4,6 +4,14 @@
 #define TEST_VFOLD_H
 
 void test_reverse_complement(struct test *t);
+void test_mfe_regression(struct test *t);
+void test_fold_batch(struct test *t);
+void test_banded_fold_batch(struct test *t);
+void test_sparse_fold(struct test *t);
+void test_lazy_backtrack(struct test *t);
+void test_core_constrained_fold(struct test *t);
+void test_regression_fold(struct test *t);
+void test_fold_order(struct test *t);
 void test_folding(struct test *t);
 
 #endif